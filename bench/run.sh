@@ -0,0 +1,222 @@
+#!/bin/sh
+# Transpiler benchmarks: generate large inputs and time sicc on each.
+# Not part of `make test`; run with `make bench`. Times should grow
+# linearly with input size.
+set -u
+cd "$(dirname "$0")/.." || exit 1
+
+# Inputs and outputs run to hundreds of megabytes; keep them out of the
+# tree and remove them on the way out.
+out=$(mktemp -d "${TMPDIR:-/tmp}/sic-bench.XXXXXX") || exit 1
+trap 'rm -rf "$out"' EXIT
+trap 'exit 1' INT TERM
+fail=0
+
+# Seconds (with fraction) taken by the given command.
+elapsed() {
+  start=$(date +%s.%N)
+  "$@" || return 1
+  end=$(date +%s.%N)
+  echo "$start $end" | awk '{ printf "%.3f", $2 - $1 }'
+}
+
+# One expression nested $1 levels deep: (+ 1 (+ 1 ... 0)). Depth used to
+# be bounded by the C stack in the parser, expander and emitter.
+deep() {
+  awk -v n="$1" 'BEGIN {
+    printf "(fn main :int ()\n  (return (- "
+    for (i = 0; i < n; i++) printf "(+ 1 "
+    printf "0"
+    for (i = 0; i < n; i++) printf ")"
+    printf " %d)))\n", n
+  }'
+}
+
+for depth in 10000 100000; do
+  name="deep-$depth"
+  deep "$depth" >"$out/$name.sic"
+  if ! t=$(elapsed ./sicc "$out/$name.sic" "$out/$name.c"); then
+    echo "FAIL $name (transpile)"
+    fail=$((fail + 1))
+    continue
+  fi
+  if [ "$(grep -o '(1 + ' "$out/$name.c" | wc -l)" -ne "$depth" ]; then
+    echo "FAIL $name (output lost nesting)"
+    fail=$((fail + 1))
+    continue
+  fi
+  echo "$name: ${t}s"
+done
+
+# One initializer with $1 elements, all emitted on a single line.
+table() {
+  awk -v n="$1" 'BEGIN {
+    printf "(decl table :int[] (init"
+    for (i = 0; i < n; i++) printf " %d", i
+    printf "))\n(fn main :int () (return (aref table %d)))\n", n - 1
+  }'
+}
+
+for size in 5000 50000 500000; do
+  name="init-$size"
+  table "$size" >"$out/$name.sic"
+  if ! t=$(elapsed ./sicc "$out/$name.sic" "$out/$name.c"); then
+    echo "FAIL $name (transpile)"
+    fail=$((fail + 1))
+    continue
+  fi
+  echo "$name: ${t}s"
+done
+
+# $1 macros, then the same 20k calls spread over the first ten of them:
+# expansion time should not depend on how many macros are defined.
+macros() {
+  awk -v n="$1" 'BEGIN {
+    for (i = 0; i < n; i++)
+      printf "(defmacro m%d (a b) (do (decl t# :int a) (set a (+ b t#))))\n", i
+    printf "(fn main :int ()\n  (decl x :int 0)\n  (decl y :int 1)\n"
+    for (i = 0; i < 20000; i++) printf "  (m%d x y)\n", i % 10
+    printf "  (return x))\n"
+  }'
+}
+
+for count in 10 100 1000 10000; do
+  name="macros-$count"
+  macros "$count" >"$out/$name.sic"
+  if ! t=$(elapsed ./sicc "$out/$name.sic" "$out/$name.c"); then
+    echo "FAIL $name (transpile)"
+    fail=$((fail + 1))
+    continue
+  fi
+  echo "$name: ${t}s"
+done
+
+# A 50k-statement body passed down through $1 layers of wrapper macros.
+# Arguments are shared, not copied, so each layer should cost only its
+# template.
+layers() {
+  awk -v n="$1" 'BEGIN {
+    printf "(defmacro w0 (body...) (do body...))\n"
+    for (i = 1; i < n; i++)
+      printf "(defmacro w%d (body...) (w%d (if 1 (do body...))))\n", i, i - 1
+    printf "(fn main :int ()\n  (decl x :int 0)\n  (w%d\n", n - 1
+    for (i = 0; i < 50000; i++) printf "    (+= x %d)\n", i % 7
+    printf "  )\n  (return x))\n"
+  }'
+}
+
+for count in 1 10 50; do
+  name="layers-$count"
+  layers "$count" >"$out/$name.sic"
+  if ! t=$(elapsed ./sicc "$out/$name.sic" "$out/$name.c"); then
+    echo "FAIL $name (transpile)"
+    fail=$((fail + 1))
+    continue
+  fi
+  echo "$name: ${t}s"
+done
+
+# 200k small functions, each using a macro: -j should scale with cores
+# and write the same bytes as one thread.
+forms() {
+  awk 'BEGIN {
+    printf "(defmacro bump (a) (do (decl t# :int a) (set a (+ t# 1))))\n"
+    for (i = 0; i < 200000; i++)
+      printf "(fn f%d :int (x :int) (bump x) (return (* x %d)))\n", i, i
+  }'
+}
+
+forms >"$out/forms.sic"
+for jobs in 1 2 4 8; do
+  name="forms-j$jobs"
+  if ! t=$(elapsed ./sicc -j "$jobs" "$out/forms.sic" "$out/$name.c"); then
+    echo "FAIL $name (transpile)"
+    fail=$((fail + 1))
+    continue
+  fi
+  if ! cmp -s "$out/forms-j1.c" "$out/$name.c"; then
+    echo "FAIL $name (output differs from -j 1)"
+    fail=$((fail + 1))
+    continue
+  fi
+  echo "$name: ${t}s"
+done
+
+# 3000 small files, one sicc per file against one --out-dir run.
+files="$out/files"
+rm -rf "$files"
+mkdir -p "$files/src" "$files/each" "$files/batch"
+awk -v dir="$files/src" 'BEGIN {
+  for (i = 0; i < 3000; i++) {
+    f = sprintf("%s/m%d.sic", dir, i)
+    printf "(defmacro twice (x) (do x x))\n" >f
+    printf "(fn f%d :int (x :int) (twice (+= x 1)) (return x))\n", i >>f
+    close(f)
+  }
+}'
+each() {
+  for src in "$files"/src/*.sic; do
+    ./sicc "$src" "$files/each/$(basename "$src" .sic).c" || return 1
+  done
+}
+if ! t=$(elapsed each); then
+  echo "FAIL files-each (transpile)"
+  fail=$((fail + 1))
+else
+  echo "files-each: ${t}s"
+fi
+for jobs in 1 4; do
+  name="files-batch-j$jobs"
+  if ! t=$(elapsed ./sicc -j "$jobs" --out-dir "$files/batch" \
+    "$files"/src/*.sic); then
+    echo "FAIL $name (transpile)"
+    fail=$((fail + 1))
+  elif ! diff -r "$files/each" "$files/batch" >/dev/null; then
+    echo "FAIL $name (output differs from one file at a time)"
+    fail=$((fail + 1))
+  else
+    echo "$name: ${t}s"
+  fi
+done
+
+# The same 3000 files plus a main, built into one program with sicc
+# build: cold, then again with nothing changed, which should take well
+# under a second.
+rm -rf "$files/cache"
+echo '(fn main :int () (return 0))' >"$files/main.sic"
+for pass in cold noop; do
+  name="files-build-$pass"
+  if ! t=$(elapsed ./sicc build -o "$files/prog" --cache "$files/cache" \
+    "$files/main.sic" "$files"/src/*.sic); then
+    echo "FAIL $name"
+    fail=$((fail + 1))
+  else
+    echo "$name: ${t}s"
+  fi
+done
+
+# 300 files using a prelude of 3000 macros: each file carrying a copy,
+# then importing it. The imports should cost next to nothing once the
+# first has written the prelude's image.
+prelude="$out/prelude"
+rm -rf "$prelude"
+mkdir -p "$prelude/copied" "$prelude/imported" "$prelude/out"
+macros 3000 | head -n 3000 >"$prelude/prelude.sic"
+for i in $(seq 300); do
+  body="(fn f$i :int (x :int y :int) (m$((i % 3000)) x y) (return x))"
+  { cat "$prelude/prelude.sic"; echo "$body"; } >"$prelude/copied/f$i.sic"
+  printf '(import "../prelude.sic")\n%s\n' "$body" \
+    >"$prelude/imported/f$i.sic"
+done
+for kind in copied imported; do
+  name="prelude-$kind"
+  if ! t=$(elapsed ./sicc --out-dir "$prelude/out" \
+    "$prelude/$kind"/*.sic); then
+    echo "FAIL $name (transpile)"
+    fail=$((fail + 1))
+  else
+    echo "$name: ${t}s"
+  fi
+done
+
+[ "$fail" -eq 0 ]
@@ -0,0 +1,5474 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE // madvise
+
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "sic.h"
+
+// === Headers & Data Structures ===
+
+typedef enum Tag Tag;
+typedef struct Obj Obj;
+typedef struct SrcFile SrcFile;
+typedef struct Pos Pos;
+typedef struct Parser Parser;
+typedef struct Result Result;
+typedef struct CCode CCode;
+typedef struct Arena Arena;
+typedef struct ArenaChunk ArenaChunk;
+typedef struct Macro Macro;
+typedef struct SicContext Context;
+typedef struct Expander Expander;
+typedef struct FormCache FormCache;
+typedef struct Incremental Incremental;
+typedef struct Module Module;
+typedef struct ImportSite ImportSite;
+typedef struct Importing Importing;
+typedef struct ModuleDep ModuleDep;
+typedef struct SicCall SicCall;
+typedef struct Unity Unity;
+typedef struct UnityPart UnityPart;
+
+struct Pos {
+  uint32_t row;
+  uint32_t col;
+};
+
+// The whole input lives in `data`, so atoms can be slices of it: an atom
+// is terminated in place by overwriting the delimiter after it with '\0',
+// and the delimiter is kept in `held` until the parser consumes it.
+struct SrcFile {
+  char *name;
+  char *data;
+  size_t len;
+  size_t off;
+  bool mapped;
+  int held;
+  bool eof;
+  Pos pos;
+};
+
+// Every node of the tree -- parsed, cloned or built by macro expansion --
+// is carved out of one arena and released with it in a single
+// arena_free; nothing in the tree is freed on its own.
+struct ArenaChunk {
+  ArenaChunk *next;
+  size_t size;
+  size_t used;
+  max_align_t data[];
+};
+
+struct Arena {
+  ArenaChunk *head;
+  ArenaChunk *spare; // kept by arena_release for the next chunk
+  size_t used;       // bytes handed out, across chunks
+  size_t peak;
+  size_t reserved;
+};
+
+// Where an arena stood, so everything allocated since can be released.
+typedef struct ArenaMark {
+  ArenaChunk *chunk;
+  size_t chunk_used;
+  size_t used;
+} ArenaMark;
+
+void *arena_alloc(Arena *, size_t);
+ArenaMark arena_mark(Arena *);
+void arena_release(Arena *, ArenaMark);
+void arena_free(Arena *);
+
+// A growable byte buffer; text is formatted straight into its spare room.
+typedef struct Buf {
+  char *data;
+  size_t len;
+  size_t cap;
+} Buf;
+
+typedef enum EmitKind {
+  EMIT_OBJ,    // run the rule for `o`
+  EMIT_LINE,   // ccode_printf_line with text from `texts`
+  EMIT_APPEND, // ccode_append with text from `texts`
+  EMIT_FAIL,   // fail with the message in `texts`, at `pos` if `ctx`
+} EmitKind;
+
+typedef struct EmitOp {
+  EmitKind kind;
+  int ctx; // RuleContext of an EMIT_OBJ
+  union {
+    Obj *o;
+    size_t text; // offset into CCode.texts
+  };
+  Obj *owner; // of text: the node whose rule wrote it
+  Obj *call;  // the node of the macro call `o` or `owner` came from, if any
+  Pos pos;    // of an EMIT_FAIL
+} EmitOp;
+
+// Source map entries, 0-based until handed over; see SicSpan. The call
+// position is 1-based throughout, as 0 says there is none.
+typedef struct SpanList {
+  SicSpan *spans;
+  size_t len;
+  size_t buffer;
+} SpanList;
+
+typedef struct EmitStack {
+  EmitOp *ops;
+  size_t len;
+  size_t buffer;
+} EmitStack;
+
+// All output is one buffer: each line but the first starts with the
+// '\n' that ends the one before, so appending to the current line is
+// appending to the buffer. Rules don't recurse into their children: see
+// transpile_obj.
+struct CCode {
+  Buf out;
+  size_t *lines; // offset of each line's first byte in `out`
+  size_t count;
+  size_t buffer;
+
+  EmitStack work;     // ops still to run, next one last
+  EmitStack deferred; // ops recorded by the running rule, in order
+  Buf texts;          // '\0'-separated text of deferred EMIT_LINE/APPEND ops
+  bool in_rule;       // a rule is running, so children are deferred
+  bool deferring;     // ...and one was, so output after it must wait too
+  bool unmarked;      // no #line markers: a header's, which rows can't move
+
+  // With a source map, each stretch of a line written for a node, in
+  // order, its C line counted from this CCode's first.
+  bool mapping;
+  Obj *owner; // the node whose output is being written
+  Obj *call;  // and the innermost expansion it is, or is inside, if any
+  SpanList map;
+};
+
+enum Tag {
+  SEXP,
+  ATOM,
+};
+
+struct Result {
+  enum { OK, Err } tag;
+};
+
+// A node is 32 bytes and self-contained. A form's children are one
+// contiguous run of nodes, so walking them touches adjacent memory. Atoms
+// of up to OBJ_INLINE bytes keep their text in the node; longer ones point
+// at it -- the symbol table's copy, a slice of the source for literals,
+// or arena memory -- and text is never modified, so copies of a node
+// share it. Atoms other than string, character and number literals also
+// carry their interned symbol id; compare those, not text.
+// Reach children and text through obj_at and obj_text.
+#define OBJ_INLINE 7
+
+struct Obj {
+  Pos beg;
+  Pos end;
+
+  uint32_t tag : 1;      // Tag
+  uint32_t shared : 1;   // SEXP: `items` may also be reachable from elsewhere
+  uint32_t expanded : 1; // made by a macro expansion, so spans its call
+  uint32_t sym : 29;     // ATOM: symbol id; SYM_NONE for a literal, gensym
+  uint32_t len;      // SEXP: children; ATOM: bytes of text, minus the '\0'
+  union {
+    Obj *items;
+    char *text;
+    char inline_text[OBJ_INLINE + 1];
+  };
+};
+
+static inline Obj *obj_at(Obj *o, size_t i) { return &o->items[i]; }
+
+static inline char *obj_text(Obj *o) {
+  return o->len <= OBJ_INLINE ? o->inline_text : o->text;
+}
+
+Obj obj_atom(Arena *arena, const char *text, size_t len, Pos pos);
+void obj_print(Obj *obj);
+void obj_print_tree(Obj *obj, size_t indent);
+
+// A form still waiting for its ')': its node so far, and where its
+// children start on the parser's stack.
+typedef struct OpenForm {
+  Obj form;
+  size_t base;
+} OpenForm;
+
+// Finished nodes wait on `stack` until the form around them closes; then
+// they move to the arena as that form's children. Nesting is tracked in
+// `open` rather than on the C stack, so depth is bounded only by memory.
+struct Parser {
+  Obj *root; // SEXP whose children are the top-level forms
+  SrcFile *srcfile;
+  Arena *arena;
+  Obj *stack;
+  size_t stack_len;
+  size_t stack_buffer;
+  OpenForm *open;
+  size_t open_len;
+  size_t open_buffer;
+};
+
+// One input, from whichever entry point.
+struct SicCall {
+  const char *name;
+  const char *path; // the source, read by sic_run...
+  const char *text; // ...or `text_len` bytes of it
+  size_t text_len;
+  SrcFile *src; // NULL if it couldn't be read
+  const SicOptions *options;
+  FILE *stream;            // set when streaming
+  const ModuleDep *module; // set when compiling a module's image
+  Unity *unity;            // set for a unity build
+  UnityPart *part;         // ...and for each of its files
+  SicOutput *out;
+};
+
+typedef enum RuleContext {
+  EXPRESSION = 1 << 0,
+  STATEMENT = 1 << 1,
+} RuleContext;
+
+// `match` lists heads separated by spaces; a word ending in "..." matches
+// any head that starts with the rest of it.
+typedef struct TRule {
+  const char *match;
+  void (*fn)(Obj *o, CCode *code);
+  RuleContext ctx;
+} TRule;
+
+void transpile_obj(Obj *o, CCode *code, RuleContext ctx);
+void transpile_return(Obj *o, CCode *code);
+void transpile_include(Obj *o, CCode *code);
+void transpile_fn(Obj *o, CCode *code);
+void transpile_call(Obj *o, CCode *code);
+void transpile_binary_op(Obj *o, CCode *code);
+void transpile_deref(Obj *o, CCode *code);
+void transpile_decl(Obj *o, CCode *code);
+void transpile_set(Obj *o, CCode *code);
+void transpile_while(Obj *o, CCode *code);
+void transpile_cast(Obj *o, CCode *code);
+void transpile_op_assign(Obj *o, CCode *code);
+void transpile_statement(Obj *o, CCode *code);
+void transpile_expression(Obj *o, CCode *code);
+void transpile_condition(Obj *o, CCode *code);
+void transpile_for(Obj *o, CCode *code);
+void transpile_if(Obj *o, CCode *code);
+void transpile_do(Obj *o, CCode *code);
+void transpile_ternary(Obj *o, CCode *code);
+void transpile_incdec(Obj *o, CCode *code);
+void transpile_aref(Obj *o, CCode *code);
+void transpile_member(Obj *o, CCode *code);
+void transpile_sizeof(Obj *o, CCode *code);
+void transpile_struct(Obj *o, CCode *code);
+void transpile_enum(Obj *o, CCode *code);
+void transpile_typedef(Obj *o, CCode *code);
+void transpile_switch(Obj *o, CCode *code);
+void transpile_init(Obj *o, CCode *code);
+void transpile_define(Obj *o, CCode *code);
+void transpile_undef(Obj *o, CCode *code);
+void transpile_guard(Obj *o, CCode *code);
+void transpile_hash_else(Obj *o, CCode *code);
+void transpile_pragma(Obj *o, CCode *code);
+void transpile_typeop(Obj *o, CCode *code);
+void transpile_do_while(Obj *o, CCode *code);
+void transpile_goto(Obj *o, CCode *code);
+void transpile_launch(Obj *o, CCode *code);
+void transpile_import(Obj *o, CCode *code);
+
+static CCode *header_init(void);
+static void header_declare(Obj *o, CCode *header);
+static void header_finish(const char *decls, size_t len, SicOutput *out);
+
+// === Implementations ===
+
+// ==== Utilities ====
+_Noreturn static void fail_alloc(void);
+
+#define CHECK_ALLOC(ptr)                                                       \
+  ({                                                                           \
+    void *_tmp_ptr = (ptr);                                                    \
+    if (_tmp_ptr == NULL) {                                                    \
+      fail_alloc();                                                            \
+    }                                                                          \
+    _tmp_ptr;                                                                  \
+  })
+
+#define X(msg, ...)                                                            \
+  do {                                                                         \
+    time_t t = time(NULL);                                                     \
+    struct tm *tm_info = localtime(&t);                                        \
+    char time_buf[20];                                                         \
+    strftime(time_buf, 20, "%Y-%m-%d %H:%M:%S", tm_info);                      \
+    fprintf(stderr, "[%s] %s:%d: " msg "\n", time_buf, __FILE__, __LINE__,     \
+            ##__VA_ARGS__);                                                    \
+    fflush(stderr);                                                            \
+  } while (0)
+
+// A failure records its message and position, then jumps back to the
+// library entry point or -j worker that set `failure`, which frees what
+// the file had in flight. Nothing is printed and nothing exits; the
+// caller decides how to report it.
+typedef struct Failure {
+  jmp_buf jump;
+  bool positioned;
+  Pos pos;
+  Buf message;
+  Buf file; // if set, the failure is in this file rather than the input
+} Failure;
+
+static _Thread_local Failure *failure;
+
+static void buf_vprintf(Buf *buf, const char *format, va_list args);
+static void buf_write(Buf *buf, const char *text, size_t len);
+
+_Noreturn static void fail(const char *fmt, ...) {
+  failure->positioned = false;
+  failure->message.len = 0;
+  failure->file.len = 0;
+  va_list args;
+  va_start(args, fmt);
+  buf_vprintf(&failure->message, fmt, args);
+  va_end(args);
+  longjmp(failure->jump, 1);
+}
+
+_Noreturn static void fail_at(Pos pos, const char *fmt, ...) {
+  failure->positioned = true;
+  failure->pos = pos;
+  failure->message.len = 0;
+  failure->file.len = 0;
+  va_list args;
+  va_start(args, fmt);
+  buf_vprintf(&failure->message, fmt, args);
+  va_end(args);
+  longjmp(failure->jump, 1);
+}
+
+// Fails in another file: an imported module that didn't compile, as its
+// own context reported it (or as -j hands that back).
+_Noreturn static void fail_in(const SicError *error) {
+  failure->positioned = error->line > 0;
+  failure->pos = (Pos){.row = error->line - 1, .col = error->column - 1};
+  failure->message.len = 0;
+  buf_write(&failure->message, error->message, strlen(error->message) + 1);
+  failure->message.len--; // keep the '\0' out of the length
+  failure->file.len = 0;
+  buf_write(&failure->file, error->file, strlen(error->file) + 1);
+  failure->file.len--;
+  longjmp(failure->jump, 1);
+}
+
+// Out of memory, which is said without allocating: the failure is left
+// with no message, and failure_message reads that as this one.
+_Noreturn static void fail_alloc(void) {
+  failure->positioned = false;
+  failure->message.len = 0;
+  failure->file.len = 0;
+  longjmp(failure->jump, 1);
+}
+
+static const char *failure_message(const Failure *f) {
+  return f->message.len > 0 ? f->message.data : "out of memory";
+}
+
+// Copies `text` with its '\0' but not counting it, or leaves `buf` empty
+// if there is no room to: failure_copy mustn't fail itself.
+static bool failure_text(Buf *buf, const Buf *text) {
+  buf->len = 0;
+  if (text->len == 0) {
+    return true;
+  }
+  if (buf->cap <= text->len) {
+    char *data = realloc(buf->data, text->len + 1);
+    if (data == NULL) {
+      return false;
+    }
+    buf->data = data;
+    buf->cap = text->len + 1;
+  }
+  memcpy(buf->data, text->data, text->len + 1);
+  buf->len = text->len;
+  return true;
+}
+
+// A copy that can't be made is out of memory, like the failure it was of.
+static void failure_copy(Failure *to, const Failure *from) {
+  to->positioned = from->positioned;
+  to->pos = from->pos;
+  if (!failure_text(&to->message, &from->message) ||
+      !failure_text(&to->file, &from->file)) {
+    to->positioned = false;
+    to->message.len = 0;
+    to->file.len = 0;
+  }
+}
+
+// Passes a failure caught on its way out on to the next catcher, and
+// frees the caught one's text.
+_Noreturn static void fail_again(Failure *caught) {
+  failure_copy(failure, caught);
+  free(caught->message.data);
+  free(caught->file.data);
+  longjmp(failure->jump, 1);
+}
+
+// ==== Source files ====
+
+// Regular files are mapped privately (copy-on-write, so the in-place
+// terminators never reach the file); pipes and stdin are read in one go.
+// Either way data[len] is a readable '\0', which a mapping only
+// guarantees when the file doesn't end exactly on a page boundary.
+static bool srcfile_map(SrcFile *srcfile, int fd) {
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0 ||
+      st.st_size % sysconf(_SC_PAGESIZE) == 0) {
+    return false;
+  }
+
+  void *data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                    fd, 0);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  srcfile->data = data;
+  srcfile->len = st.st_size;
+  srcfile->mapped = true;
+  return true;
+}
+
+static bool srcfile_slurp(SrcFile *srcfile, int fd) {
+  size_t cap = 1 << 16;
+  char *data = CHECK_ALLOC(malloc(cap));
+  size_t len = 0;
+  for (;;) {
+    if (cap - len < 2) {
+      cap *= 2;
+      data = CHECK_ALLOC(realloc(data, cap));
+    }
+    ssize_t n = read(fd, data + len, cap - len - 1);
+    if (n < 0) {
+      free(data);
+      return false;
+    }
+    if (n == 0) {
+      break;
+    }
+    len += n;
+  }
+  data[len] = '\0';
+  srcfile->data = data;
+  srcfile->len = len;
+  srcfile->mapped = false;
+  return true;
+}
+
+// "-" names stdin.
+SrcFile *srcfile_init(char *name) {
+  bool is_stdin = strcmp(name, "-") == 0;
+  int fd = is_stdin ? STDIN_FILENO : open(name, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  SrcFile *srcfile = CHECK_ALLOC(calloc(1, sizeof(SrcFile)));
+  bool ok = srcfile_map(srcfile, fd) || srcfile_slurp(srcfile, fd);
+  if (!is_stdin) {
+    close(fd);
+  }
+  if (!ok) {
+    free(srcfile);
+    return NULL;
+  }
+
+  srcfile->name = CHECK_ALLOC(strdup(name));
+  srcfile->off = 0;
+  srcfile->held = EOF;
+  srcfile->pos.row = 0;
+  srcfile->pos.col = 0;
+  srcfile->eof = false;
+
+  return srcfile;
+}
+
+// The text is copied, so it needn't be writable or outlive the file.
+SrcFile *srcfile_init_text(const char *name, const char *text, size_t len) {
+  SrcFile *srcfile = CHECK_ALLOC(calloc(1, sizeof(SrcFile)));
+  srcfile->data = CHECK_ALLOC(malloc(len + 1));
+  memcpy(srcfile->data, text, len);
+  srcfile->data[len] = '\0';
+  srcfile->len = len;
+  srcfile->name = CHECK_ALLOC(strdup(name));
+  srcfile->held = EOF;
+  return srcfile;
+}
+
+void srcfile_free(SrcFile *srcfile) {
+  free(srcfile->name);
+  if (srcfile->mapped) {
+    munmap(srcfile->data, srcfile->len);
+  } else {
+    free(srcfile->data);
+  }
+  free(srcfile);
+}
+
+int srcfile_peek(SrcFile *srcfile) {
+  if (srcfile->held != EOF) {
+    return srcfile->held;
+  }
+  if (srcfile->off >= srcfile->len) {
+    return EOF;
+  }
+  return (unsigned char)srcfile->data[srcfile->off];
+}
+
+int srcfile_getc(SrcFile *srcfile) {
+  int ch = srcfile_peek(srcfile);
+  srcfile->held = EOF;
+  srcfile->pos.col++;
+  if (ch == '\n') {
+    srcfile->pos.row++;
+    srcfile->pos.col = 0;
+  } else if (ch == EOF) {
+    srcfile->eof = true;
+    return ch;
+  }
+
+  srcfile->off++;
+  return ch;
+}
+
+// Ends the atom that runs up to the cursor: the byte there becomes its
+// terminator, and is handed out by peek/getc until consumed.
+void srcfile_terminate(SrcFile *srcfile) {
+  if (srcfile->off < srcfile->len) {
+    srcfile->held = (unsigned char)srcfile->data[srcfile->off];
+    srcfile->data[srcfile->off] = '\0';
+  }
+}
+
+// Drops the mapped pages that lie wholly within [from, to), once nothing
+// points into them any more. They read back from the file if touched
+// again, without the terminators written into them. Returns where the
+// next release should start: the part of a page left behind is retried.
+size_t srcfile_release(SrcFile *srcfile, size_t from, size_t to) {
+  if (!srcfile->mapped) {
+    return to;
+  }
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t start = (from + page - 1) & ~(page - 1);
+  size_t end = to & ~(page - 1);
+  if (start >= end) {
+    return from;
+  }
+#ifdef MADV_DONTNEED
+  madvise(srcfile->data + start, end - start, MADV_DONTNEED);
+#endif
+  return end;
+}
+
+bool srcfile_finished_p(SrcFile *srcfile) { return srcfile->eof; }
+
+// ==== Scanning ====
+// The tokenizer's hot loops, 16 or 32 bytes at a time where the CPU
+// allows. Each returns how many bytes precede the first one it stops at,
+// or n if none does; the scalar loops finish whatever is shorter than a
+// vector and are the whole story on other targets.
+
+// Bytes that end an atom: isspace() in the C locale, ')' and ';'.
+static bool scan_delimiter_p(unsigned char ch) {
+  return ch == ' ' || (ch >= '\t' && ch <= '\r') || ch == ')' || ch == ';';
+}
+
+static bool scan_literal_stop_p(unsigned char ch) {
+  return ch == '"' || ch == '\'' || ch == '\\' || ch == '\n';
+}
+
+#ifdef __SSE2__
+static int scan_delimiters_sse2(const char *p) {
+  __m128i v = _mm_loadu_si128((const __m128i *)p);
+  __m128i ctl = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+  __m128i hit = _mm_cmpeq_epi8(_mm_min_epu8(ctl, _mm_set1_epi8(4)), ctl);
+  hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+  hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8(')')));
+  hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8(';')));
+  return _mm_movemask_epi8(hit);
+}
+
+static int scan_literal_stops_sse2(const char *p) {
+  __m128i v = _mm_loadu_si128((const __m128i *)p);
+  __m128i hit = _mm_cmpeq_epi8(v, _mm_set1_epi8('"'));
+  hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8('\'')));
+  hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+  hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+  return _mm_movemask_epi8(hit);
+}
+
+__attribute__((target("avx2"))) static size_t
+scan_atom_avx2(const char *p, size_t n) {
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+    __m256i ctl = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+    __m256i hit =
+        _mm256_cmpeq_epi8(_mm256_min_epu8(ctl, _mm256_set1_epi8(4)), ctl);
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(')')));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(';')));
+    unsigned mask = (unsigned)_mm256_movemask_epi8(hit);
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) static size_t
+scan_literal_avx2(const char *p, size_t n) {
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+    __m256i hit = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\'')));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+    unsigned mask = (unsigned)_mm256_movemask_epi8(hit);
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return i;
+}
+#endif
+
+// Most atoms fit in one 16-byte vector, so AVX2 only takes over for the
+// long tail (string-heavy or generated identifiers).
+static size_t scan_atom(const char *p, size_t n) {
+  size_t i = 0;
+#ifdef __SSE2__
+  if (n >= 64 && __builtin_cpu_supports("avx2")) {
+    i = scan_atom_avx2(p, n);
+    if (i + 32 <= n) {
+      return i;
+    }
+  }
+  for (; i + 16 <= n; i += 16) {
+    int mask = scan_delimiters_sse2(p + i);
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+#endif
+  while (i < n && !scan_delimiter_p((unsigned char)p[i])) {
+    i++;
+  }
+  return i;
+}
+
+// Stops at either quote, a backslash, or a newline; the caller decides
+// what each means inside the literal it is reading.
+static size_t scan_literal(const char *p, size_t n) {
+  size_t i = 0;
+#ifdef __SSE2__
+  if (n >= 64 && __builtin_cpu_supports("avx2")) {
+    i = scan_literal_avx2(p, n);
+    if (i + 32 <= n) {
+      return i;
+    }
+  }
+  for (; i + 16 <= n; i += 16) {
+    int mask = scan_literal_stops_sse2(p + i);
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+#endif
+  while (i < n && !scan_literal_stop_p((unsigned char)p[i])) {
+    i++;
+  }
+  return i;
+}
+
+// ==== Arena ====
+
+#define ARENA_CHUNK_MIN (1 << 20)
+
+void *arena_alloc(Arena *arena, size_t size) {
+  size = (size + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1);
+  ArenaChunk *chunk = arena->head;
+  if (chunk == NULL || chunk->size - chunk->used < size) {
+    size_t chunk_size = ARENA_CHUNK_MIN;
+    if (chunk != NULL && chunk->size < 64 * ARENA_CHUNK_MIN) {
+      chunk_size = chunk->size * 2;
+    }
+    if (chunk_size < size) {
+      chunk_size = size;
+    }
+    if (arena->spare != NULL && arena->spare->size >= size) {
+      chunk = arena->spare;
+      arena->spare = NULL;
+    } else {
+      chunk = CHECK_ALLOC(malloc(sizeof(ArenaChunk) + chunk_size));
+      chunk->size = chunk_size;
+      arena->reserved += chunk_size;
+    }
+    chunk->next = arena->head;
+    chunk->used = 0;
+    arena->head = chunk;
+  }
+
+  void *p = (char *)chunk->data + chunk->used;
+  chunk->used += size;
+  arena->used += size;
+  if (arena->used > arena->peak) {
+    arena->peak = arena->used;
+  }
+  return p;
+}
+
+ArenaMark arena_mark(Arena *arena) {
+  return (ArenaMark){.chunk = arena->head,
+                     .chunk_used = arena->head ? arena->head->used : 0,
+                     .used = arena->used};
+}
+
+// Chunks opened since the mark are freed, except the largest, which is
+// kept for the next allocation that needs a chunk: a loop that releases
+// after every item shouldn't map and unmap a chunk each time.
+void arena_release(Arena *arena, ArenaMark mark) {
+  while (arena->head != mark.chunk) {
+    ArenaChunk *chunk = arena->head;
+    arena->head = chunk->next;
+    if (arena->spare == NULL || arena->spare->size < chunk->size) {
+      ArenaChunk *old = arena->spare;
+      arena->spare = chunk;
+      chunk = old;
+    }
+    if (chunk != NULL) {
+      arena->reserved -= chunk->size;
+      free(chunk);
+    }
+  }
+  if (arena->head != NULL) {
+    arena->head->used = mark.chunk_used;
+  }
+  arena->used = mark.used;
+}
+
+void arena_free(Arena *arena) {
+  free(arena->spare);
+  arena->spare = NULL;
+  ArenaChunk *chunk = arena->head;
+  while (chunk != NULL) {
+    ArenaChunk *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  arena->head = NULL;
+  arena->used = 0;
+  arena->reserved = 0;
+}
+
+// ==== Symbols ====
+
+// Spellings the transpiler itself compares atoms against. They are
+// interned first, in this order, so their ids are the enum values; the
+// comparison operators stay contiguous, LT through NE.
+#define BUILTIN_SYMBOLS(SYM)                                                   \
+  SYM(DEFMACRO, "defmacro")                                                    \
+  SYM(LT, "<")                                                                 \
+  SYM(GT, ">")                                                                 \
+  SYM(LE, "<=")                                                                \
+  SYM(GE, ">=")                                                                \
+  SYM(EQ, "==")                                                                \
+  SYM(NE, "!=")                                                                \
+  SYM(FNPTR, "fnptr")                                                          \
+  SYM(HASH_IF, "#if")                                                          \
+  SYM(ELLIPSIS, "...")                                                         \
+  SYM(OFFSETOF, "offsetof")                                                    \
+  SYM(CASE, "case")                                                            \
+  SYM(DEFAULT, "default")                                                      \
+  SYM(GOTO, "goto")                                                            \
+  SYM(IMPORT, "import")
+
+enum {
+  SYM_NONE,
+#define SYM(name, text) SYM_##name,
+  BUILTIN_SYMBOLS(SYM)
+#undef SYM
+};
+
+// Open-addressed over ids; text lives in its own arena so it survives
+// the tree and gives long symbols a stable address.
+typedef struct SymTab {
+  char **names; // by id; names[SYM_NONE] is unused
+  uint32_t *lens;
+  uint32_t *hashes;
+  uint32_t len; // ids handed out, counting SYM_NONE
+  uint32_t buffer;
+  uint32_t *slots; // ids, SYM_NONE when empty
+  uint32_t mask;
+  Arena text;
+} SymTab;
+
+// Open-addressed map from symbol ids to nonzero values.
+typedef struct SymMap {
+  uint32_t *keys; // SYM_NONE when empty
+  uint32_t *values;
+  uint32_t len;
+  uint32_t cap; // a power of two, or 0 before the first put
+} SymMap;
+
+// Everything that belongs to one input file: its name for diagnostics,
+// the symbols read from it, the macros it defines, and its tree. The
+// thread working on a file (and its -j workers) point `ctx` at the file's
+// context. context_reset releases it all after each file, including a
+// parser or output a failure cut short; only the name, the error, what
+// was imported and the incremental form caches outlive the call.
+struct SicContext {
+  char *srcname;
+  SymTab symtab;
+  Macro *macros;
+  size_t macros_len;
+  size_t macros_buffer;
+  SymMap macro_index; // symbol -> index in macros + 1
+  Arena arena;
+  Parser *parser;     // while the file is being read
+  Expander *expander; // while its forms are being expanded
+  CCode *code;        // until the output is handed over
+  CCode *header;      // SicOptions.header's, likewise
+  bool mapping;       // SicOptions.source_map
+  Incremental *incremental; // while an incremental call is running
+  FormCache *caches;        // by source name, for incremental calls
+  size_t caches_len;
+  uint64_t calls; // incremental calls so far, to find the stalest cache
+  Context *parent;      // the importing file's, while a module is compiled
+  Importing *importing; // the innermost import in progress
+  Module **modules;     // imported, each after the modules it imports
+  size_t modules_len;
+  ImportSite *imports; // what each top-level import brought in
+  size_t imports_len;
+  Arena module_arena; // imported macros' trees, once expanded
+  Failure failure;
+  SicError error;
+  Buf imported; // the last call's modules, one path per line
+};
+
+static _Thread_local Context *ctx;
+
+static uint32_t sym_hash(const char *text, size_t len) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    h = (h ^ (unsigned char)text[i]) * 16777619u;
+  }
+  return h;
+}
+
+static inline const char *sym_name(uint32_t sym) {
+  return ctx->symtab.names[sym];
+}
+
+static void symtab_rehash(SymTab *t, uint32_t size) {
+  uint32_t *slots = CHECK_ALLOC(calloc(size, sizeof(uint32_t)));
+  free(t->slots);
+  t->slots = slots;
+  t->mask = size - 1;
+  for (uint32_t id = 1; id < t->len; id++) {
+    uint32_t i = t->hashes[id] & t->mask;
+    while (t->slots[i] != SYM_NONE) {
+      i = (i + 1) & t->mask;
+    }
+    t->slots[i] = id;
+  }
+}
+
+static uint32_t sym_intern(const char *text, size_t len);
+static void rules_intern(void);
+
+// The builtins and then every rule head are interned first, in a fixed
+// order, so their ids are the same in every context.
+static void symtab_init(SymTab *t) {
+  t->len = 1;
+  symtab_rehash(t, 1024);
+#define SYM(name, text) sym_intern(text, sizeof(text) - 1);
+  BUILTIN_SYMBOLS(SYM)
+#undef SYM
+  rules_intern();
+}
+
+static uint32_t sym_intern(const char *text, size_t len) {
+  SymTab *t = &ctx->symtab;
+  if (t->slots == NULL) {
+    symtab_init(t);
+  }
+
+  uint32_t h = sym_hash(text, len);
+  uint32_t i = h & t->mask;
+  for (uint32_t id; (id = t->slots[i]) != SYM_NONE; i = (i + 1) & t->mask) {
+    if (t->hashes[id] == h && t->lens[id] == len &&
+        memcmp(t->names[id], text, len) == 0) {
+      return id;
+    }
+  }
+
+  if (t->len >= t->buffer) {
+    uint32_t buffer = t->buffer == 0 ? 1024 : t->buffer * 2;
+    t->names = CHECK_ALLOC(realloc(t->names, buffer * sizeof(char *)));
+    t->lens = CHECK_ALLOC(realloc(t->lens, buffer * sizeof(uint32_t)));
+    t->hashes = CHECK_ALLOC(realloc(t->hashes, buffer * sizeof(uint32_t)));
+    t->buffer = buffer;
+  }
+  if (t->len >= (1u << 29)) {
+    fail("too many distinct symbols");
+  }
+  uint32_t id = t->len++;
+  char *copy = arena_alloc(&t->text, len + 1);
+  memcpy(copy, text, len);
+  copy[len] = '\0';
+  t->names[id] = copy;
+  t->lens[id] = (uint32_t)len;
+  t->hashes[id] = h;
+  t->slots[i] = id;
+
+  // Keep the load under one half.
+  if (t->len * 2 > t->mask + 1) {
+    symtab_rehash(t, (t->mask + 1) * 2);
+  }
+  return id;
+}
+
+static void symtab_free(SymTab *t) {
+  free(t->names);
+  free(t->lens);
+  free(t->hashes);
+  free(t->slots);
+  arena_free(&t->text);
+  *t = (SymTab){0};
+}
+
+static inline uint32_t symmap_slot(SymMap *map, uint32_t sym) {
+  return (sym * 2654435761u) & (map->cap - 1);
+}
+
+// 0 when `sym` isn't in the map.
+static uint32_t symmap_get(SymMap *map, uint32_t sym) {
+  if (map->len == 0) {
+    return 0;
+  }
+  for (uint32_t i = symmap_slot(map, sym); map->keys[i] != SYM_NONE;
+       i = (i + 1) & (map->cap - 1)) {
+    if (map->keys[i] == sym) {
+      return map->values[i];
+    }
+  }
+  return 0;
+}
+
+static void symmap_put(SymMap *map, uint32_t sym, uint32_t value) {
+  if ((map->len + 1) * 2 > map->cap) {
+    SymMap old = *map;
+    uint32_t cap = old.cap == 0 ? 16 : old.cap * 2;
+    uint32_t *keys = CHECK_ALLOC(calloc(cap, sizeof(uint32_t)));
+    uint32_t *values = CHECK_ALLOC(malloc(cap * sizeof(uint32_t)));
+    *map = (SymMap){.keys = keys, .values = values, .cap = cap};
+    for (uint32_t i = 0; i < old.cap; i++) {
+      if (old.keys[i] != SYM_NONE) {
+        symmap_put(map, old.keys[i], old.values[i]);
+      }
+    }
+    free(old.keys);
+    free(old.values);
+  }
+
+  uint32_t i = symmap_slot(map, sym);
+  while (map->keys[i] != SYM_NONE && map->keys[i] != sym) {
+    i = (i + 1) & (map->cap - 1);
+  }
+  map->len += map->keys[i] == SYM_NONE;
+  map->keys[i] = sym;
+  map->values[i] = value;
+}
+
+// Empties the map but keeps its slots for reuse.
+static void symmap_clear(SymMap *map) {
+  if (map->len > 0) {
+    memset(map->keys, 0, map->cap * sizeof(uint32_t));
+    map->len = 0;
+  }
+}
+
+static void symmap_free(SymMap *map) {
+  free(map->keys);
+  free(map->values);
+  *map = (SymMap){0};
+}
+
+// Open-addressed from one 64-bit hash to another, e.g. a macro name's
+// to its definition's; 0 keys are empty, so hashes are kept nonzero.
+typedef struct DefTable {
+  uint64_t *keys;
+  uint64_t *values;
+  size_t len;
+  size_t cap;
+} DefTable;
+
+static uint64_t deftable_get(DefTable *t, uint64_t key) {
+  if (t->len == 0) {
+    return 0;
+  }
+  for (size_t i = key & (t->cap - 1); t->keys[i] != 0;
+       i = (i + 1) & (t->cap - 1)) {
+    if (t->keys[i] == key) {
+      return t->values[i];
+    }
+  }
+  return 0;
+}
+
+static void deftable_put(DefTable *t, uint64_t key, uint64_t value) {
+  if ((t->len + 1) * 2 > t->cap) {
+    DefTable old = *t;
+    size_t cap = old.cap == 0 ? 16 : old.cap * 2;
+    uint64_t *keys = CHECK_ALLOC(calloc(cap, sizeof(uint64_t)));
+    uint64_t *values = CHECK_ALLOC(malloc(cap * sizeof(uint64_t)));
+    *t = (DefTable){.keys = keys, .values = values, .cap = cap};
+    for (size_t i = 0; i < old.cap; i++) {
+      if (old.keys[i] != 0) {
+        deftable_put(t, old.keys[i], old.values[i]);
+      }
+    }
+    free(old.keys);
+    free(old.values);
+  }
+
+  size_t i = key & (t->cap - 1);
+  while (t->keys[i] != 0 && t->keys[i] != key) {
+    i = (i + 1) & (t->cap - 1);
+  }
+  t->len += t->keys[i] == 0;
+  t->keys[i] = key;
+  t->values[i] = value;
+}
+
+static void deftable_free(DefTable *t) {
+  free(t->keys);
+  free(t->values);
+  *t = (DefTable){0};
+}
+
+// ==== Objects ====
+
+// Short text is copied into the node; longer text must be '\0'-terminated
+// and outlive the tree, and is only pointed at.
+static Obj obj_atom_ref(char *text, size_t len, Pos pos) {
+  Obj o = {.beg = pos, .end = pos, .tag = ATOM, .len = (uint32_t)len};
+  if (len <= OBJ_INLINE) {
+    memcpy(o.inline_text, text, len);
+    o.inline_text[len] = '\0';
+  } else {
+    o.text = text;
+  }
+  return o;
+}
+
+static Obj obj_sym(uint32_t sym, Pos pos) {
+  Obj o = obj_atom_ref((char *)sym_name(sym), ctx->symtab.lens[sym], pos);
+  o.sym = sym;
+  return o;
+}
+
+// String, character and number literals are never compared, so they
+// aren't interned: a file full of distinct constants shouldn't grow the
+// table.
+static bool atom_is_literal(const char *text) {
+  char c = text[0];
+  return c == '"' || c == '\'' || isdigit((unsigned char)c) ||
+         ((c == '-' || c == '+' || c == '.') &&
+          isdigit((unsigned char)text[1]));
+}
+
+// An atom whose text is copied: a symbol is interned and shares the
+// table's copy; a literal goes into the arena if it doesn't fit inline.
+Obj obj_atom(Arena *arena, const char *text, size_t len, Pos pos) {
+  if (!atom_is_literal(text)) {
+    return obj_sym(sym_intern(text, len), pos);
+  }
+  if (len <= OBJ_INLINE) {
+    return obj_atom_ref((char *)text, len, pos);
+  }
+  char *copy = arena_alloc(arena, len + 1);
+  memcpy(copy, text, len);
+  copy[len] = '\0';
+  return obj_atom_ref(copy, len, pos);
+}
+
+void obj_print(Obj *obj) {
+  switch (obj->tag) {
+  case SEXP:
+    printf("SEXP: (");
+    for (size_t i = 0; i < obj->len; i++) {
+      if (i > 0)
+        printf(" ");
+      switch (obj_at(obj, i)->tag) {
+      case ATOM:
+        printf("%s", obj_text(obj_at(obj, i)));
+        break;
+      case SEXP:
+        printf("[%" PRIu32 "]", obj_at(obj, i)->len);
+        break;
+      }
+    }
+    printf(") [%" PRIu32 "]\n", obj->len);
+    break;
+  case ATOM:
+    printf("ATOM: %s\n", obj_text(obj));
+    break;
+  }
+}
+
+void obj_print_tree(Obj *l, size_t indent) {
+  if (l->len == 0) {
+    return;
+  }
+
+  size_t num_width = 1 + (size_t)log10(l->len);
+  char formatstr[100];
+  snprintf(formatstr, 100,
+           "%%%zus%%%zuzu: %%s [%%" PRIu32 ", %%" PRIu32 "] -> [%%" PRIu32
+           ", %%" PRIu32 "]\n",
+           indent, num_width);
+
+  for (size_t i = 0; i < l->len; i++) {
+    Obj *o = obj_at(l, i);
+    switch (o->tag) {
+    case SEXP:
+      printf(formatstr, "", i, "(", o->beg.row, o->beg.col, o->end.row,
+             o->end.col);
+      obj_print_tree(o, indent + 2);
+      printf(formatstr, "", i, ")", o->beg.row, o->beg.col, o->end.row,
+             o->end.col);
+      break;
+    case ATOM:
+      printf(formatstr, "", i, obj_text(o), o->beg.row, o->beg.col,
+             o->end.row, o->end.col);
+      break;
+    }
+  }
+}
+
+// ==== Parser ====
+
+// Scans one atom starting at the cursor and leaves it as a slice of the
+// source. Quoted literals run to the matching unescaped quote; anything
+// else runs until whitespace, ')' or ';'. Atoms never hold a held byte:
+// one always starts after the previous atom's terminator was consumed.
+void parser_atom(Parser *parser, Obj *o) {
+  SrcFile *src = parser->srcfile;
+  char *start = src->data + src->off;
+  char *end = src->data + src->len;
+  char quote = *start == '"' || *start == '\'' ? *start : '\0';
+  char *p;
+
+  if (quote != '\0') {
+    p = start + 1;
+    char *line = NULL;
+    bool closed = false;
+    while (p < end) {
+      p += scan_literal(p, end - p);
+      if (p == end) {
+        break;
+      }
+      if (*p == '\n') {
+        src->pos.row++;
+        line = p + 1;
+      } else if (*p == '\\' && p + 1 < end) {
+        p++;
+        if (*p == '\n') {
+          src->pos.row++;
+          line = p + 1;
+        }
+      } else if (*p == quote) {
+        p++;
+        closed = true;
+        break;
+      }
+      p++;
+    }
+    src->pos.col = line == NULL ? src->pos.col + (size_t)(p - start)
+                               : (size_t)(p - line);
+    src->off = p - src->data;
+    if (!closed) {
+      fail_at(src->pos, "unterminated %s literal",
+              quote == '"' ? "string" : "character");
+    }
+  } else {
+    p = start + scan_atom(start, end - start);
+    src->pos.col += p - start;
+    src->off = p - src->data;
+  }
+
+  size_t len = (size_t)(p - start);
+  int ch = srcfile_peek(src);
+  if (!atom_is_literal(start) || len <= OBJ_INLINE ||
+      (ch != EOF && !isspace(ch) && ch != '(' && ch != ')' && ch != ';')) {
+    // Symbols are interned and short atoms live in the node. So does a
+    // copy of a literal glued to the next atom ("a"b): that atom needs
+    // the byte a terminator would overwrite.
+    *o = obj_atom(parser->arena, start, len, o->beg);
+    return;
+  }
+
+  *o = obj_atom_ref(start, len, o->beg);
+  srcfile_terminate(src);
+}
+
+// A script's "#!" line, at the very start, is a comment.
+static bool shebang_p(const char *data, size_t len, size_t off) {
+  return off == 0 && len >= 2 && data[0] == '#' && data[1] == '!';
+}
+
+// Consumes whitespace and comments up to the next token, straight off
+// the buffer; a comment runs to the newline, which is then ordinary
+// whitespace.
+void parser_skip_blank(Parser *parser) {
+  SrcFile *src = parser->srcfile;
+  bool comment = false;
+  if (src->held != EOF) {
+    if (!isspace(src->held) && src->held != ';') {
+      return;
+    }
+    comment = src->held == ';';
+    srcfile_getc(src);
+  }
+
+  const char *data = src->data;
+  size_t off = src->off;
+  comment = comment || shebang_p(data, src->len, off);
+  while (off < src->len) {
+    char ch = data[off];
+    if (comment || ch == ';') {
+      const char *nl = memchr(data + off, '\n', src->len - off);
+      size_t stop = nl == NULL ? src->len : (size_t)(nl - data);
+      src->pos.col += stop - off;
+      off = stop;
+      comment = false;
+    } else if (ch == '\n') {
+      src->pos.row++;
+      src->pos.col = 0;
+      off++;
+    } else if (isspace((unsigned char)ch)) {
+      src->pos.col++;
+      off++;
+    } else {
+      break;
+    }
+  }
+  src->off = off;
+}
+
+static void parser_push(Parser *parser, Obj o) {
+  if (parser->stack_len >= parser->stack_buffer) {
+    size_t stack_buffer =
+        parser->stack_buffer == 0 ? 64 : parser->stack_buffer * 2;
+    parser->stack =
+        CHECK_ALLOC(realloc(parser->stack, stack_buffer * sizeof(Obj)));
+    parser->stack_buffer = stack_buffer;
+  }
+  parser->stack[parser->stack_len++] = o;
+}
+
+// Moves the nodes pushed since `base` into the arena as `form`'s children.
+static void parser_close(Parser *parser, Obj *form, size_t base) {
+  size_t n = parser->stack_len - base;
+  form->items = arena_alloc(parser->arena, n * sizeof(Obj));
+  if (n != 0) {
+    memcpy(form->items, parser->stack + base, n * sizeof(Obj));
+  }
+  form->len = (uint32_t)n;
+  parser->stack_len = base;
+}
+
+static void parser_open(Parser *parser, Obj form) {
+  if (parser->open_len >= parser->open_buffer) {
+    size_t open_buffer =
+        parser->open_buffer == 0 ? 64 : parser->open_buffer * 2;
+    parser->open =
+        CHECK_ALLOC(realloc(parser->open, open_buffer * sizeof(OpenForm)));
+    parser->open_buffer = open_buffer;
+  }
+  parser->open[parser->open_len++] =
+      (OpenForm){.form = form, .base = parser->stack_len};
+}
+
+// Reads up to the end of the next top-level form and leaves it on the
+// stack; false at the end of input.
+bool parser_next(Parser *parser) {
+  int ch;
+
+  while ((ch = srcfile_peek(parser->srcfile)) != EOF) {
+#ifdef DEBUG
+    printf("%c", ch);
+#endif
+
+    if (isspace(ch) || ch == ';' ||
+        shebang_p(parser->srcfile->data, parser->srcfile->len,
+                  parser->srcfile->off)) {
+      parser_skip_blank(parser);
+      continue;
+    }
+
+    if (ch == '(') {
+      parser_open(parser, (Obj){.beg = parser->srcfile->pos, .tag = SEXP});
+      srcfile_getc(parser->srcfile);
+      continue;
+    }
+
+    Obj o;
+    if (ch == ')') {
+      if (parser->open_len == 0) {
+        fail_at(parser->srcfile->pos, "unmatched ')'");
+      }
+      srcfile_getc(parser->srcfile);
+      OpenForm *open = &parser->open[--parser->open_len];
+      o = open->form;
+      parser_close(parser, &o, open->base);
+    } else {
+      o = (Obj){.beg = parser->srcfile->pos};
+      parser_atom(parser, &o);
+    }
+    o.end = parser->srcfile->pos;
+    parser_push(parser, o);
+    if (parser->open_len == 0) {
+      return true;
+    }
+  }
+
+  if (parser->open_len > 0) {
+    fail_at(parser->open[parser->open_len - 1].form.beg, "unclosed '('");
+  }
+  return false;
+}
+
+static void parser_check(Parser *parser) {
+  if (parser->srcfile == NULL) {
+    fail("Unable to access %s.", ctx->srcname);
+  }
+}
+
+void parser_parse(Parser *parser) {
+  parser_check(parser);
+  while (parser_next(parser)) {
+  }
+  parser_close(parser, parser->root, 0);
+}
+
+void parser_print(Parser *parser) {
+  printf("=== %s ===\n", parser->srcfile->name);
+  obj_print_tree(parser->root, 0);
+}
+
+// The tree is allocated from `arena`, which outlives the parser. The
+// parser owns `srcfile`, which may be NULL if it couldn't be read.
+Parser *parser_init(SrcFile *srcfile, Arena *arena) {
+  Parser *parser = CHECK_ALLOC(calloc(1, sizeof(Parser)));
+  parser->srcfile = srcfile;
+  parser->arena = arena;
+  parser->root = arena_alloc(arena, sizeof(Obj));
+  *parser->root = (Obj){.tag = SEXP};
+  return parser;
+}
+
+// Long atoms are slices of the source, so the parser must outlive the
+// tree.
+void parser_free(Parser *parser) {
+  if (parser->srcfile != NULL) {
+    srcfile_free(parser->srcfile);
+  }
+  free(parser->stack);
+  free(parser->open);
+  free(parser);
+}
+
+// === Macro expansion ===
+
+struct Macro {
+  char *name;    // borrowed from the defmacro form
+  uint32_t sym;
+  Obj *params;   // borrowed; atoms, last may end in "..."
+  bool has_rest;
+  Obj *template; // borrowed
+  Module *module; // if imported: params and template stay NULL until
+  uint32_t index; // module_macro_load builds them from its image
+};
+
+#define MACRO_MAX_DEPTH 200
+
+static Macro *macro_find(uint32_t sym) {
+  uint32_t i = sym == SYM_NONE ? 0 : symmap_get(&ctx->macro_index, sym);
+  return i == 0 ? NULL : &ctx->macros[i - 1];
+}
+
+static void module_macro_load(Macro *m);
+
+static void macro_add(Macro m) {
+  Context *c = ctx;
+  if (c->macros_len >= c->macros_buffer) {
+    size_t macros_buffer = c->macros_buffer == 0 ? 8 : c->macros_buffer * 2;
+    c->macros = CHECK_ALLOC(realloc(c->macros, macros_buffer * sizeof(Macro)));
+    c->macros_buffer = macros_buffer;
+  }
+  c->macros[c->macros_len++] = m;
+  symmap_put(&c->macro_index, m.sym, (uint32_t)c->macros_len);
+}
+
+static bool macro_param_is_rest(const char *name) {
+  size_t n = strlen(name);
+  return n > 3 && strcmp(name + n - 3, "...") == 0;
+}
+
+// The macro borrows from the form's children, which stay put in the
+// arena even after the form itself is dropped from the top level.
+static void macro_register(Obj *o) {
+  if (o->len != 4 || obj_at(o, 1)->tag != ATOM ||
+      obj_at(o, 1)->sym == SYM_NONE || obj_at(o, 2)->tag != SEXP) {
+    fail_at(o->beg, "defmacro needs a name, a parameter list, and one "
+                    "template form, e.g. (defmacro twice (x) (do x x))");
+  }
+
+  char *name = obj_text(obj_at(o, 1));
+  if (macro_find(obj_at(o, 1)->sym) != NULL) {
+    fail_at(obj_at(o, 1)->beg, "macro '%s' is already defined", name);
+  }
+
+  Obj *params = obj_at(o, 2);
+  bool has_rest = false;
+  for (size_t i = 0; i < params->len; i++) {
+    Obj *p = obj_at(params, i);
+    if (p->tag != ATOM) {
+      fail_at(p->beg, "macro parameters must be plain atoms");
+    }
+    if (macro_param_is_rest(obj_text(p))) {
+      if (i != params->len - 1) {
+        fail_at(p->beg, "only the last macro parameter may end in '...'");
+      }
+      has_rest = true;
+    }
+  }
+
+  macro_add((Macro){.name = name,
+                    .sym = obj_at(o, 1)->sym,
+                    .params = params,
+                    .has_rest = has_rest,
+                    .template = obj_at(o, 3)});
+}
+
+// A template node still to substitute, and where its result goes.
+typedef struct CopyJob {
+  Obj *src;
+  Obj *dst;
+} CopyJob;
+
+typedef struct CopyJobs {
+  CopyJob *jobs;
+  size_t len;
+  size_t buffer;
+} CopyJobs;
+
+static void copy_jobs_push(CopyJobs *q, Obj *src, Obj *dst) {
+  if (q->len >= q->buffer) {
+    size_t buffer = q->buffer == 0 ? 64 : q->buffer * 2;
+    q->jobs = CHECK_ALLOC(realloc(q->jobs, buffer * sizeof(CopyJob)));
+    q->buffer = buffer;
+  }
+  q->jobs[q->len++] = (CopyJob){.src = src, .dst = dst};
+}
+
+// A top-level form's key: a hash of it, and how many earlier forms
+// hashed the same. Forms written identically, or that collide, get
+// different ordinals, so keys are unique within a file.
+typedef struct FormKey {
+  uint32_t hash;
+  uint32_t ordinal;
+} FormKey;
+
+typedef struct FormKeys {
+  DefTable seen; // hash + 1 -> forms with that hash so far
+  Obj **walk;    // form_hash's stack
+  size_t walk_buffer;
+} FormKeys;
+
+// Template atoms ending in '#' (e.g. tmp#) rename to a fresh identifier,
+// shared within one expansion, unique across expansions. The map is
+// cleared between expansions rather than rebuilt. Names are numbered
+// within the top-level form being expanded and carry its key, not its
+// index, so they don't depend on the order forms are expanded in (-j),
+// and adding or removing a form leaves the others' C alone: an editor
+// syncing the C to clangd sends only what changed. They aren't
+// interned: nothing compares them, and workers can't write the table.
+typedef struct Gensyms {
+  SymMap map;  // template symbol, e.g. tmp#, -> index in names + 1
+  Obj *names;  // for this expansion, e.g. tmp__1f3a09c2_0
+  size_t len;
+  size_t buffer;
+  FormKey key; // of the top-level form
+  size_t next; // names generated so far within it
+} Gensyms;
+
+static void form_keys_free(FormKeys *g) {
+  deftable_free(&g->seen);
+  free(g->walk);
+}
+
+static bool sym_is_gensym(uint32_t sym) {
+  uint32_t n = ctx->symtab.lens[sym];
+  return sym != SYM_NONE && n >= 2 && ctx->symtab.names[sym][n - 1] == '#';
+}
+
+static Obj gensym_lookup(Arena *arena, Gensyms *g, uint32_t sym, Pos pos) {
+  uint32_t i = symmap_get(&g->map, sym);
+  if (i != 0) {
+    Obj o = g->names[i - 1];
+    o.beg = o.end = pos;
+    return o;
+  }
+
+  size_t n = ctx->symtab.lens[sym];
+  char name[n + 64];
+  int len = g->key.ordinal == 0
+                ? snprintf(name, n + 64, "%.*s__%08" PRIx32 "_%zu",
+                           (int)(n - 1), sym_name(sym), g->key.hash,
+                           g->next++)
+                : snprintf(name, n + 64, "%.*s__%08" PRIx32 "_%" PRIu32 "_%zu",
+                           (int)(n - 1), sym_name(sym), g->key.hash,
+                           g->key.ordinal, g->next++);
+  char *text = name;
+  if ((size_t)len > OBJ_INLINE) {
+    text = arena_alloc(arena, (size_t)len + 1);
+    memcpy(text, name, (size_t)len + 1);
+  }
+  if (g->len >= g->buffer) {
+    size_t buffer = g->buffer == 0 ? 8 : g->buffer * 2;
+    g->names = CHECK_ALLOC(realloc(g->names, buffer * sizeof(Obj)));
+    g->buffer = buffer;
+  }
+  g->names[g->len++] = obj_atom_ref(text, (size_t)len, pos);
+  symmap_put(&g->map, sym, (uint32_t)g->len);
+  return g->names[g->len - 1];
+}
+
+static bool macro_splices(Macro *m, Obj *child) {
+  return child->tag == ATOM && m->has_rest &&
+         child->sym == obj_at(m->params, m->params->len - 1)->sym;
+}
+
+// Only the template is copied. Its nodes are stamped with the call's
+// span and marked expanded, so diagnostics, #line directives and source
+// maps point at the user's code, not the template, and the map can name
+// the call. Arguments are not copied at all: the expansion shares the
+// call's argument nodes, which keep the positions they were written at,
+// and marks them shared so expand_obj copies before rewriting inside
+// them. Children are queued in reverse, so nodes are visited in source
+// order (gensyms number the same as a recursive walk would).
+static Obj macro_substitute(Arena *arena, Macro *m, Obj *call,
+                            Gensyms *gensyms, CopyJobs *q) {
+  Pos pos = call->beg;
+  Pos end = call->end;
+  Obj result;
+  copy_jobs_push(q, m->template, &result);
+
+  while (q->len > 0) {
+    CopyJob job = q->jobs[--q->len];
+    Obj *t = job.src;
+
+    if (t->tag == ATOM) {
+      *job.dst = *t;
+      job.dst->beg = pos;
+      job.dst->end = end;
+      job.dst->expanded = true;
+      bool param_found = false;
+      for (size_t i = 0; i < m->params->len && !param_found; i++) {
+        Obj *param = obj_at(m->params, i);
+        if (t->sym != param->sym || t->sym == SYM_NONE) {
+          continue;
+        }
+        if (m->has_rest && i == m->params->len - 1) {
+          fail_at(pos,
+                  "rest parameter '%s' of macro '%s' can only be spliced "
+                  "inside a form",
+                  obj_text(param), m->name);
+        }
+        *job.dst = *obj_at(call, i + 1);
+        job.dst->shared = job.dst->tag == SEXP;
+        param_found = true;
+      }
+      if (!param_found && sym_is_gensym(t->sym)) {
+        *job.dst = gensym_lookup(arena, gensyms, t->sym, pos);
+        job.dst->end = end;
+        job.dst->expanded = true;
+      }
+      continue;
+    }
+
+    // Children are one contiguous run, so size it before filling it.
+    size_t rest = call->len - m->params->len;
+    size_t n = 0;
+    for (size_t i = 0; i < t->len; i++) {
+      n += macro_splices(m, obj_at(t, i)) ? rest : 1;
+    }
+
+    Obj *out = job.dst;
+    *out = (Obj){.beg = pos,
+                 .end = end,
+                 .tag = SEXP,
+                 .expanded = true,
+                 .len = (uint32_t)n};
+    out->items = arena_alloc(arena, n * sizeof(Obj));
+    size_t k = n;
+    for (size_t i = t->len; i-- > 0;) {
+      Obj *child = obj_at(t, i);
+      if (!macro_splices(m, child)) {
+        copy_jobs_push(q, child, &out->items[--k]);
+        continue;
+      }
+      for (size_t j = call->len; j-- > m->params->len;) {
+        Obj *arg = &out->items[--k];
+        *arg = *obj_at(call, j);
+        arg->shared = arg->tag == SEXP;
+      }
+    }
+  }
+  return result;
+}
+
+static Obj macro_expand_call(Arena *arena, Macro *m, Obj *call,
+                             Gensyms *gensyms, CopyJobs *q) {
+  size_t fixed = m->params->len - (m->has_rest ? 1 : 0);
+  size_t given = call->len - 1;
+  if (given < fixed || (!m->has_rest && given > fixed)) {
+    fail_at(call->beg, "macro '%s' takes %s%zu argument%s, got %zu", m->name,
+            m->has_rest ? "at least " : "", fixed, fixed == 1 ? "" : "s",
+            given);
+  }
+
+  symmap_clear(&gensyms->map);
+  gensyms->len = 0;
+  return macro_substitute(arena, m, call, gensyms, q);
+}
+
+// A form whose children are being expanded: the next one to visit, how
+// many expansions produced the form, and whether its children array may
+// be reachable from elsewhere (it is, or sits inside, a shared node).
+typedef struct ExpandFrame {
+  Obj *o;
+  uint32_t next;
+  bool shared;
+  size_t depth;
+} ExpandFrame;
+
+struct Expander {
+  Arena *arena;
+  ExpandFrame *frames; // the path from the top-level form down
+  size_t len;
+  size_t buffer;
+  CopyJobs copies;
+  Gensyms gensyms;
+  FormKeys keys;  // numbers the top-level forms; -j's workers don't
+  size_t visible; // macros defined before the form being expanded
+  SymMap *heads;  // if set, collects every head looked up as a macro
+};
+
+static void expander_enter(Expander *ex, Obj *o, bool shared, size_t depth) {
+  if (ex->len >= ex->buffer) {
+    size_t buffer = ex->buffer == 0 ? 64 : ex->buffer * 2;
+    ex->frames = CHECK_ALLOC(realloc(ex->frames, buffer * sizeof(ExpandFrame)));
+    ex->buffer = buffer;
+  }
+  ex->frames[ex->len++] = (ExpandFrame){
+      .o = o, .next = 0, .shared = shared || o->shared, .depth = depth};
+}
+
+// Copy-on-write: makes the slot of the child being visited safe to
+// overwrite by giving each shared form on the path a private copy of its
+// children, top down. The copied children now share their own children
+// with the originals, so they are marked shared in turn. Returns the
+// slot's new address.
+static Obj *expander_own(Expander *ex) {
+  size_t top = ex->len - 1;
+  size_t first = top + 1;
+  while (first > 0 && ex->frames[first - 1].shared) {
+    first--;
+  }
+  for (size_t k = first; k <= top; k++) {
+    ExpandFrame *f = &ex->frames[k];
+    Obj *copy = arena_alloc(ex->arena, f->o->len * sizeof(Obj));
+    memcpy(copy, f->o->items, f->o->len * sizeof(Obj));
+    for (uint32_t i = 0; i < f->o->len; i++) {
+      copy[i].shared = copy[i].tag == SEXP;
+    }
+    f->o->items = copy;
+    f->o->shared = false;
+    f->shared = false;
+    if (k < top) {
+      ex->frames[k + 1].o = &copy[f->next - 1];
+    }
+  }
+  return &ex->frames[top].o->items[ex->frames[top].next - 1];
+}
+
+// Outermost-first: keep expanding the head until it is no longer a macro.
+// Macro invocations look like calls — a form whose head atom names a
+// macro; bare atoms never expand. `o` is the node's slot, or NULL when
+// it is the visited child of the innermost frame and may need copying
+// out of a shared form first. Returns the slot, which may have moved.
+static Obj *expand_head(Expander *ex, Obj *o, size_t *depth) {
+  Obj *slot = o;
+  if (o == NULL) {
+    ExpandFrame *f = &ex->frames[ex->len - 1];
+    o = &f->o->items[f->next - 1];
+  }
+
+  while (o->tag == SEXP && o->len > 0 && obj_at(o, 0)->tag == ATOM) {
+    uint32_t head = obj_at(o, 0)->sym;
+    if (head == SYM_DEFMACRO) {
+      fail_at(o->beg, "defmacro is only allowed at the top level");
+    }
+
+    if (ex->heads != NULL && head != SYM_NONE) {
+      symmap_put(ex->heads, head, 1);
+    }
+    Macro *m = macro_find(head);
+    if (m == NULL || (size_t)(m - ctx->macros) >= ex->visible) {
+      break;
+    }
+    if (m->template == NULL) {
+      module_macro_load(m);
+    }
+    if ((*depth)++ >= MACRO_MAX_DEPTH) {
+      fail_at(o->beg,
+              "macro expansion nested deeper than %d levels; is '%s' "
+              "recursive?",
+              MACRO_MAX_DEPTH, m->name);
+    }
+
+    Obj result = macro_expand_call(ex->arena, m, o, &ex->gensyms, &ex->copies);
+    if (slot == NULL) {
+      slot = ex->frames[ex->len - 1].shared ? expander_own(ex) : o;
+    }
+    *slot = result;
+    o = slot;
+  }
+  return o;
+}
+
+// Children are visited in order from a stack of frames, the path down
+// from `top`, rather than by recursing. Nodes are rewritten in place.
+static void expand_obj(Expander *ex, Obj *top) {
+  size_t depth = 0;
+  expand_head(ex, top, &depth);
+  if (top->tag != SEXP) {
+    return;
+  }
+  expander_enter(ex, top, false, depth);
+
+  while (ex->len > 0) {
+    ExpandFrame *f = &ex->frames[ex->len - 1];
+    if (f->next == f->o->len) {
+      ex->len--;
+      continue;
+    }
+    f->next++;
+    depth = f->depth;
+    Obj *child = expand_head(ex, NULL, &depth);
+    if (child->tag == SEXP) {
+      expander_enter(ex, child, ex->frames[ex->len - 1].shared, depth);
+    }
+  }
+}
+
+static void expander_free(Expander *ex) {
+  free(ex->frames);
+  free(ex->copies.jobs);
+  symmap_free(&ex->gensyms.map);
+  free(ex->gensyms.names);
+  form_keys_free(&ex->keys);
+}
+
+// A top-level defmacro is registered rather than expanded. The macro
+// borrows the form's children, so they must outlive every later
+// expansion.
+static bool form_is_defmacro(Obj *o) {
+  return o->tag == SEXP && o->len > 0 && obj_at(o, 0)->tag == ATOM &&
+         obj_at(o, 0)->sym == SYM_DEFMACRO;
+}
+
+static uint64_t key_mix(uint64_t h, const void *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    h = (h ^ ((const unsigned char *)data)[i]) * 1099511628211u;
+  }
+  return h;
+}
+
+// A hash of the form's atoms and shape, before expansion: each node in
+// preorder as its tag, length and, for an atom, text.
+static uint32_t form_hash(FormKeys *g, Obj *o) {
+  if (g->walk_buffer == 0) {
+    g->walk = CHECK_ALLOC(malloc(64 * sizeof(Obj *)));
+    g->walk_buffer = 64;
+  }
+  uint64_t h = 14695981039346656037u;
+  size_t len = 0;
+  g->walk[len++] = o;
+  while (len > 0) {
+    Obj *n = g->walk[--len];
+    unsigned char tag = n->tag;
+    h = key_mix(h, &tag, 1);
+    h = key_mix(h, &n->len, sizeof(n->len));
+    if (n->tag == ATOM) {
+      h = key_mix(h, obj_text(n), n->len);
+      continue;
+    }
+    if (len + n->len > g->walk_buffer) {
+      size_t walk_buffer = (len + n->len) * 2;
+      g->walk = CHECK_ALLOC(realloc(g->walk, walk_buffer * sizeof(Obj *)));
+      g->walk_buffer = walk_buffer;
+    }
+    for (size_t i = n->len; i > 0; i--) {
+      g->walk[len++] = obj_at(n, i - 1);
+    }
+  }
+  return (uint32_t)(h ^ (h >> 32));
+}
+
+// Numbers the next form with `hash`. Forms are numbered in source
+// order, whichever order they're expanded in. One that sees no macros
+// can't make gensyms, so it isn't counted.
+static FormKey form_number(FormKeys *g, uint32_t hash, size_t visible) {
+  if (visible == 0) {
+    return (FormKey){.hash = hash};
+  }
+  uint64_t n = deftable_get(&g->seen, (uint64_t)hash + 1);
+  deftable_put(&g->seen, (uint64_t)hash + 1, n + 1);
+  return (FormKey){.hash = hash, .ordinal = (uint32_t)n};
+}
+
+static FormKey form_key(FormKeys *g, Obj *o, size_t visible) {
+  return visible == 0 ? (FormKey){0}
+                      : form_number(g, form_hash(g, o), visible);
+}
+
+// Expands the top-level form `o` in place, seeing only the first
+// `visible` macros (definitions must precede uses), with `key` from
+// form_key.
+static void expand_form(Expander *ex, Obj *o, size_t visible, FormKey key) {
+  ex->visible = visible;
+  ex->gensyms.key = key;
+  ex->gensyms.next = 0;
+  expand_obj(ex, o);
+}
+
+static bool form_is_import(Obj *o) {
+  return o->tag == SEXP && o->len > 0 && obj_at(o, 0)->tag == ATOM &&
+         obj_at(o, 0)->sym == SYM_IMPORT;
+}
+
+static void module_import(Obj *o);
+static void module_load_all(void);
+
+// Consumes defmacro forms and expands everything else in place;
+// expansions are allocated from `arena`. An import is kept, to emit the
+// declarations it brought in.
+void expand_toplevel(Obj *top, Arena *arena) {
+  Expander *ex = ctx->expander = CHECK_ALLOC(calloc(1, sizeof(Expander)));
+  ex->arena = arena;
+  size_t kept = 0;
+  for (size_t i = 0; i < top->len; i++) {
+    Obj *o = obj_at(top, i);
+    if (form_is_defmacro(o)) {
+      macro_register(o);
+      continue;
+    }
+    if (form_is_import(o)) {
+      module_import(o);
+    }
+    expand_form(ex, o, ctx->macros_len,
+                form_key(&ex->keys, o, ctx->macros_len));
+    top->items[kept++] = *o;
+  }
+  top->len = (uint32_t)kept;
+  expander_free(ex);
+  free(ex);
+  ctx->expander = NULL;
+}
+
+void ccode_free(CCode *code);
+static void incremental_free(Incremental *inc);
+static void module_free(Module *mod);
+
+static void context_reset(Context *c) {
+  if (c->parser != NULL) {
+    parser_free(c->parser);
+  }
+  if (c->expander != NULL) {
+    expander_free(c->expander);
+    free(c->expander);
+  }
+  if (c->code != NULL) {
+    ccode_free(c->code);
+  }
+  if (c->header != NULL) {
+    ccode_free(c->header);
+  }
+  if (c->incremental != NULL) {
+    incremental_free(c->incremental);
+  }
+  for (size_t i = 0; i < c->modules_len; i++) {
+    module_free(c->modules[i]);
+  }
+  free(c->modules);
+  free(c->imports);
+  arena_free(&c->module_arena);
+  free(c->macros);
+  symmap_free(&c->macro_index);
+  symtab_free(&c->symtab);
+  arena_free(&c->arena);
+  *c = (Context){.srcname = c->srcname,
+                 .caches = c->caches,
+                 .caches_len = c->caches_len,
+                 .calls = c->calls,
+                 .failure = c->failure,
+                 .error = c->error,
+                 .imported = c->imported};
+}
+
+// === Output behavior ===
+
+CCode *ccode_init() {
+  CCode *code = CHECK_ALLOC(calloc(1, sizeof(CCode)));
+  return code;
+}
+
+// For the call's C, mapped back to the source if the call asked.
+static CCode *ccode_output(void) {
+  CCode *code = ccode_init();
+  code->mapping = ctx->mapping;
+  return code;
+}
+
+void ccode_free(CCode *code) {
+  free(code->out.data);
+  free(code->lines);
+  free(code->work.ops);
+  free(code->deferred.ops);
+  free(code->texts.data);
+  free(code->map.spans);
+  free(code);
+}
+
+static void buf_reserve(Buf *buf, size_t more) {
+  if (buf->len + more <= buf->cap) {
+    return;
+  }
+  size_t cap = buf->cap == 0 ? 4096 : buf->cap;
+  while (buf->len + more > cap) {
+    cap *= 2;
+  }
+  buf->data = CHECK_ALLOC(realloc(buf->data, cap));
+  buf->cap = cap;
+}
+
+static void buf_write(Buf *buf, const char *text, size_t len) {
+  if (len == 0) {
+    return;
+  }
+  buf_reserve(buf, len);
+  memcpy(buf->data + buf->len, text, len);
+  buf->len += len;
+}
+
+// Formats at the end of `buf`, '\0'-terminated but not counting the
+// terminator. One pass, unless the text outgrows the spare room.
+static void buf_vprintf(Buf *buf, const char *format, va_list args) {
+  buf_reserve(buf, 256);
+  va_list retry;
+  va_copy(retry, args);
+  size_t room = buf->cap - buf->len;
+  int result = vsnprintf(buf->data + buf->len, room, format, args);
+  if (result >= 0 && (size_t)result >= room) {
+    buf_reserve(buf, (size_t)result + 1);
+    result = vsnprintf(buf->data + buf->len, (size_t)result + 1, format, retry);
+  }
+  va_end(retry);
+  if (result < 0) {
+    fail("internal error: couldn't format generated C");
+  }
+  buf->len += (size_t)result;
+}
+
+static void ccode_new_line(CCode *code) {
+  if (code->count >= code->buffer) {
+    size_t buffer = code->buffer == 0 ? 1024 : code->buffer * 2;
+    code->lines = CHECK_ALLOC(realloc(code->lines, buffer * sizeof(size_t)));
+    code->buffer = buffer;
+  }
+  if (code->count > 0) {
+    buf_write(&code->out, "\n", 1);
+  }
+  code->lines[code->count++] = code->out.len;
+}
+
+static void emit_push(EmitStack *stack, EmitOp op) {
+  if (stack->len >= stack->buffer) {
+    size_t buffer = stack->buffer == 0 ? 64 : stack->buffer * 2;
+    stack->ops = CHECK_ALLOC(realloc(stack->ops, buffer * sizeof(EmitOp)));
+    stack->buffer = buffer;
+  }
+  stack->ops[stack->len++] = op;
+}
+
+// Output that follows a deferred child is recorded instead of written,
+// so it lands after the child's.
+static void emit_defer_text(CCode *code, EmitKind kind, const char *format,
+                            va_list args) {
+  size_t text = code->texts.len;
+  buf_vprintf(&code->texts, format, args);
+  code->texts.len++; // keep the '\0'
+  emit_push(&code->deferred, (EmitOp){.kind = kind,
+                                      .text = text,
+                                      .owner = code->owner,
+                                      .call = code->call});
+}
+
+// Adds `span`, or lengthens the last one if it picks up where that left
+// off for the same node.
+static void span_push(SpanList *map, SicSpan span) {
+  if (map->len > 0) {
+    SicSpan *last = &map->spans[map->len - 1];
+    if (last->c_line == span.c_line && last->c_end == span.c_column &&
+        last->line == span.line && last->column == span.column &&
+        last->end_line == span.end_line &&
+        last->end_column == span.end_column &&
+        last->call_line == span.call_line &&
+        last->call_column == span.call_column) {
+      last->c_end = span.c_end;
+      return;
+    }
+  }
+  if (map->len >= map->buffer) {
+    size_t buffer = map->buffer == 0 ? 256 : map->buffer * 2;
+    map->spans = CHECK_ALLOC(realloc(map->spans, buffer * sizeof(SicSpan)));
+    map->buffer = buffer;
+  }
+  map->spans[map->len++] = span;
+}
+
+// Hands `map` over as out->spans, 1-based.
+static void span_finish(SpanList *map, SicOutput *out) {
+  for (size_t i = 0; i < map->len; i++) {
+    SicSpan *span = &map->spans[i];
+    span->c_line++;
+    span->c_column++;
+    span->c_end++;
+    span->line++;
+    span->column++;
+    span->end_line++;
+    span->end_column++;
+  }
+  out->spans = map->spans;
+  out->spans_len = map->len;
+  *map = (SpanList){0};
+}
+
+// Maps what was just written to the current line from `beg` on.
+static void ccode_map(CCode *code, size_t beg) {
+  if (!code->mapping || code->owner == NULL || beg == code->out.len) {
+    return;
+  }
+  size_t line = code->lines[code->count - 1];
+  Obj *o = code->owner;
+  Obj *call = code->call;
+  span_push(&code->map, (SicSpan){.c_line = (uint32_t)(code->count - 1),
+                             .c_column = (uint32_t)(beg - line),
+                             .c_end = (uint32_t)(code->out.len - line),
+                             .line = o->beg.row,
+                             .column = o->beg.col,
+                             .end_line = o->end.row,
+                             .end_column = o->end.col,
+                             .call_line = call ? call->beg.row + 1 : 0,
+                             .call_column = call ? call->beg.col + 1 : 0});
+}
+
+static void ccode_vprintf_line(CCode *code, const char *format,
+                               va_list args) {
+  ccode_new_line(code);
+  size_t beg = code->out.len;
+  buf_vprintf(&code->out, format, args);
+  ccode_map(code, beg);
+}
+
+static void ccode_vappend(CCode *code, const char *format, va_list args) {
+  if (code->count == 0) {
+    ccode_new_line(code);
+  }
+  size_t beg = code->out.len;
+  buf_vprintf(&code->out, format, args);
+  ccode_map(code, beg);
+}
+
+void ccode_printf_line(CCode *code, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  if (code->deferring) {
+    emit_defer_text(code, EMIT_LINE, format, args);
+  } else {
+    ccode_vprintf_line(code, format, args);
+  }
+  va_end(args);
+}
+
+void ccode_append(CCode *code, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  if (code->deferring) {
+    emit_defer_text(code, EMIT_APPEND, format, args);
+  } else {
+    ccode_vappend(code, format, args);
+  }
+  va_end(args);
+}
+
+void ccode_mark_line(CCode *code, Obj *o) {
+#ifndef DISABLE_LINE
+  if (code->unmarked) {
+    return;
+  }
+  Obj *owner = code->owner; // markers aren't mapped
+  code->owner = NULL;
+  ccode_printf_line(code, "#line %" PRIu32 " \"%s\"", o->beg.row + 1,
+                    ctx->srcname);
+  code->owner = owner;
+#endif
+}
+
+void ccode_write(CCode *code, FILE *stream) {
+  if (code->count > 0) {
+    fwrite(code->out.data, 1, code->out.len, stream);
+    fputc('\n', stream);
+  }
+}
+
+// Writes what has been generated so far and starts over empty. Only
+// call it between top-level forms, which always begin a new line.
+void ccode_flush(CCode *code, FILE *stream) {
+  ccode_write(code, stream);
+  code->out.len = 0;
+  code->count = 0;
+}
+
+// Hands over everything generated as one '\0'-terminated string, ending
+// in a newline as ccode_write's output does, and leaves `code` empty.
+char *ccode_take(CCode *code, size_t *len) {
+  if (code->count > 0) {
+    buf_write(&code->out, "\n", 1);
+  }
+  buf_write(&code->out, "", 1);
+  char *c = code->out.data;
+  *len = code->out.len - 1;
+  code->out = (Buf){0};
+  code->count = 0;
+  return c;
+}
+
+// Appends `run`'s lines after `code`'s, as if they had been generated
+// there.
+void ccode_join(CCode *code, CCode *run) {
+  for (size_t i = 0; i < run->map.len; i++) {
+    SicSpan span = run->map.spans[i];
+    span.c_line += (uint32_t)code->count;
+    span_push(&code->map, span);
+  }
+  for (size_t i = 0; i < run->count; i++) {
+    size_t end = i + 1 < run->count ? run->lines[i + 1] - 1 : run->out.len;
+    ccode_new_line(code);
+    buf_write(&code->out, run->out.data + run->lines[i], end - run->lines[i]);
+  }
+}
+
+// === Transpiler ===
+// Feeling this out, will need to be dramatically rewritten
+
+// ":const-char*" becomes a malloc'd "const char*"; hyphens are illegal in
+// C type names so the mapping is unambiguous. Translation stops at '[' to
+// leave array-size expressions alone.
+char *type_to_c(const char *atom) {
+  char *type = CHECK_ALLOC(strdup(atom + 1));
+  for (char *p = type; *p != '\0' && *p != '['; p++) {
+    if (*p == '-') {
+      *p = ' ';
+    }
+  }
+  return type;
+}
+
+// Appends "type name" with any array suffix moved after the name, as C
+// declarators want: (x :int[4]) becomes "int x[4]".
+void ccode_append_declarator(CCode *code, const char *type_atom,
+                             const char *name) {
+  char *type = type_to_c(type_atom);
+  char *bits = strchr(type, ':');
+  if (bits != NULL) {
+    ccode_append(code, "%.*s %s : %s", (int)(bits - type), type, name,
+                 bits + 1);
+    free(type);
+    return;
+  }
+
+  char *arr = strchr(type, '[');
+  if (arr == NULL) {
+    arr = type + strlen(type);
+  }
+  ccode_append(code, "%.*s %s%s", (int)(arr - type), type, name, arr);
+  free(type);
+}
+
+// Like ccode_append_declarator, but the type may also be a
+// (fnptr :ret (:argtypes...)) form, emitted as "ret (*name)(args)".
+void ccode_append_declarator_obj(CCode *code, Obj *type, const char *name) {
+  if (type->tag == ATOM && obj_text(type)[0] == ':') {
+    ccode_append_declarator(code, obj_text(type), name);
+    return;
+  }
+
+  if (type->tag == SEXP && type->len == 3 && obj_at(type, 0)->tag == ATOM &&
+      obj_at(type, 0)->sym == SYM_FNPTR &&
+      obj_at(type, 1)->tag == ATOM && obj_text(obj_at(type, 1))[0] == ':' &&
+      obj_at(type, 2)->tag == SEXP) {
+    char *ret = type_to_c(obj_text(obj_at(type, 1)));
+    ccode_append(code, "%s (*%s)(", ret, name);
+    free(ret);
+
+    Obj *args = obj_at(type, 2);
+    if (args->len == 0) {
+      ccode_append(code, "void");
+    }
+    for (size_t i = 0; i < args->len; i++) {
+      Obj *arg = obj_at(args, i);
+      if (arg->tag != ATOM || obj_text(arg)[0] != ':') {
+        fail_at(arg->beg, "fnptr argument types must be :type atoms");
+      }
+      char *arg_type = type_to_c(obj_text(arg));
+      ccode_append(code, "%s%s", i == 0 ? "" : ", ", arg_type);
+      free(arg_type);
+    }
+    ccode_append(code, ")");
+    return;
+  }
+
+  fail_at(type->beg, "expected a :type or (fnptr :ret (:argtypes...))");
+}
+
+static const TRule TRANSPILE_RULES[] = {
+    {"#include", transpile_include, STATEMENT},
+    {"#define", transpile_define, STATEMENT},
+    {"#undef", transpile_undef, STATEMENT},
+    {"#ifdef #ifndef #if", transpile_guard, STATEMENT},
+    {"#else", transpile_hash_else, STATEMENT},
+    {"#pragma", transpile_pragma, STATEMENT},
+    {"fn", transpile_fn, STATEMENT},
+    {"return", transpile_return, STATEMENT},
+    {"-= += *= /= %= &= |= ^= <<= >>=", transpile_op_assign, EXPRESSION},
+    {"++ --", transpile_incdec, EXPRESSION},
+    {"+ - * / % < > <= >= == != && || & | ^ << >> ! ~ ,", transpile_binary_op,
+     EXPRESSION},
+    {"deref", transpile_deref, EXPRESSION},
+    {"aref", transpile_aref, EXPRESSION},
+    {"-> .", transpile_member, EXPRESSION},
+    {"decl", transpile_decl, STATEMENT},
+    {"set", transpile_set, EXPRESSION},
+    {"while", transpile_while, STATEMENT},
+    {"for", transpile_for, STATEMENT},
+    {"if", transpile_if, STATEMENT},
+    {"do", transpile_do, STATEMENT},
+    {"?:", transpile_ternary, EXPRESSION},
+    {"sizeof", transpile_sizeof, EXPRESSION},
+    {"init", transpile_init, EXPRESSION},
+    {"offsetof alignof", transpile_typeop, EXPRESSION},
+    {"switch", transpile_switch, STATEMENT},
+    {"do-while", transpile_do_while, STATEMENT},
+    {"goto label", transpile_goto, STATEMENT},
+    {"launch", transpile_launch, EXPRESSION},
+    {"struct union", transpile_struct, STATEMENT},
+    {"enum", transpile_enum, STATEMENT},
+    {"typedef", transpile_typedef, STATEMENT},
+    {"import", transpile_import, STATEMENT},
+    {":...", transpile_cast, EXPRESSION},
+    {"...", transpile_call, EXPRESSION},
+};
+#define TRANSPILE_RULE_LEN (sizeof(TRANSPILE_RULES) / sizeof(TRule))
+
+static bool word_is_prefix(const char *word, size_t len) {
+  return len >= 3 && memcmp(word + len - 3, "...", 3) == 0;
+}
+
+static bool rule_matches(const TRule *rule, const char *head) {
+  size_t n = strlen(head);
+  for (const char *p = rule->match; *p != '\0';) {
+    size_t len = strcspn(p, " ");
+    if (word_is_prefix(p, len) ? n >= len - 3 && memcmp(p, head, len - 3) == 0
+                               : n == len && memcmp(p, head, n) == 0) {
+      return true;
+    }
+    p += len + (p[len] == ' ');
+  }
+  return false;
+}
+
+static const TRule *rule_scan(const char *head) {
+  for (size_t i = 0; i < TRANSPILE_RULE_LEN; i++) {
+    if (rule_matches(&TRANSPILE_RULES[i], head)) {
+      return &TRANSPILE_RULES[i];
+    }
+  }
+  return NULL;
+}
+
+static const TRule **by_sym;
+static uint32_t by_sym_len;
+static const TRule *prefixed[TRANSPILE_RULE_LEN];
+static size_t prefixed_len;
+static pthread_once_t rules_once = PTHREAD_ONCE_INIT;
+
+// symtab_init calls this, so the exact heads have the same ids in every
+// context.
+static void rules_intern(void) {
+  for (size_t i = 0; i < TRANSPILE_RULE_LEN; i++) {
+    for (const char *p = TRANSPILE_RULES[i].match; *p != '\0';) {
+      size_t len = strcspn(p, " ");
+      if (!word_is_prefix(p, len)) {
+        sym_intern(p, len);
+      }
+      p += len + (p[len] == ' ');
+    }
+  }
+}
+
+// Every symbol up to the last exact head is resolved, by rule_scan, into
+// `by_sym`. Those ids are the same in every context, so this is done
+// once, by whichever thread looks up a rule first.
+static void rules_init(void) {
+  uint32_t max = 0;
+  for (size_t i = 0; i < TRANSPILE_RULE_LEN; i++) {
+    bool has_prefix = false;
+    for (const char *p = TRANSPILE_RULES[i].match; *p != '\0';) {
+      size_t len = strcspn(p, " ");
+      if (word_is_prefix(p, len)) {
+        has_prefix = true;
+      } else {
+        uint32_t sym = sym_intern(p, len);
+        max = sym > max ? sym : max;
+      }
+      p += len + (p[len] == ' ');
+    }
+    if (has_prefix) {
+      prefixed[prefixed_len++] = &TRANSPILE_RULES[i];
+    }
+  }
+  by_sym_len = max + 1;
+  by_sym = CHECK_ALLOC(calloc(by_sym_len, sizeof(TRule *)));
+  for (uint32_t sym = 1; sym < by_sym_len; sym++) {
+    by_sym[sym] = rule_scan(sym_name(sym));
+  }
+}
+
+// The first rule that matches the head decides what a form is. Every
+// lookup goes through here, so the table stays the one place that says
+// which head means which rule. A head outside `by_sym` can only match a
+// prefix, so only rules with prefix words are tried for it, in table
+// order.
+static const TRule *rule_for(Obj *head) {
+  pthread_once(&rules_once, rules_init);
+  if (head->sym != SYM_NONE && head->sym < by_sym_len) {
+    return by_sym[head->sym];
+  }
+  char *text = obj_text(head);
+  for (size_t i = 0; i < prefixed_len; i++) {
+    if (rule_matches(prefixed[i], text)) {
+      return prefixed[i];
+    }
+  }
+  return NULL;
+}
+
+// `parens` is false only where the caller already emits the pair C
+// requires, so the operator doesn't add a second, redundant one.
+static void binary_op_emit(Obj *o, CCode *code, bool parens) {
+  char *op = obj_text(obj_at(o, 0));
+  bool prefix_ok = op[1] == '\0' && strchr("+-*&!~", op[0]) != NULL;
+  bool prefix_only = op[1] == '\0' && (op[0] == '!' || op[0] == '~');
+  uint32_t sym = obj_at(o, 0)->sym;
+  bool comparison = sym >= SYM_LT && sym <= SYM_NE;
+
+  if (o->len == 2 && prefix_ok) {
+    if (parens) {
+      ccode_append(code, "(");
+    }
+    ccode_append(code, "%s", op);
+    transpile_expression(obj_at(o, 1), code);
+    if (parens) {
+      ccode_append(code, ")");
+    }
+    return;
+  }
+
+  if (prefix_only) {
+    fail_at(o->beg, "operator '%s' takes exactly one operand", op);
+  }
+  if (comparison && o->len != 3) {
+    fail_at(o->beg, "comparison operator '%s' takes exactly two operands", op);
+  }
+  if (o->len < 3) {
+    fail_at(o->beg, "operator '%s' needs at least two operands", op);
+  }
+
+  if (parens) {
+    ccode_append(code, "(");
+  }
+  for (size_t i = 1; i < o->len; i++) {
+    if (i != 1) {
+      ccode_append(code, " %s ", op);
+    }
+    transpile_expression(obj_at(o, i), code);
+  }
+  if (parens) {
+    ccode_append(code, ")");
+  }
+}
+
+void transpile_binary_op(Obj *o, CCode *code) { binary_op_emit(o, code, true); }
+
+// if/while/do-while already wrap the condition in the parens C requires,
+// so an operator form there would emit a second pair. Beyond being noise,
+// clang reads the doubled pair in if ((a == b)) as a typo'd assignment
+// and warns (-Wparentheses-equality).
+void transpile_condition(Obj *o, CCode *code) {
+  if (o->tag == SEXP && o->len > 0 && obj_at(o, 0)->tag == ATOM) {
+    const TRule *rule = rule_for(obj_at(o, 0));
+    if (rule != NULL && rule->fn == transpile_binary_op) {
+      binary_op_emit(o, code, false);
+      return;
+    }
+  }
+  transpile_expression(o, code);
+}
+
+void transpile_incdec(Obj *o, CCode *code) {
+  if (o->len != 2) {
+    fail_at(o->beg, "'%s' takes exactly one operand", obj_text(obj_at(o, 0)));
+  }
+
+  ccode_append(code, "(%s", obj_text(obj_at(o, 0)));
+  transpile_expression(obj_at(o, 1), code);
+  ccode_append(code, ")");
+}
+
+void transpile_decl(Obj *o, CCode *code) {
+  if ((o->len != 3 && o->len != 4) || obj_at(o, 1)->tag != ATOM) {
+    fail_at(o->beg, "decl needs a name and a :type, with at most one "
+                    "initializer, e.g. (decl x :int 1)");
+  }
+
+  ccode_mark_line(code, o);
+  ccode_printf_line(code, "");
+  ccode_append_declarator_obj(code, obj_at(o, 2), obj_text(obj_at(o, 1)));
+  if (o->len > 3) {
+    ccode_append(code, " = ");
+    transpile_expression(obj_at(o, 3), code);
+  }
+  ccode_append(code, ";");
+}
+
+void transpile_set(Obj *o, CCode *code) {
+  if (o->len != 3) {
+    fail_at(o->beg, "set needs a place and a value, e.g. (set x 1)");
+  }
+
+  ccode_append(code, "(");
+  transpile_expression(obj_at(o, 1), code);
+  ccode_append(code, " = ");
+  transpile_expression(obj_at(o, 2), code);
+  ccode_append(code, ")");
+};
+
+// Postfix operators bind tighter than the prefix forms a base expression
+// may end with, so anything but a plain atom gets wrapped in parens.
+void transpile_postfix_base(Obj *o, CCode *code) {
+  if (o->tag == ATOM) {
+    transpile_expression(o, code);
+  } else {
+    ccode_append(code, "(");
+    transpile_expression(o, code);
+    ccode_append(code, ")");
+  }
+}
+
+void transpile_aref(Obj *o, CCode *code) {
+  if (o->len < 3) {
+    fail_at(o->beg, "aref needs an array and at least one index");
+  }
+
+  transpile_postfix_base(obj_at(o, 1), code);
+  for (size_t i = 2; i < o->len; i++) {
+    ccode_append(code, "[");
+    transpile_expression(obj_at(o, i), code);
+    ccode_append(code, "]");
+  }
+}
+
+void transpile_member(Obj *o, CCode *code) {
+  char *op = obj_text(obj_at(o, 0));
+  if (o->len < 3) {
+    fail_at(o->beg, "'%s' needs a struct and a field", op);
+  }
+
+  transpile_postfix_base(obj_at(o, 1), code);
+  for (size_t i = 2; i < o->len; i++) {
+    Obj *field = obj_at(o, i);
+    if (field->tag != ATOM) {
+      fail_at(field->beg, "field names must be plain atoms");
+    }
+    ccode_append(code, "%s%s", op, obj_text(field));
+  }
+}
+
+void transpile_while(Obj *o, CCode *code) {
+  if (o->len < 2) {
+    fail_at(o->beg, "while needs a condition");
+  }
+
+  ccode_mark_line(code, o);
+  ccode_printf_line(code, "while (");
+  transpile_condition(obj_at(o, 1), code);
+  ccode_append(code, ") {");
+  for (size_t i = 2; i < o->len; i++) {
+    transpile_statement(obj_at(o, i), code);
+  }
+  ccode_printf_line(code, "}");
+};
+
+void transpile_cast(Obj *o, CCode *code) {
+  if (o->len != 2) {
+    fail_at(o->beg, "a cast takes exactly one value, e.g. (:int x)");
+  }
+
+  char *type = type_to_c(obj_text(obj_at(o, 0)));
+  ccode_append(code, "((%s)", type);
+  free(type);
+  transpile_expression(obj_at(o, 1), code);
+  ccode_append(code, ")");
+};
+
+void transpile_op_assign(Obj *o, CCode *code) {
+  if (o->len != 3) {
+    fail_at(o->beg, "'%s' needs a place and a value, e.g. (%s x 1)",
+            obj_text(obj_at(o, 0)), obj_text(obj_at(o, 0)));
+  }
+
+  ccode_append(code, "(");
+  transpile_expression(obj_at(o, 1), code);
+  ccode_append(code, " %s ", obj_text(obj_at(o, 0)));
+  transpile_expression(obj_at(o, 2), code);
+  ccode_append(code, ")");
+};
+
+void transpile_deref(Obj *o, CCode *code) {
+  if (o->len != 2) {
+    fail_at(o->beg, "deref takes exactly one value");
+  }
+
+  ccode_append(code, "*(");
+  transpile_expression(obj_at(o, 1), code);
+  ccode_append(code, ")");
+}
+
+void transpile_return(Obj *o, CCode *code) {
+  if (o->len > 2) {
+    fail_at(o->beg, "return takes at most one value");
+  }
+
+  if (o->len == 1) {
+    ccode_mark_line(code, o);
+    ccode_printf_line(code, "return;");
+    return;
+  }
+
+  Obj *t = obj_at(o, 1);
+  ccode_mark_line(code, t);
+  ccode_printf_line(code, "return ");
+  transpile_expression(t, code);
+  ccode_append(code, ";");
+}
+
+void transpile_include(Obj *o, CCode *code) {
+  if (o->len < 2) {
+    fail_at(o->beg, "#include needs at least one header");
+  }
+
+  for (size_t i = 1; i < o->len; i++) {
+    Obj *t = obj_at(o, i);
+    if (t->tag != ATOM) {
+      fail_at(t->beg, "#include takes header names, not expressions");
+    }
+
+    ccode_mark_line(code, t);
+    ccode_printf_line(code, "#include %s", obj_text(t));
+  }
+}
+
+void transpile_define(Obj *o, CCode *code) {
+  if (o->len < 2 || o->len > 3) {
+    fail_at(o->beg, "#define needs a name or (name params...), and an "
+                    "optional value");
+  }
+
+  ccode_mark_line(code, o);
+  Obj *name = obj_at(o, 1);
+  if (name->tag == ATOM) {
+    ccode_printf_line(code, "#define %s", obj_text(name));
+  } else {
+    if (name->len < 2) {
+      fail_at(name->beg, "a function-like #define needs a name and at "
+                         "least one parameter");
+    }
+    for (size_t i = 0; i < name->len; i++) {
+      if (obj_at(name, i)->tag != ATOM) {
+        fail_at(obj_at(name, i)->beg,
+                "#define names and parameters must be plain atoms");
+      }
+    }
+
+    ccode_printf_line(code, "#define %s(", obj_text(obj_at(name, 0)));
+    for (size_t i = 1; i < name->len; i++) {
+      ccode_append(code, "%s%s", i == 1 ? "" : ", ", obj_text(obj_at(name, i)));
+    }
+    ccode_append(code, ")");
+  }
+
+  if (o->len == 3) {
+    ccode_append(code, " ");
+    transpile_expression(obj_at(o, 2), code);
+  }
+}
+
+void transpile_undef(Obj *o, CCode *code) {
+  if (o->len != 2 || obj_at(o, 1)->tag != ATOM) {
+    fail_at(o->beg, "#undef needs a name");
+  }
+
+  ccode_mark_line(code, o);
+  ccode_printf_line(code, "#undef %s", obj_text(obj_at(o, 1)));
+}
+
+void transpile_guard(Obj *o, CCode *code) {
+  char *head = obj_text(obj_at(o, 0));
+  if (o->len < 2) {
+    fail_at(o->beg, "%s needs a condition", head);
+  }
+
+  ccode_mark_line(code, o);
+  if (obj_at(o, 0)->sym == SYM_HASH_IF) {
+    ccode_printf_line(code, "#if ");
+    transpile_expression(obj_at(o, 1), code);
+  } else {
+    if (obj_at(o, 1)->tag != ATOM) {
+      fail_at(obj_at(o, 1)->beg, "%s takes a plain name", head);
+    }
+    ccode_printf_line(code, "%s %s", head, obj_text(obj_at(o, 1)));
+  }
+
+  for (size_t i = 2; i < o->len; i++) {
+    transpile_statement(obj_at(o, i), code);
+  }
+  ccode_printf_line(code, "#endif");
+}
+
+void transpile_hash_else(Obj *o, CCode *code) {
+  if (o->len != 1) {
+    fail_at(o->beg, "(#else) takes no arguments; place statements after it");
+  }
+
+  ccode_printf_line(code, "#else");
+}
+
+void transpile_pragma(Obj *o, CCode *code) {
+  ccode_mark_line(code, o);
+  ccode_printf_line(code, "#pragma");
+  for (size_t i = 1; i < o->len; i++) {
+    if (obj_at(o, i)->tag != ATOM) {
+      fail_at(obj_at(o, i)->beg, "#pragma takes plain atoms");
+    }
+    ccode_append(code, " %s", obj_text(obj_at(o, i)));
+  }
+}
+
+void transpile_call(Obj *o, CCode *code) {
+  transpile_postfix_base(obj_at(o, 0), code);
+  ccode_append(code, "(");
+
+  for (size_t j = 1; j < o->len; j++) {
+    if (j > 1) {
+      ccode_append(code, ", ");
+    }
+    transpile_expression(obj_at(o, j), code);
+  }
+
+  ccode_append(code, ")");
+}
+
+void transpile_fn(Obj *o, CCode *code) {
+  if (o->len < 4 || obj_at(o, 1)->tag != ATOM || obj_at(o, 2)->tag != ATOM ||
+      obj_text(obj_at(o, 2))[0] != ':') {
+    fail_at(o->beg,
+            "fn needs a name, a :type, an argument list, and an optional "
+            "body, e.g. (fn main :int (argc :int argv :char**) ...)");
+  }
+
+  Obj *name = obj_at(o, 1);
+  Obj *type = obj_at(o, 2);
+
+  ccode_mark_line(code, name);
+  char *ret = type_to_c(obj_text(type));
+  ccode_printf_line(code, "%s %s(", ret, obj_text(name));
+  free(ret);
+
+  Obj *args = obj_at(o, 3);
+  if (args->tag != SEXP) {
+    fail_at(obj_at(o, 3)->beg,
+            "fn arguments must be name :type pairs, e.g. (argc :int)");
+  }
+
+  size_t nargs = args->len;
+  Obj *last = nargs > 0 ? obj_at(args, nargs - 1) : NULL;
+  bool variadic =
+      last != NULL && last->tag == ATOM && last->sym == SYM_ELLIPSIS;
+  if (variadic) {
+    nargs--;
+  }
+  if ((nargs & 1) != 0) {
+    fail_at(args->beg,
+            "fn arguments must be name :type pairs, e.g. (argc :int)");
+  }
+
+  for (size_t j = 0; j < nargs; j += 2) {
+    Obj *arg_name = obj_at(args, j);
+    if (arg_name->tag != ATOM) {
+      fail_at(arg_name->beg,
+              "fn arguments must be name :type pairs, e.g. (argc :int)");
+    }
+
+    if (j > 0) {
+      ccode_append(code, ", ");
+    }
+    ccode_append_declarator_obj(code, obj_at(args, j + 1), obj_text(arg_name));
+  }
+
+  if (variadic) {
+    ccode_append(code, "%s...", nargs > 0 ? ", " : "");
+  }
+
+  if (o->len == 4) {
+    ccode_append(code, ");");
+    return;
+  }
+
+  ccode_append(code, ") {");
+
+  for (size_t j = 4; j < o->len; j++) {
+    transpile_statement(obj_at(o, j), code);
+  }
+
+  ccode_printf_line(code, "}");
+}
+
+void transpile_for(Obj *o, CCode *code) {
+  if (o->len < 4) {
+    fail_at(o->beg, "for needs an init statement, a condition, and a step");
+  }
+
+  ccode_mark_line(code, o);
+  ccode_printf_line(code, "for (");
+  transpile_statement(obj_at(o, 1), code);
+  ccode_append(code, " ");
+  transpile_expression(obj_at(o, 2), code);
+  ccode_append(code, "; ");
+  transpile_expression(obj_at(o, 3), code);
+  ccode_append(code, ") {");
+  for (size_t i = 4; i < o->len; i++) {
+    transpile_statement(obj_at(o, i), code);
+  }
+  ccode_printf_line(code, "}");
+}
+
+void transpile_if(Obj *o, CCode *code) {
+  if (o->len < 3 || o->len > 4) {
+    fail_at(o->beg, "if needs a condition, a branch, and at most an else "
+                    "branch; use (do ...) to group statements");
+  }
+
+  ccode_mark_line(code, o);
+  ccode_printf_line(code, "if (");
+  transpile_condition(obj_at(o, 1), code);
+  ccode_append(code, ") {");
+  transpile_statement(obj_at(o, 2), code);
+  if (o->len == 4) {
+    ccode_printf_line(code, "} else {");
+    transpile_statement(obj_at(o, 3), code);
+  }
+  ccode_printf_line(code, "}");
+}
+
+void transpile_do(Obj *o, CCode *code) {
+  ccode_mark_line(code, o);
+  ccode_printf_line(code, "{");
+  for (size_t i = 1; i < o->len; i++) {
+    transpile_statement(obj_at(o, i), code);
+  }
+  ccode_printf_line(code, "}");
+}
+
+void transpile_sizeof(Obj *o, CCode *code) {
+  if (o->len != 2) {
+    fail_at(o->beg, "sizeof takes exactly one operand");
+  }
+
+  Obj *t = obj_at(o, 1);
+  if (t->tag == ATOM && obj_text(t)[0] == ':') {
+    char *type = type_to_c(obj_text(t));
+    ccode_append(code, "sizeof(%s)", type);
+    free(type);
+  } else {
+    ccode_append(code, "sizeof(");
+    transpile_expression(t, code);
+    ccode_append(code, ")");
+  }
+}
+
+void transpile_typeop(Obj *o, CCode *code) {
+  bool is_offsetof = obj_at(o, 0)->sym == SYM_OFFSETOF;
+  size_t want = is_offsetof ? 3 : 2;
+
+  if (o->len != want || obj_at(o, 1)->tag != ATOM ||
+      obj_text(obj_at(o, 1))[0] != ':' ||
+      (is_offsetof && obj_at(o, 2)->tag != ATOM)) {
+    fail_at(o->beg,
+            is_offsetof ? "offsetof needs a :type and a field name"
+                        : "alignof needs a :type");
+  }
+
+  char *type = type_to_c(obj_text(obj_at(o, 1)));
+  if (is_offsetof) {
+    ccode_append(code, "offsetof(%s, %s)", type, obj_text(obj_at(o, 2)));
+  } else {
+    ccode_append(code, "_Alignof(%s)", type);
+  }
+  free(type);
+}
+
+void transpile_ternary(Obj *o, CCode *code) {
+  if (o->len != 4) {
+    fail_at(o->beg, "?: needs a condition and two values");
+  }
+
+  ccode_append(code, "(");
+  transpile_expression(obj_at(o, 1), code);
+  ccode_append(code, " ? ");
+  transpile_expression(obj_at(o, 2), code);
+  ccode_append(code, " : ");
+  transpile_expression(obj_at(o, 3), code);
+  ccode_append(code, ")");
+}
+
+void transpile_init(Obj *o, CCode *code) {
+  ccode_append(code, "{");
+  for (size_t i = 1; i < o->len; i++) {
+    if (i > 1) {
+      ccode_append(code, ", ");
+    }
+
+    Obj *e = obj_at(o, i);
+    bool designated = e->tag == SEXP && e->len == 2 &&
+                      obj_at(e, 0)->tag == ATOM &&
+                      obj_text(obj_at(e, 0))[0] == '.';
+    if (designated) {
+      ccode_append(code, "%s = ", obj_text(obj_at(e, 0)));
+      transpile_expression(obj_at(e, 1), code);
+    } else {
+      transpile_expression(e, code);
+    }
+  }
+  ccode_append(code, "}");
+}
+
+void transpile_switch(Obj *o, CCode *code) {
+  if (o->len < 2) {
+    fail_at(o->beg, "switch needs a value");
+  }
+
+  ccode_mark_line(code, o);
+  ccode_printf_line(code, "switch (");
+  transpile_expression(obj_at(o, 1), code);
+  ccode_append(code, ") {");
+
+  for (size_t j = 2; j < o->len; j++) {
+    Obj *entry = obj_at(o, j);
+    if (entry->tag != SEXP || entry->len == 0 ||
+        obj_at(entry, 0)->tag != ATOM) {
+      fail_at(entry->beg,
+              "switch entries are (case value ...) or (default ...)");
+    }
+
+    uint32_t head = obj_at(entry, 0)->sym;
+    size_t body;
+    ccode_mark_line(code, entry);
+    if (head == SYM_CASE) {
+      if (entry->len < 2) {
+        fail_at(entry->beg, "case needs a value");
+      }
+      ccode_printf_line(code, "case ");
+      transpile_expression(obj_at(entry, 1), code);
+      ccode_append(code, ": {");
+      body = 2;
+    } else if (head == SYM_DEFAULT) {
+      ccode_printf_line(code, "default: {");
+      body = 1;
+    } else {
+      fail_at(entry->beg,
+              "switch entries are (case value ...) or (default ...)");
+    }
+
+    for (size_t i = body; i < entry->len; i++) {
+      transpile_statement(obj_at(entry, i), code);
+    }
+    ccode_printf_line(code, "}");
+  }
+
+  ccode_printf_line(code, "}");
+}
+
+void transpile_do_while(Obj *o, CCode *code) {
+  if (o->len < 2) {
+    fail_at(o->beg, "do-while needs a condition");
+  }
+
+  ccode_mark_line(code, o);
+  ccode_printf_line(code, "do {");
+  for (size_t i = 2; i < o->len; i++) {
+    transpile_statement(obj_at(o, i), code);
+  }
+  ccode_printf_line(code, "} while (");
+  transpile_condition(obj_at(o, 1), code);
+  ccode_append(code, ");");
+}
+
+void transpile_goto(Obj *o, CCode *code) {
+  char *head = obj_text(obj_at(o, 0));
+  if (o->len != 2 || obj_at(o, 1)->tag != ATOM) {
+    fail_at(o->beg, "%s needs a label name", head);
+  }
+
+  ccode_mark_line(code, o);
+  if (obj_at(o, 0)->sym == SYM_GOTO) {
+    ccode_printf_line(code, "goto %s;", obj_text(obj_at(o, 1)));
+  } else {
+    ccode_printf_line(code, "%s:;", obj_text(obj_at(o, 1)));
+  }
+}
+
+// CUDA kernel launch: (launch kernel (grid block [shared stream]) args...)
+// becomes kernel<<<grid, block>>>(args). The config sexp mirrors the
+// <<<>>> grouping; qualifiers like __global__ need no forms at all since
+// they ride on hyphen-types.
+void transpile_launch(Obj *o, CCode *code) {
+  if (o->len < 3 || obj_at(o, 2)->tag != SEXP ||
+      obj_at(o, 2)->len < 2 || obj_at(o, 2)->len > 4) {
+    fail_at(o->beg,
+            "launch needs a kernel and a (grid block) config with optional "
+            "shared-bytes and stream, e.g. (launch add (blocks threads) out)");
+  }
+
+  transpile_postfix_base(obj_at(o, 1), code);
+  ccode_append(code, "<<<");
+  Obj *cfg = obj_at(o, 2);
+  for (size_t i = 0; i < cfg->len; i++) {
+    if (i > 0) {
+      ccode_append(code, ", ");
+    }
+    transpile_expression(obj_at(cfg, i), code);
+  }
+  ccode_append(code, ">>>(");
+  for (size_t i = 3; i < o->len; i++) {
+    if (i > 3) {
+      ccode_append(code, ", ");
+    }
+    transpile_expression(obj_at(o, i), code);
+  }
+  ccode_append(code, ")");
+}
+
+void transpile_struct(Obj *o, CCode *code) {
+  char *kind = obj_text(obj_at(o, 0));
+  if (o->len < 2 || obj_at(o, 1)->tag != ATOM || ((o->len - 2) & 1) != 0) {
+    fail_at(o->beg, "%s needs a name and field name :type pairs, e.g. "
+                    "(%s Point x :int y :int)",
+            kind, kind);
+  }
+
+  ccode_mark_line(code, o);
+  ccode_printf_line(code, "%s %s {", kind, obj_text(obj_at(o, 1)));
+  for (size_t j = 2; j < o->len; j += 2) {
+    Obj *field = obj_at(o, j);
+    if (field->tag != ATOM) {
+      fail_at(field->beg, "%s fields must be name :type pairs", kind);
+    }
+
+    ccode_printf_line(code, "");
+    ccode_append_declarator_obj(code, obj_at(o, j + 1), obj_text(field));
+    ccode_append(code, ";");
+  }
+  ccode_printf_line(code, "};");
+}
+
+void transpile_enum(Obj *o, CCode *code) {
+  if (o->len < 2 || obj_at(o, 1)->tag != ATOM) {
+    fail_at(o->beg, "enum needs a name");
+  }
+
+  ccode_mark_line(code, o);
+  ccode_printf_line(code, "enum %s {", obj_text(obj_at(o, 1)));
+  for (size_t j = 2; j < o->len; j++) {
+    Obj *entry = obj_at(o, j);
+    if (entry->tag == ATOM) {
+      ccode_printf_line(code, "%s,", obj_text(entry));
+    } else if (entry->len == 2 && obj_at(entry, 0)->tag == ATOM &&
+               obj_at(entry, 1)->tag == ATOM) {
+      ccode_printf_line(code, "%s = %s,", obj_text(obj_at(entry, 0)),
+                        obj_text(obj_at(entry, 1)));
+    } else {
+      fail_at(entry->beg, "enum entries are names or (name value) pairs");
+    }
+  }
+  ccode_printf_line(code, "};");
+}
+
+void transpile_typedef(Obj *o, CCode *code) {
+  if (o->len != 3 || obj_at(o, 1)->tag != ATOM) {
+    fail_at(o->beg, "typedef needs a name and a :type, e.g. "
+                    "(typedef Point :struct-Point)");
+  }
+
+  ccode_mark_line(code, o);
+  ccode_printf_line(code, "typedef ");
+  ccode_append_declarator_obj(code, obj_at(o, 2), obj_text(obj_at(o, 1)));
+  ccode_append(code, ";");
+}
+
+static void transpile_one(Obj *o, CCode *code, RuleContext ctx) {
+#ifdef DEBUG
+  obj_print(o);
+#endif
+
+  if (o->tag == SEXP) {
+    if (o->len == 0) {
+      fail_at(o->beg, "empty expression '()'");
+    }
+    if (obj_at(o, 0)->tag != ATOM) {
+      bool as_statement = ctx == STATEMENT;
+      if (as_statement) {
+        ccode_mark_line(code, o);
+        ccode_printf_line(code, "");
+      }
+      transpile_call(o, code);
+      if (as_statement) {
+        ccode_append(code, ";");
+      }
+      return;
+    }
+
+    char *head = obj_text(obj_at(o, 0));
+    const TRule *rule = rule_for(obj_at(o, 0));
+    if (rule == NULL) {
+      fail_at(o->beg, "no rule matches '%s' here", head);
+    }
+
+    if (ctx == EXPRESSION && (rule->ctx & EXPRESSION) == 0) {
+      fail_at(o->beg, "'%s' is a statement and has no value here", head);
+    }
+
+    bool as_statement = ctx == STATEMENT && (rule->ctx & STATEMENT) == 0;
+    if (as_statement) {
+      ccode_mark_line(code, o);
+      ccode_printf_line(code, "");
+    }
+
+    rule->fn(o, code);
+
+    if (as_statement) {
+      ccode_append(code, ";");
+    }
+  } else {
+    if (ctx == STATEMENT) {
+      ccode_mark_line(code, o);
+      ccode_printf_line(code, "%s;", obj_text(o));
+    } else {
+      ccode_append(code, "%s", obj_text(o));
+    }
+  }
+}
+
+static void ccode_emit_text(CCode *code, EmitKind kind, const char *text) {
+  if (kind == EMIT_LINE || code->count == 0) {
+    ccode_new_line(code);
+  }
+  size_t beg = code->out.len;
+  buf_write(&code->out, text, strlen(text));
+  ccode_map(code, beg);
+}
+
+// The running rule is done: its ops go on the work stack in order.
+static void emit_rule_done(CCode *code) {
+  code->in_rule = false;
+  code->deferring = false;
+  while (code->deferred.len > 0) {
+    emit_push(&code->work, code->deferred.ops[--code->deferred.len]);
+  }
+}
+
+// Emission runs off an explicit stack so nesting depth never reaches the C
+// stack. A rule asking for a child's code gets an EMIT_OBJ op recorded in
+// its place; once it has deferred one, its own later output is recorded
+// too. When the rule returns, its ops go on the work stack in order.
+//
+// A rule that fails after deferring a child would report its own error
+// before one in that child, which comes first in the source. So the
+// failure is caught and recorded as an EMIT_FAIL op after what the rule
+// deferred, and raised again only if the children get through.
+void transpile_obj(Obj *o, CCode *code, RuleContext ctx) {
+  Obj *call = o->expanded ? o : code->in_rule ? code->call : NULL;
+  if (code->in_rule) {
+    code->deferring = true;
+    emit_push(&code->deferred,
+              (EmitOp){.kind = EMIT_OBJ, .ctx = ctx, .o = o, .call = call});
+    return;
+  }
+
+  emit_push(&code->work,
+            (EmitOp){.kind = EMIT_OBJ, .ctx = ctx, .o = o, .call = call});
+  Failure *outer = failure;
+  Failure caught = {0};
+  failure = &caught;
+  if (setjmp(caught.jump) != 0) {
+    failure = outer;
+    if (!code->in_rule || !code->deferring || caught.file.len > 0) {
+      fail_again(&caught);
+    }
+    size_t text = code->texts.len;
+    const char *message = failure_message(&caught);
+    buf_write(&code->texts, message, strlen(message) + 1);
+    emit_push(&code->deferred, (EmitOp){.kind = EMIT_FAIL,
+                                        .ctx = caught.positioned,
+                                        .text = text,
+                                        .pos = caught.pos});
+    emit_rule_done(code);
+    failure = &caught;
+  }
+
+  while (code->work.len > 0) {
+    EmitOp op = code->work.ops[--code->work.len];
+    if (op.kind == EMIT_FAIL) {
+      if (op.ctx) {
+        fail_at(op.pos, "%s", code->texts.data + op.text);
+      }
+      fail("%s", code->texts.data + op.text);
+    }
+    code->call = op.call;
+    if (op.kind != EMIT_OBJ) {
+      code->owner = op.owner;
+      ccode_emit_text(code, op.kind, code->texts.data + op.text);
+      continue;
+    }
+
+    code->owner = op.o;
+    code->in_rule = true;
+    transpile_one(op.o, code, (RuleContext)op.ctx);
+    emit_rule_done(code);
+  }
+  failure = outer;
+  free(caught.message.data);
+  free(caught.file.data);
+  code->texts.len = 0;
+  code->owner = NULL;
+  code->call = NULL;
+}
+
+void transpile(Obj *top, CCode *code) {
+  for (size_t i = 0; i < top->len; i++) {
+    transpile_statement(obj_at(top, i), code);
+  }
+}
+
+void transpile_expression(Obj *o, CCode *code) {
+  transpile_obj(o, code, EXPRESSION);
+}
+
+void transpile_statement(Obj *o, CCode *code) {
+  transpile_obj(o, code, STATEMENT);
+}
+
+// === Drivers ===
+
+// Each top-level form is parsed, expanded, emitted and written before
+// the next is read, then its memory -- tree, output, and the input pages
+// it came from -- is released. Macro definitions are kept: the arena
+// mark moves past them instead. Output already written stays if a later
+// form fails. The failure reported is the first in source order, which
+// needn't be the one the whole file reports (see -j's below): a form
+// that fails to emit does so before a later defmacro is even read.
+static void transpile_stream(SrcFile *src, FILE *fp) {
+  Arena *arena = &ctx->arena;
+  Parser *parser = ctx->parser = parser_init(src, arena);
+  parser_check(parser);
+  Expander *ex = ctx->expander = CHECK_ALLOC(calloc(1, sizeof(Expander)));
+  ex->arena = arena;
+  CCode *code = ctx->code = ccode_init();
+  ArenaMark mark = arena_mark(arena);
+  size_t released = 0;
+
+  while (parser_next(parser)) {
+    Obj o = parser->stack[--parser->stack_len];
+    if (form_is_defmacro(&o)) {
+      macro_register(&o);
+      mark = arena_mark(arena);
+      released = src->off; // the definition may point into the input
+      continue;
+    }
+    if (form_is_import(&o)) {
+      module_import(&o);
+    }
+    expand_form(ex, &o, ctx->macros_len,
+                form_key(&ex->keys, &o, ctx->macros_len));
+    transpile_statement(&o, code);
+    ccode_flush(code, fp);
+    arena_release(arena, mark);
+    released = srcfile_release(src, released, src->off);
+  }
+}
+
+// -j: defmacros are registered first, in order, and every other form
+// remembers how many were defined before it. Workers then claim runs of
+// consecutive forms, expanding each into the worker's own arena and
+// emitting the run into its own CCode; the runs are joined in source
+// order. Only the parse and the registration are serial.
+//
+// One thread expands every form before emitting any, and emits every
+// form before declaring any in the header, so the failure reported is
+// the earliest form's in the earliest phase it reached: a defmacro's or
+// expansion's before any emission's. Runs are claimed in order, so once
+// a form fails to expand, every run before it has been claimed and will
+// finish; no new ones are. A failure to emit stops nothing: later forms
+// are still expanded in case one fails, but no longer emitted, and
+// earlier ones are still emitted; declaring is cut short likewise.
+#define PARALLEL_RUN 64
+
+typedef enum ParallelPhase {
+  PARALLEL_EXPAND, // defmacros and imports included
+  PARALLEL_EMIT,
+  PARALLEL_DECLARE,
+  PARALLEL_DONE,
+} ParallelPhase;
+
+typedef struct ParallelForm {
+  Obj *o;
+  size_t form;
+  size_t visible;
+  FormKey key;
+} ParallelForm;
+
+typedef struct Parallel {
+  ParallelForm *forms;
+  size_t len;
+  Context *context;
+  CCode **runs;    // by run, each filled in by the worker that claimed it
+  CCode **headers; // and its part of the header, with SicOptions.header
+  size_t next_run; // the next to claim, taken with an atomic add
+  size_t peak;     // the workers' arena peaks, summed
+  pthread_mutex_t lock;
+  bool stop;          // set once a form has failed to expand
+  size_t emit_before; // forms from here on needn't be emitted
+  size_t declare_before; // nor declared
+  ParallelPhase failed_phase; // the earliest failure's, or PARALLEL_DONE
+  size_t failed_form; // and its form, or SIZE_MAX
+  Failure failed;     // its failure
+  size_t defining;    // the defmacro being registered
+  FormKeys keys;
+} Parallel;
+
+typedef struct ParallelWorker {
+  Parallel *p;
+  pthread_t thread;
+  Arena arena;
+  Expander ex;
+  CCode *code;   // the run being emitted
+  CCode *header; // and its declarations
+  size_t run;    // the run claimed
+  size_t next;   // the next of its forms to do, an index in `forms`
+  size_t end;
+  ParallelPhase phase; // what the form being done is at
+  Failure failure;
+} ParallelWorker;
+
+static void parallel_record(Parallel *p, ParallelPhase phase, size_t form,
+                            Failure *f) {
+  if (phase < p->failed_phase ||
+      (phase == p->failed_phase && form < p->failed_form)) {
+    p->failed_phase = phase;
+    p->failed_form = form;
+    failure_copy(&p->failed, f);
+  }
+}
+
+static void parallel_failed(Parallel *p, ParallelPhase phase, size_t form,
+                            Failure *f) {
+  pthread_mutex_lock(&p->lock);
+  size_t emit = phase == PARALLEL_EXPAND ? 0
+                : phase == PARALLEL_EMIT   ? form
+                                           : SIZE_MAX;
+  size_t declare = phase == PARALLEL_DECLARE ? form : 0;
+  if (phase == PARALLEL_EXPAND) {
+    __atomic_store_n(&p->stop, true, __ATOMIC_RELAXED);
+  }
+  if (emit < p->emit_before) {
+    __atomic_store_n(&p->emit_before, emit, __ATOMIC_RELAXED);
+  }
+  if (declare < p->declare_before) {
+    __atomic_store_n(&p->declare_before, declare, __ATOMIC_RELAXED);
+  }
+  parallel_record(p, phase, form, f);
+  pthread_mutex_unlock(&p->lock);
+}
+
+// The expanded tree is only needed until its form is emitted, so the
+// arena is released after each one. The run being done is kept in `w`,
+// so a form that fails to emit can jump back here and the run go on.
+static void *parallel_worker(void *arg) {
+  ParallelWorker *w = arg;
+  Parallel *p = w->p;
+  ctx = p->context;
+  failure = &w->failure;
+  w->ex.arena = &w->arena;
+  size_t runs = (p->len + PARALLEL_RUN - 1) / PARALLEL_RUN;
+  ArenaMark mark = arena_mark(&w->arena);
+  if (setjmp(w->failure.jump) != 0) {
+    parallel_failed(p, w->phase, p->forms[w->next].form, &w->failure);
+    if (w->phase == PARALLEL_EXPAND) {
+      if (w->code != NULL) {
+        ccode_free(w->code);
+      }
+      if (w->header != NULL) {
+        ccode_free(w->header);
+      }
+      return NULL;
+    }
+    arena_release(&w->arena, mark);
+    w->next++;
+  }
+
+  for (;;) {
+    if (w->next == w->end) {
+      if (w->code != NULL) {
+        p->runs[w->run] = w->code;
+        p->headers[w->run] = w->header;
+        w->code = NULL;
+        w->header = NULL;
+      }
+      if (__atomic_load_n(&p->stop, __ATOMIC_RELAXED)) {
+        break;
+      }
+      w->run = __atomic_fetch_add(&p->next_run, 1, __ATOMIC_RELAXED);
+      if (w->run >= runs) {
+        break;
+      }
+      w->next = w->run * PARALLEL_RUN;
+      w->end = w->next + PARALLEL_RUN < p->len ? w->next + PARALLEL_RUN
+                                                : p->len;
+      w->phase = PARALLEL_EXPAND; // running out of memory stops them all
+      w->code = ccode_output();
+      w->header = ctx->header != NULL ? header_init() : NULL;
+    }
+    ParallelForm *f = &p->forms[w->next];
+    w->phase = PARALLEL_EXPAND;
+    expand_form(&w->ex, f->o, f->visible, f->key);
+    if (f->form < __atomic_load_n(&p->emit_before, __ATOMIC_RELAXED)) {
+      w->phase = PARALLEL_EMIT;
+      transpile_statement(f->o, w->code);
+      if (w->header != NULL &&
+          f->form < __atomic_load_n(&p->declare_before, __ATOMIC_RELAXED)) {
+        w->phase = PARALLEL_DECLARE;
+        header_declare(f->o, w->header);
+      }
+    }
+    arena_release(&w->arena, mark);
+    w->next++;
+  }
+  return NULL;
+}
+
+static CCode *transpile_parallel(Obj *top, size_t threads, size_t *peak) {
+  Parallel *p = CHECK_ALLOC(calloc(1, sizeof(Parallel)));
+  p->forms = CHECK_ALLOC(calloc(top->len + 1, sizeof(ParallelForm)));
+  p->context = ctx;
+  p->failed_phase = PARALLEL_DONE;
+  p->failed_form = SIZE_MAX;
+  p->emit_before = SIZE_MAX;
+  p->declare_before = SIZE_MAX;
+  pthread_mutex_init(&p->lock, NULL);
+
+  // A defmacro that fails only stops the forms after it. Keys are taken
+  // here, in source order.
+  Failure *outer = failure;
+  Failure registering = {0};
+  failure = &registering;
+  if (setjmp(registering.jump) == 0) {
+    for (size_t i = 0; i < top->len; i++) {
+      Obj *o = obj_at(top, i);
+      if (form_is_defmacro(o)) {
+        p->defining = i;
+        macro_register(o);
+        continue;
+      }
+      if (form_is_import(o)) {
+        p->defining = i;
+        module_import(o);
+      }
+      FormKey key = form_key(&p->keys, o, ctx->macros_len);
+      p->forms[p->len++] = (ParallelForm){
+          .o = o, .form = i, .visible = ctx->macros_len, .key = key};
+    }
+  } else {
+    parallel_record(p, PARALLEL_EXPAND, p->defining, &registering);
+  }
+  // Workers can't intern symbols, so imported macros are built now. A
+  // corrupt image fails the file before any form is claimed.
+  if (setjmp(registering.jump) == 0) {
+    module_load_all();
+  } else {
+    p->stop = true;
+    parallel_record(p, PARALLEL_EXPAND, 0, &registering);
+  }
+  failure = outer;
+  form_keys_free(&p->keys);
+  free(registering.message.data);
+  free(registering.file.data);
+
+  size_t runs = (p->len + PARALLEL_RUN - 1) / PARALLEL_RUN;
+  p->runs = CHECK_ALLOC(calloc(runs + 1, sizeof(CCode *)));
+  p->headers = CHECK_ALLOC(calloc(runs + 1, sizeof(CCode *)));
+  // `threads` itself isn't changed after the setjmps above.
+  size_t wanted = threads < runs ? threads : runs;
+  ParallelWorker *workers =
+      CHECK_ALLOC(calloc(wanted + 1, sizeof(ParallelWorker)));
+  // Fewer threads than asked for only makes it slower; with none to
+  // spare, this one does the work.
+  size_t started = 0;
+  while (started < wanted) {
+    workers[started].p = p;
+    if (pthread_create(&workers[started].thread, NULL, parallel_worker,
+                       &workers[started]) != 0) {
+      break;
+    }
+    started++;
+  }
+  bool here = started == 0 && wanted > 0;
+  if (here) {
+    parallel_worker(&workers[0]);
+    failure = outer;
+  }
+  size_t ran = here ? 1 : started;
+  for (size_t i = 0; i < ran; i++) {
+    if (!here) {
+      pthread_join(workers[i].thread, NULL);
+    }
+    p->peak += workers[i].arena.peak;
+    expander_free(&workers[i].ex);
+    arena_free(&workers[i].arena);
+    free(workers[i].failure.message.data);
+  }
+  free(workers);
+
+  CCode *code = p->failed_form == SIZE_MAX ? ccode_output() : NULL;
+  for (size_t run = 0; run < runs; run++) {
+    if (code != NULL) {
+      ccode_join(code, p->runs[run]);
+    }
+    if (p->runs[run] != NULL) {
+      ccode_free(p->runs[run]);
+    }
+    if (p->headers[run] != NULL) {
+      if (code != NULL) {
+        ccode_join(ctx->header, p->headers[run]);
+      }
+      ccode_free(p->headers[run]);
+    }
+  }
+  *peak = p->peak;
+  free(p->runs);
+  free(p->headers);
+  free(p->forms);
+  pthread_mutex_destroy(&p->lock);
+  if (code == NULL) {
+    // Copied out first: nothing of `p` may be left behind by the jump.
+    bool positioned = p->failed.positioned;
+    Pos pos = p->failed.pos;
+    char message[strlen(failure_message(&p->failed)) + 1];
+    memcpy(message, failure_message(&p->failed), sizeof(message));
+    free(p->failed.message.data);
+    char file[p->failed.file.len + 1];
+    memcpy(file, p->failed.file.data == NULL ? "" : p->failed.file.data,
+           sizeof(file));
+    free(p->failed.file.data);
+    free(p);
+    if (file[0] != '\0') {
+      fail_in(&(SicError){.file = file,
+                          .line = positioned ? pos.row + 1 : 0,
+                          .column = pos.col + 1,
+                          .message = message});
+    }
+    if (positioned) {
+      fail_at(pos, "%s", message);
+    }
+    fail("%s", message);
+  }
+  free(p->failed.message.data);
+  free(p->failed.file.data);
+  free(p);
+  return code;
+}
+
+// The whole file is parsed, then expanded and emitted, and the C handed
+// over as one string.
+static void transpile_whole(SrcFile *src, const SicOptions *options,
+                            SicOutput *out) {
+  ctx->parser = parser_init(src, &ctx->arena);
+  parser_parse(ctx->parser);
+  Obj *top = ctx->parser->root;
+  size_t threads = options == NULL ? 1 : options->threads;
+  if (threads > 1) {
+    ctx->code = transpile_parallel(top, threads, &out->worker_peak);
+  } else {
+    expand_toplevel(top, &ctx->arena);
+    ctx->code = ccode_output();
+    transpile(top, ctx->code);
+    for (size_t i = 0; ctx->header != NULL && i < top->len; i++) {
+      header_declare(obj_at(top, i), ctx->header);
+    }
+  }
+  out->c = ccode_take(ctx->code, &out->len);
+  if (ctx->mapping) {
+    span_finish(&ctx->code->map, out);
+  }
+  if (ctx->header != NULL) {
+    size_t len;
+    char *decls = ccode_take(ctx->header, &len);
+    header_finish(decls, len, out);
+    free(decls);
+  }
+}
+
+// ==== Incremental ====
+// With SicOptions.incremental the context keeps, per source name, the
+// last good call's text, where its top-level forms were, and the C each
+// became. The next call compares texts: forms ending before the first
+// changed byte keep their place, and past the change the split is
+// resynced with the old one, its forms moved by however many bytes and
+// rows the edit added. Only the edited stretch is split anew, and forms
+// there are looked up by a hash of their text, so a form moved from
+// elsewhere is found too. A form found keeps its C -- #line rows moved
+// along -- unless a head it looked up now names a different macro (or a
+// macro where there was none, or none where there was one). The rest,
+// and every defmacro, are parsed, expanded and emitted, so the work
+// follows the edit rather than the file; what grows with the file is
+// copying the text and C.
+//
+// Each form is expanded and emitted before the next is looked at, but
+// the failure reported is the one a whole-file call would report: the
+// earliest form's in the earliest phase, ranked as -j ranks them. A form
+// that fails to emit or declare is only recorded, and the forms after it
+// are still expanded in case one fails; they are no longer emitted. A
+// failed call leaves the last good text in place, adding the C of any
+// forms it did finish.
+#define FORM_CACHES 16
+
+typedef struct CachedForm CachedForm;
+
+// A top-level form: bytes [beg, end) of the text.
+typedef struct FormSpan {
+  size_t beg;
+  size_t end;
+  Pos pos;            // of its first byte
+  Pos end_pos;        // of the byte after it
+  uint64_t hash;      // of its text; 0 until needed
+  CachedForm *cached; // its C, unless it is a defmacro or new
+  Obj *o;             // once parsed, during a call
+} FormSpan;
+
+typedef struct HeadDep {
+  uint64_t name; // hash of the head's text
+  uint64_t def;  // of the defmacro it named, or 0 for none
+} HeadDep;
+
+struct CachedForm {
+  char *text; // the form's source
+  size_t len;
+  uint64_t hash;
+  uint32_t row;    // where the form started when `c` was made
+  uint32_t col;
+  uint64_t macros; // digest of the macros visible to it
+  HeadDep *deps;
+  size_t deps_len;
+  char *c;
+  size_t c_len;
+  size_t *rows; // offsets in `c` of each #line row number
+  size_t rows_len;
+  char *h; // its part of the header, which rows don't change
+  size_t h_len;
+  bool declared;   // whether `h` was made, as without a header it may not be
+  uint32_t lines;  // of `c`
+  SpanList map;    // with a source map, C lines counted from the first
+  bool mapped;     // whether `map` was made
+  FormKey key;     // its gensyms were named by
+  bool gensyms;    // whether it made any
+  bool claimed; // by a form of the call in progress
+  bool kept;    // in that call's `next`
+};
+
+struct FormCache {
+  char *name;
+  char *text; // as of the last good call
+  size_t text_len;
+  FormSpan *spans; // its forms
+  size_t len;
+  CachedForm **forms; // every form's C kept, for lookup by hash
+  size_t forms_len;
+  uint32_t *slots; // hash -> index in forms + 1; a power of two of them
+  size_t slots_len;
+  uint64_t last_call;
+};
+
+struct Incremental {
+  FormCache *cache;
+  char *text; // the input, before the parser writes into it
+  size_t text_len;
+  FormSpan *spans;
+  size_t len;
+  size_t buffer;
+  CachedForm **next; // the forms whose C the cache keeps after this call
+  size_t next_len;
+  size_t next_buffer;
+  DefTable defs;   // the macros registered so far
+  uint64_t macros; // their digest
+  SymMap heads;
+  Buf out;
+  CCode *decls; // each form's part of the header, as it is redone
+  Buf h;        // the header so far, with SicOptions.header
+  uint32_t lines; // in `out`
+  SpanList map;   // with a source map, `out`'s
+  ParallelPhase failed_phase; // of the failure waiting, or PARALLEL_DONE
+  Failure failed;
+};
+
+static uint64_t text_hash(const char *text, size_t len) {
+  uint64_t h = 14695981039346656037u;
+  for (size_t i = 0; i < len; i++) {
+    h = (h ^ (unsigned char)text[i]) * 1099511628211u;
+  }
+  return h == 0 ? 1 : h;
+}
+
+static void cached_form_free(CachedForm *f) {
+  free(f->text);
+  free(f->deps);
+  free(f->c);
+  free(f->rows);
+  free(f->h);
+  free(f->map.spans);
+  free(f);
+}
+
+// How many slots index `forms_len` forms.
+static size_t form_cache_slots(size_t forms_len) {
+  size_t n = 16;
+  while (n < forms_len * 2) {
+    n *= 2;
+  }
+  return n;
+}
+
+// Fills `slots`, zeroed and as many as form_cache_slots says, in for the
+// cache's forms.
+static void form_cache_index(FormCache *cache, uint32_t *slots) {
+  size_t n = form_cache_slots(cache->forms_len);
+  free(cache->slots);
+  cache->slots = slots;
+  cache->slots_len = n;
+  for (size_t k = 0; k < cache->forms_len; k++) {
+    size_t i = cache->forms[k]->hash & (n - 1);
+    while (cache->slots[i] != 0) {
+      i = (i + 1) & (n - 1);
+    }
+    cache->slots[i] = (uint32_t)k + 1;
+  }
+}
+
+static CachedForm *form_cache_find(FormCache *cache, const char *text,
+                                   size_t len, uint64_t hash) {
+  if (cache->slots_len == 0) {
+    return NULL;
+  }
+  size_t mask = cache->slots_len - 1;
+  for (size_t i = hash & mask; cache->slots[i] != 0; i = (i + 1) & mask) {
+    CachedForm *f = cache->forms[cache->slots[i] - 1];
+    if (f->hash == hash && f->len == len && !f->claimed &&
+        memcmp(f->text, text, len) == 0) {
+      return f;
+    }
+  }
+  return NULL;
+}
+
+static void form_cache_clear(FormCache *cache) {
+  for (size_t i = 0; i < cache->forms_len; i++) {
+    cached_form_free(cache->forms[i]);
+  }
+  free(cache->name);
+  free(cache->text);
+  free(cache->spans);
+  free(cache->forms);
+  free(cache->slots);
+  *cache = (FormCache){0};
+}
+
+// The cache for `name`, made if need be by replacing the stalest one.
+static FormCache *form_cache_for(Context *c, const char *name) {
+  FormCache *cache = NULL;
+  for (size_t i = 0; i < c->caches_len && cache == NULL; i++) {
+    if (strcmp(c->caches[i].name, name) == 0) {
+      cache = &c->caches[i];
+    }
+  }
+  if (cache == NULL) {
+    if (c->caches == NULL) {
+      c->caches = CHECK_ALLOC(calloc(FORM_CACHES, sizeof(FormCache)));
+    }
+    char *copy = CHECK_ALLOC(strdup(name));
+    if (c->caches_len < FORM_CACHES) {
+      cache = &c->caches[c->caches_len++];
+    } else {
+      cache = &c->caches[0];
+      for (size_t i = 1; i < c->caches_len; i++) {
+        if (c->caches[i].last_call < cache->last_call) {
+          cache = &c->caches[i];
+        }
+      }
+      form_cache_clear(cache);
+    }
+    cache->name = copy;
+  }
+  cache->last_call = ++c->calls;
+  return cache;
+}
+
+static void incremental_free(Incremental *inc) {
+  free(inc->text);
+  free(inc->spans);
+  free(inc->next);
+  free(inc->defs.keys);
+  free(inc->defs.values);
+  symmap_free(&inc->heads);
+  free(inc->out.data);
+  if (inc->decls != NULL) {
+    ccode_free(inc->decls);
+  }
+  free(inc->h.data);
+  free(inc->map.spans);
+  free(inc->failed.message.data);
+  free(inc->failed.file.data);
+  free(inc);
+}
+
+static void incremental_keep(Incremental *inc, CachedForm *f) {
+  if (inc->next_len >= inc->next_buffer) {
+    size_t next_buffer = inc->next_buffer * 2 + 16;
+    inc->next =
+        CHECK_ALLOC(realloc(inc->next, next_buffer * sizeof(CachedForm *)));
+    inc->next_buffer = next_buffer;
+  }
+  inc->next[inc->next_len++] = f;
+  f->kept = true;
+}
+
+// A good call's text and forms replace the cache's, and C no form used
+// is dropped. After a failure the old text and forms stay, so all the C
+// they point at does too. What that takes is allocated first, so running
+// out of memory here leaves the cache as it was.
+static void incremental_finish(Context *c, bool ok) {
+  Incremental *inc = c->incremental;
+  FormCache *cache = inc->cache;
+  size_t forms_len = inc->next_len;
+  for (size_t i = 0; i < cache->forms_len && !ok; i++) {
+    forms_len += !cache->forms[i]->kept;
+  }
+  if (forms_len > inc->next_buffer) {
+    inc->next = CHECK_ALLOC(
+        realloc(inc->next, forms_len * sizeof(CachedForm *)));
+    inc->next_buffer = forms_len;
+  }
+  uint32_t *slots =
+      CHECK_ALLOC(calloc(form_cache_slots(forms_len), sizeof(uint32_t)));
+
+  for (size_t i = 0; i < cache->forms_len; i++) {
+    CachedForm *f = cache->forms[i];
+    if (f->kept) {
+      continue;
+    }
+    if (ok) {
+      cached_form_free(f);
+    } else {
+      incremental_keep(inc, f);
+    }
+  }
+  for (size_t i = 0; i < inc->next_len; i++) {
+    inc->next[i]->claimed = false;
+    inc->next[i]->kept = false;
+  }
+  free(cache->forms);
+  cache->forms = inc->next;
+  cache->forms_len = inc->next_len;
+  inc->next = NULL;
+  form_cache_index(cache, slots);
+
+  if (ok) {
+    free(cache->text);
+    free(cache->spans);
+    cache->text = inc->text;
+    cache->text_len = inc->text_len;
+    cache->spans = inc->spans;
+    cache->len = inc->len;
+    for (size_t i = 0; i < cache->len; i++) {
+      cache->spans[i].o = NULL;
+    }
+    inc->text = NULL;
+    inc->spans = NULL;
+  }
+  incremental_free(inc);
+  c->incremental = NULL;
+}
+
+// Adds a form to this call's split; one carried over from the last call
+// brings its C along unless another form has already claimed it, and a
+// new one looks for C made from the same text.
+static void incremental_span(Incremental *inc, FormSpan span, bool carried) {
+  if (carried) {
+    span.o = NULL;
+    if (span.cached != NULL && span.cached->claimed) {
+      span.cached = NULL;
+    }
+  } else {
+    span.hash = text_hash(inc->text + span.beg, span.end - span.beg);
+    span.cached = form_cache_find(inc->cache, inc->text + span.beg,
+                                  span.end - span.beg, span.hash);
+  }
+  if (span.cached != NULL) {
+    span.cached->claimed = true;
+  }
+  if (inc->len >= inc->buffer) {
+    size_t buffer = inc->buffer == 0 ? 256 : inc->buffer * 2;
+    inc->spans = CHECK_ALLOC(realloc(inc->spans, buffer * sizeof(FormSpan)));
+    inc->buffer = buffer;
+  }
+  inc->spans[inc->len++] = span;
+}
+
+static size_t common_prefix(const char *a, const char *b, size_t n) {
+  size_t i = 0;
+  while (i + 64 <= n && memcmp(a + i, b + i, 64) == 0) {
+    i += 64;
+  }
+  while (i < n && a[i] == b[i]) {
+    i++;
+  }
+  return i;
+}
+
+// Of the last `n` bytes of a and b.
+static size_t common_suffix(const char *a, const char *b, size_t n) {
+  size_t i = 0;
+  while (i + 64 <= n && memcmp(a - i - 64, b - i - 64, 64) == 0) {
+    i += 64;
+  }
+  while (i < n && a[-(ptrdiff_t)i - 1] == b[-(ptrdiff_t)i - 1]) {
+    i++;
+  }
+  return i;
+}
+
+// Splits the text into top-level forms, reading blanks, comments, atoms
+// and literals the way the parser does but building nothing. The last
+// call's forms before the change are carried over as they were; the
+// split restarts after them and stops at the first form past the change
+// that starts where one of the old forms did (same text from there on,
+// same column), carrying the rest over moved. False for input the parser
+// would reject; the full transpile then reports it.
+static bool incremental_split(Incremental *inc) {
+  FormCache *cache = inc->cache;
+  const char *data = inc->text;
+  size_t len = inc->text_len;
+  size_t old_len = cache->text_len;
+  size_t n = len < old_len ? len : old_len;
+  size_t prefix = cache->text == NULL ? 0 : common_prefix(data, cache->text, n);
+  size_t suffix = cache->text == NULL
+                      ? 0
+                      : common_suffix(data + len, cache->text + old_len,
+                                      n - prefix);
+  size_t changed = len - suffix; // where the new text's unchanged tail begins
+
+  size_t j = 0;
+  while (j < cache->len && cache->spans[j].end < prefix) {
+    incremental_span(inc, cache->spans[j++], true);
+  }
+  size_t off = 0;
+  uint32_t row = 0;
+  size_t line = 0; // where the current row starts
+  if (inc->len > 0) {
+    FormSpan *last = &inc->spans[inc->len - 1];
+    off = last->end;
+    row = last->end_pos.row;
+    line = off - last->end_pos.col;
+  }
+
+  size_t depth = 0;
+  FormSpan span = {0};
+  while (off < len) {
+    unsigned char ch = (unsigned char)data[off];
+    if (ch == '\n') {
+      row++;
+      line = ++off;
+      continue;
+    }
+    if (isspace(ch)) {
+      off++;
+      continue;
+    }
+    if (ch == ';' || shebang_p(data, len, off)) {
+      const char *nl = memchr(data + off, '\n', len - off);
+      off = nl == NULL ? len : (size_t)(nl - data);
+      continue;
+    }
+
+    if (depth == 0) {
+      span = (FormSpan){.beg = off, .pos = {row, (uint32_t)(off - line)}};
+      if (off >= changed) {
+        while (j < cache->len && cache->spans[j].beg + len < off + old_len) {
+          j++;
+        }
+        if (j < cache->len && cache->spans[j].beg + len == off + old_len &&
+            cache->spans[j].pos.col == span.pos.col) {
+          uint32_t from = cache->spans[j].pos.row;
+          for (; j < cache->len; j++) {
+            FormSpan moved = cache->spans[j];
+            moved.beg = moved.beg + len - old_len;
+            moved.end = moved.end + len - old_len;
+            moved.pos.row = moved.pos.row - from + row;
+            moved.end_pos.row = moved.end_pos.row - from + row;
+            incremental_span(inc, moved, true);
+          }
+          return true;
+        }
+      }
+    }
+    if (ch == '(') {
+      depth++;
+      off++;
+      continue;
+    }
+    if (ch == ')') {
+      if (depth == 0) {
+        return false;
+      }
+      depth--;
+      off++;
+    } else if (ch == '"' || ch == '\'') {
+      size_t p = off + 1;
+      bool closed = false;
+      while (p < len && !closed) {
+        p += scan_literal(data + p, len - p);
+        if (p == len) {
+          break;
+        }
+        if (data[p] == '\n') {
+          row++;
+          line = p + 1;
+        } else if (data[p] == '\\' && p + 1 < len) {
+          p++;
+          if (data[p] == '\n') {
+            row++;
+            line = p + 1;
+          }
+        } else if (data[p] == (char)ch) {
+          closed = true;
+        }
+        p++;
+      }
+      if (!closed) {
+        return false;
+      }
+      off = p;
+    } else {
+      off += scan_atom(data + off, len - off);
+    }
+
+    if (depth == 0) {
+      span.end = off;
+      span.end_pos = (Pos){row, (uint32_t)(off - line)};
+      incremental_span(inc, span, false);
+    }
+  }
+  return depth == 0;
+}
+
+// Parses the one form `span` covers, starting the parser mid-file.
+static Obj *incremental_parse(Parser *parser, FormSpan *span) {
+  if (span->o == NULL) {
+    SrcFile *src = parser->srcfile;
+    src->off = span->beg;
+    src->pos = span->pos;
+    src->held = EOF;
+    src->eof = false;
+    parser_next(parser);
+    span->o = arena_alloc(parser->arena, sizeof(Obj));
+    *span->o = parser->stack[--parser->stack_len];
+  }
+  return span->o;
+}
+
+// Appends `f`'s spans. A move is by whole rows, and by columns too on
+// the form's first row, which is all an edit before it can shift.
+static void incremental_map(Incremental *inc, CachedForm *f, Pos pos) {
+  for (size_t i = 0; i < f->map.len; i++) {
+    SicSpan *span = &f->map.spans[i];
+    if (span->line == f->row) {
+      span->column += pos.col - f->col;
+    }
+    if (span->end_line == f->row) {
+      span->end_column += pos.col - f->col;
+    }
+    span->line += pos.row - f->row;
+    span->end_line += pos.row - f->row;
+    if (span->call_line == f->row + 1) {
+      span->call_column += pos.col - f->col;
+    }
+    if (span->call_line != 0) {
+      span->call_line += pos.row - f->row;
+    }
+    SicSpan moved = *span;
+    moved.c_line += inc->lines;
+    span_push(&inc->map, moved);
+  }
+}
+
+// Appends `f`'s C, first moving its #line rows to where the form now
+// starts.
+static void incremental_emit(Incremental *inc, CachedForm *f, Pos pos) {
+  uint32_t row = pos.row;
+  if (ctx->mapping) {
+    incremental_map(inc, f, pos);
+  }
+  if (f->row != row && f->rows_len > 0) {
+    // Rows fit in 10 digits, so no number grows by more than that.
+    char *moved = CHECK_ALLOC(malloc(f->c_len + f->rows_len * 10 + 1));
+    size_t len = 0;
+    size_t from = 0;
+    for (size_t i = 0; i < f->rows_len; i++) {
+      const char *p = f->c + f->rows[i];
+      uint64_t old = 0;
+      while (*p >= '0' && *p <= '9') {
+        old = old * 10 + (uint64_t)(*p++ - '0');
+      }
+      memcpy(moved + len, f->c + from, f->rows[i] - from);
+      len += f->rows[i] - from;
+      f->rows[i] = len;
+      char digits[20];
+      size_t n = 0;
+      for (uint64_t v = old - f->row + row;; v /= 10) {
+        digits[n++] = (char)('0' + v % 10);
+        if (v < 10) {
+          break;
+        }
+      }
+      while (n > 0) {
+        moved[len++] = digits[--n];
+      }
+      from = (size_t)(p - f->c);
+    }
+    memcpy(moved + len, f->c + from, f->c_len - from + 1);
+    free(f->c);
+    f->c = moved;
+    f->c_len = len + f->c_len - from;
+  }
+  f->row = row;
+  f->col = pos.col;
+  buf_write(&inc->out, f->c, f->c_len);
+  inc->lines += f->lines;
+  if (ctx->header != NULL) {
+    buf_write(&inc->h, f->h, f->h_len);
+  }
+}
+
+// Still good if every head it looked up names what it did then and its
+// gensyms would be named the same; when the visible macros are exactly
+// the same, the former is a given. The text, so the hash, is unchanged.
+static bool incremental_current(Incremental *inc, CachedForm *f,
+                                FormKey key) {
+  if (ctx->mapping && !f->mapped) {
+    return false;
+  }
+  if (f->gensyms && key.ordinal != f->key.ordinal) {
+    return false;
+  }
+  if (ctx->header != NULL && !f->declared) {
+    return false;
+  }
+  if (f->macros == inc->macros) {
+    return true;
+  }
+  for (size_t i = 0; i < f->deps_len; i++) {
+    if (deftable_get(&inc->defs, f->deps[i].name) != f->deps[i].def) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void incremental_register(Incremental *inc, Obj *o, FormSpan *span) {
+  macro_register(o);
+  Obj *name = obj_at(o, 1);
+  uint64_t key = text_hash(obj_text(name), strlen(obj_text(name)));
+  uint64_t def = text_hash(inc->text + span->beg, span->end - span->beg);
+  deftable_put(&inc->defs, key, def);
+  inc->macros = (inc->macros ^ key) * 1099511628211u ^ def;
+}
+
+static uint64_t module_macro_def(Macro *m);
+
+// Like a defmacro, an import is done on every call, so a module edited
+// since the last one is seen; its macros stand in the table by the hash
+// their image gives them. Its C goes straight to the output. It is
+// numbered among the forms as if expanded, as it is in a whole file.
+static void incremental_import(Incremental *inc, FormKeys *keys, Obj *o) {
+  size_t first = ctx->macros_len;
+  module_import(o);
+  form_key(keys, o, ctx->macros_len);
+  for (size_t i = first; i < ctx->macros_len; i++) {
+    Macro *m = &ctx->macros[i];
+    uint64_t key = text_hash(m->name, strlen(m->name));
+    uint64_t def = module_macro_def(m);
+    deftable_put(&inc->defs, key, def);
+    inc->macros = (inc->macros ^ key) * 1099511628211u ^ def;
+  }
+  transpile_statement(o, ctx->code);
+  SpanList *map = &ctx->code->map;
+  for (size_t i = 0; i < map->len; i++) {
+    SicSpan span = map->spans[i];
+    span.c_line += inc->lines;
+    span_push(&inc->map, span);
+  }
+  map->len = 0;
+  inc->lines += (uint32_t)ctx->code->count;
+  size_t len;
+  char *c = ccode_take(ctx->code, &len);
+  buf_write(&inc->out, c, len);
+  free(c);
+  if (ctx->header != NULL) {
+    header_declare(o, inc->decls);
+    c = ccode_take(inc->decls, &len);
+    buf_write(&inc->h, c, len);
+    free(c);
+  }
+}
+
+// A line ccode_mark_line wrote, as opposed to one that merely starts
+// with the same text inside a multi-line literal.
+static bool line_marker_p(const char *c, const char *p) {
+  if (p != c && p[-1] != '\n') {
+    return false;
+  }
+  p += 6;
+  size_t digits = strspn(p, "0123456789");
+  return digits > 0 && p[digits] == ' ' && p[digits + 1] == '"';
+}
+
+// Drops what a form that won't be kept left in the output.
+static void incremental_discard(Incremental *inc) {
+  ccode_free(ctx->code);
+  ctx->code = NULL;
+  ccode_free(inc->decls);
+  inc->decls = NULL;
+  ctx->code = ccode_output();
+  inc->decls = header_init();
+}
+
+// Emits `o` into ctx->code and declares it into inc->decls. A failure in
+// either is recorded, unless one that ranks before it already is, rather
+// than raised; running out of memory is raised. Returns the phase that
+// failed, or PARALLEL_DONE.
+static ParallelPhase incremental_output(Incremental *inc, Obj *o) {
+  Failure *outer = failure;
+  Failure caught = {0};
+  volatile ParallelPhase phase = PARALLEL_EMIT;
+  failure = &caught;
+  if (setjmp(caught.jump) == 0) {
+    transpile_statement(o, ctx->code);
+    phase = PARALLEL_DECLARE;
+    header_declare(o, inc->decls);
+    failure = outer;
+    return PARALLEL_DONE;
+  }
+  failure = outer;
+  if (caught.message.len == 0) {
+    fail_again(&caught);
+  }
+  // Declaring is only a failure if a header was asked for.
+  if (phase < inc->failed_phase &&
+      (phase == PARALLEL_EMIT || ctx->header != NULL)) {
+    inc->failed_phase = phase;
+    failure_copy(&inc->failed, &caught);
+  }
+  free(caught.message.data);
+  free(caught.file.data);
+  if (phase == PARALLEL_EMIT) {
+    incremental_discard(inc);
+  } else {
+    ccode_free(inc->decls);
+    inc->decls = NULL;
+    inc->decls = header_init();
+  }
+  return phase;
+}
+
+// Expands and emits `o` afresh, and remembers what it depended on. Once
+// a failure is waiting it is only expanded, or emitted too if what
+// failed was declaring, and nothing is kept.
+static CachedForm *incremental_redo(Incremental *inc, Expander *ex, Obj *o,
+                                    FormSpan *span, FormKey key) {
+  symmap_clear(&inc->heads);
+  expand_form(ex, o, ctx->macros_len, key);
+  if (inc->failed_phase == PARALLEL_EMIT) {
+    return NULL;
+  }
+  ParallelPhase failed = incremental_output(inc, o);
+  if (inc->failed_phase != PARALLEL_DONE) {
+    if (failed == PARALLEL_DONE) {
+      incremental_discard(inc);
+    }
+    return NULL;
+  }
+
+  CachedForm *f = CHECK_ALLOC(calloc(1, sizeof(CachedForm)));
+  f->len = span->end - span->beg;
+  f->text = CHECK_ALLOC(malloc(f->len));
+  memcpy(f->text, inc->text + span->beg, f->len);
+  f->hash = span->hash;
+  f->row = span->pos.row;
+  f->col = span->pos.col;
+  f->macros = inc->macros;
+  f->key = key;
+  f->gensyms = ex->gensyms.next > 0;
+  f->deps = CHECK_ALLOC(malloc((inc->heads.len + 1) * sizeof(HeadDep)));
+  for (uint32_t i = 0; i < inc->heads.cap; i++) {
+    uint32_t sym = inc->heads.keys[i];
+    if (sym != SYM_NONE) {
+      uint64_t key = text_hash(sym_name(sym), ctx->symtab.lens[sym]);
+      f->deps[f->deps_len++] =
+          (HeadDep){.name = key, .def = deftable_get(&inc->defs, key)};
+    }
+  }
+
+  f->lines = (uint32_t)ctx->code->count;
+  f->mapped = ctx->mapping;
+  f->map = ctx->code->map;
+  ctx->code->map = (SpanList){0};
+  for (size_t i = 0; i < f->map.len; i++) {
+    SicSpan span = f->map.spans[i];
+    span.c_line += inc->lines;
+    span_push(&inc->map, span);
+  }
+  f->c = ccode_take(ctx->code, &f->c_len);
+  size_t rows = 0;
+  for (size_t pass = 0; pass < 2; pass++) {
+    for (char *p = f->c; (p = strstr(p, "#line ")) != NULL; p++) {
+      if (line_marker_p(f->c, p)) {
+        if (pass == 0) {
+          rows++;
+        } else {
+          f->rows[f->rows_len++] = (size_t)(p + 6 - f->c);
+        }
+      }
+    }
+    if (pass == 0) {
+      f->rows = CHECK_ALLOC(malloc((rows + 1) * sizeof(size_t)));
+    }
+  }
+  buf_write(&inc->out, f->c, f->c_len);
+  inc->lines += f->lines;
+
+  // Kept whether or not this call asked for a header, so the next that
+  // does can reuse the form.
+  f->declared = failed == PARALLEL_DONE;
+  f->h = ccode_take(inc->decls, &f->h_len);
+  if (ctx->header != NULL) {
+    buf_write(&inc->h, f->h, f->h_len);
+  }
+  return f;
+}
+
+static void transpile_incremental(SrcFile *src, const SicOptions *options,
+                                  SicOutput *out) {
+  if (src == NULL) {
+    fail("Unable to access %s.", ctx->srcname);
+  }
+  FormCache *cache = form_cache_for(ctx, ctx->srcname);
+  Incremental *inc = ctx->incremental =
+      CHECK_ALLOC(calloc(1, sizeof(Incremental)));
+  inc->cache = cache;
+  inc->failed_phase = PARALLEL_DONE;
+  inc->text = CHECK_ALLOC(malloc(src->len + 1));
+  memcpy(inc->text, src->data, src->len + 1);
+  inc->text_len = src->len;
+  if (!incremental_split(inc)) {
+    inc->len = 0;
+    transpile_whole(src, options, out);
+    return;
+  }
+
+  // Forms with C to reuse needn't be parsed unless it turns out stale;
+  // the rest are parsed up front, so a syntax error anywhere still comes
+  // before any other.
+  Parser *parser = ctx->parser = parser_init(src, &ctx->arena);
+  for (size_t i = 0; i < inc->len; i++) {
+    if (inc->spans[i].cached == NULL) {
+      incremental_parse(parser, &inc->spans[i]);
+    }
+  }
+
+  Expander *ex = ctx->expander = CHECK_ALLOC(calloc(1, sizeof(Expander)));
+  ex->arena = &ctx->arena;
+  ex->heads = &inc->heads;
+  ctx->code = ccode_output();
+  inc->decls = header_init();
+  for (size_t i = 0; i < inc->len; i++) {
+    FormSpan *span = &inc->spans[i];
+    CachedForm *f = span->cached;
+    FormKey key = {0};
+    if (f != NULL) {
+      key = form_number(&ex->keys, f->key.hash, ctx->macros_len);
+      if (incremental_current(inc, f, key)) {
+        f->macros = inc->macros;
+        incremental_emit(inc, f, span->pos);
+        incremental_keep(inc, f);
+        continue;
+      }
+    }
+
+    Obj *o = incremental_parse(parser, span);
+    if (form_is_defmacro(o)) {
+      incremental_register(inc, o, span);
+      continue;
+    }
+    if (form_is_import(o)) {
+      incremental_import(inc, &ex->keys, o);
+      continue;
+    }
+    if (f == NULL) {
+      key = form_number(&ex->keys, form_hash(&ex->keys, o), ctx->macros_len);
+    }
+    ArenaMark mark = arena_mark(&ctx->arena);
+    span->cached = incremental_redo(inc, ex, o, span, key);
+    if (span->cached != NULL) {
+      incremental_keep(inc, span->cached);
+    }
+    arena_release(&ctx->arena, mark);
+  }
+  if (inc->failed_phase != PARALLEL_DONE) {
+    Failure failed = inc->failed;
+    inc->failed = (Failure){0};
+    fail_again(&failed);
+  }
+
+  buf_write(&inc->out, "", 1);
+  out->c = inc->out.data;
+  out->len = inc->out.len - 1;
+  inc->out = (Buf){0};
+  if (ctx->mapping) {
+    span_finish(&inc->map, out);
+  }
+  if (ctx->header != NULL) {
+    header_finish(inc->h.data, inc->h.len, out);
+  }
+}
+
+// ==== Modules ====
+// (import "prelude.sic") brings in another file's macros, and the C its
+// importers need of it: prototypes of its functions, and its struct,
+// union, enum, typedef, #define and #include forms. The name is relative
+// to the importing file's directory. Importing a module imports what it
+// imports; each module is imported once per file, and its C goes at the
+// first import that reaches it, after the C of the modules it imports.
+//
+// A module is compiled once, in a context of its own, into an image kept
+// beside it as .sic-cache/<name>.sicm: its macros as node trees, and its
+// C. The image stays good while every file it was made from -- the
+// module and all it imports -- has the inode, size and mtime it had
+// then, and libsic is the build that wrote it; otherwise the module is
+// compiled again. Importing a good image maps it and registers its
+// macros by name; a macro's trees are built from it the first time the
+// macro is expanded, so an import costs its stats and names, not its
+// size. Where the image can't be written, the module's compiled image is
+// used from memory.
+#define MODULE_MAGIC "sicm\0\0\0\1"
+
+static const char MODULE_BUILD[24] = __DATE__ " " __TIME__;
+
+typedef struct ModuleHeader {
+  char magic[8];
+  char build[24];      // MODULE_BUILD of the libsic that wrote it
+  uint32_t deps_len;   // the module, then each module it imports
+  uint32_t macros_len; // those it defines itself
+  uint32_t nodes_len;
+  uint32_t unused;
+  uint64_t strings_len; // '\0'-terminated texts
+  uint64_t c_len;       // minus the '\0' after it
+} ModuleHeader;
+
+// A file as the image was made from it. The header is followed by the
+// deps, macros, nodes, strings and C, in that order.
+struct ModuleDep {
+  uint64_t path; // offset in the strings
+  uint64_t dev;
+  uint64_t ino;
+  uint64_t size;
+  int64_t mtime; // in nanoseconds
+};
+
+// A macro's nodes are `len` from `nodes`: its parameter list, its
+// template, then their descendants, each form's children contiguous.
+typedef struct ModuleMacro {
+  uint64_t name; // offset in the strings
+  uint64_t def;  // hash of its trees, which incremental calls compare
+  uint32_t nodes;
+  uint32_t len;
+  uint32_t has_rest;
+  uint32_t unused;
+} ModuleMacro;
+
+typedef struct ModuleNode {
+  uint32_t tag;
+  uint32_t len; // SEXP: children; ATOM: bytes of text
+  uint64_t ref; // SEXP: its first child, counted from the macro's first
+                // node; ATOM: offset of its text
+} ModuleNode;
+
+struct Module {
+  char *path; // canonical
+  char *image;
+  size_t size;
+  bool mapped; // rather than compiled into memory by this call
+  const ModuleHeader *header;
+  const ModuleDep *deps;
+  const ModuleMacro *macros;
+  const ModuleNode *nodes;
+  const char *strings;
+  const char *c;
+};
+
+// The modules one top-level import brought in: ctx->modules[first] on.
+struct ImportSite {
+  Pos pos;
+  size_t first;
+  size_t len;
+};
+
+// A module being imported, found by walking out through the contexts
+// compiling modules for their importers, to refuse a cycle.
+struct Importing {
+  const char *path;
+  Importing *outer;
+};
+
+static bool sic_run(Context *c, SicCall *call);
+
+static void module_free(Module *mod) {
+  if (mod->mapped) {
+    munmap(mod->image, mod->size);
+  } else {
+    free(mod->image);
+  }
+  free(mod->path);
+  free(mod);
+}
+
+static bool module_stat(const char *path, ModuleDep *dep) {
+  struct stat st;
+  if (stat(path, &st) != 0) {
+    return false;
+  }
+  *dep = (ModuleDep){.dev = (uint64_t)st.st_dev,
+                     .ino = (uint64_t)st.st_ino,
+                     .size = (uint64_t)st.st_size,
+                     .mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 +
+                              st.st_mtim.tv_nsec};
+  return true;
+}
+
+// <dir>/.sic-cache/<name>.sicm for the module at <dir>/<name>.
+static char *module_image_path(const char *path) {
+  const char *name = strrchr(path, '/') + 1;
+  size_t size = strlen(path) + sizeof("/.sic-cache") + sizeof(".sicm");
+  char *image = CHECK_ALLOC(malloc(size));
+  snprintf(image, size, "%.*s.sic-cache/%s.sicm", (int)(name - path), path,
+           name);
+  return image;
+}
+
+// Takes `image` over, or frees it and returns NULL if it isn't one this
+// build wrote.
+static Module *module_init(const char *path, char *image, size_t size,
+                           bool mapped) {
+  const ModuleHeader *h = (const ModuleHeader *)image;
+  size_t fixed = sizeof(ModuleHeader);
+  bool ok = size >= fixed && memcmp(h->magic, MODULE_MAGIC, 8) == 0 &&
+            memcmp(h->build, MODULE_BUILD, sizeof(MODULE_BUILD)) == 0;
+  if (ok) {
+    fixed += h->deps_len * sizeof(ModuleDep) +
+             h->macros_len * sizeof(ModuleMacro) +
+             h->nodes_len * sizeof(ModuleNode);
+    ok = h->deps_len > 0 && h->strings_len > 0 && fixed < size &&
+         h->strings_len < size - fixed &&
+         h->c_len == size - fixed - h->strings_len - 1 &&
+         image[fixed + h->strings_len - 1] == '\0' && image[size - 1] == '\0';
+  }
+  if (!ok) {
+    if (mapped) {
+      munmap(image, size);
+    } else {
+      free(image);
+    }
+    return NULL;
+  }
+
+  Module *mod = CHECK_ALLOC(calloc(1, sizeof(Module)));
+  mod->path = CHECK_ALLOC(strdup(path));
+  mod->image = image;
+  mod->size = size;
+  mod->mapped = mapped;
+  mod->header = h;
+  mod->deps = (const ModuleDep *)(h + 1);
+  mod->macros = (const ModuleMacro *)(mod->deps + h->deps_len);
+  mod->nodes = (const ModuleNode *)(mod->macros + h->macros_len);
+  mod->strings = (const char *)(mod->nodes + h->nodes_len);
+  mod->c = mod->strings + h->strings_len;
+  return mod;
+}
+
+static bool module_current(Module *mod) {
+  if (strcmp(mod->strings + mod->deps[0].path, mod->path) != 0) {
+    return false;
+  }
+  for (uint32_t i = 0; i < mod->header->deps_len; i++) {
+    const ModuleDep *dep = &mod->deps[i];
+    ModuleDep now;
+    if (dep->path >= mod->header->strings_len ||
+        !module_stat(mod->strings + dep->path, &now) || now.dev != dep->dev ||
+        now.ino != dep->ino || now.size != dep->size ||
+        now.mtime != dep->mtime) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The module at `path` from its image, if that is good.
+static Module *module_map(const char *path) {
+  char *image = module_image_path(path);
+  int fd = open(image, O_RDONLY);
+  free(image);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat st;
+  void *data = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (data == MAP_FAILED) {
+    return NULL;
+  }
+  Module *mod = module_init(path, data, (size_t)st.st_size, true);
+  if (mod != NULL && !module_current(mod)) {
+    module_free(mod);
+    mod = NULL;
+  }
+  return mod;
+}
+
+// Best effort: the image goes to a temporary file renamed into place, so
+// a concurrent import maps either the old image or the new one.
+static void module_write(const char *path, const char *image, size_t size) {
+  char *file = module_image_path(path);
+  char *slash = strrchr(file, '/');
+  *slash = '\0';
+  mkdir(file, 0777);
+  *slash = '/';
+  size_t n = strlen(file) + sizeof(".XXXXXX");
+  char temp[n];
+  snprintf(temp, n, "%s.XXXXXX", file);
+  int fd = mkstemp(temp);
+  if (fd >= 0) {
+    bool ok = fchmod(fd, 0644) == 0;
+    for (size_t off = 0; ok && off < size;) {
+      ssize_t written = write(fd, image + off, size - off);
+      ok = written > 0;
+      off += ok ? (size_t)written : 0;
+    }
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(temp, file) != 0) {
+      remove(temp);
+    }
+  }
+  free(file);
+}
+
+// Which of the forms importers see the top-level form `o` is, once
+// expanded: 0 for fn, more for the declarations, -1 for none.
+static int declare_kind(Obj *o) {
+  static const char *const kinds[] = {
+      "fn", "struct", "union", "enum", "typedef", "#define", "#include"};
+  if (o->tag != SEXP || o->len == 0 || obj_at(o, 0)->tag != ATOM) {
+    return -1;
+  }
+  const char *head = obj_text(obj_at(o, 0));
+  for (int i = 0; i < (int)(sizeof(kinds) / sizeof(kinds[0])); i++) {
+    if (strcmp(head, kinds[i]) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// The C importers see of the top-level form `o`, once expanded.
+static void module_declare(Obj *o, CCode *code) {
+  int kind = declare_kind(o);
+  if (kind < 0) {
+    return;
+  }
+  Obj form = *o;
+  if (kind == 0 && form.len > 4) {
+    form.len = 4; // the body dropped leaves the prototype
+  }
+  transpile_statement(&form, code);
+}
+
+static uint64_t module_string(Buf *strings, const char *text, size_t len) {
+  uint64_t off = strings->len;
+  buf_write(strings, text, len);
+  buf_write(strings, "", 1);
+  return off;
+}
+
+// The image of the module this context compiled: what it imports, the
+// macros it defines, and `c`.
+static char *module_image(const ModuleDep *self, const char *c, size_t c_len,
+                          size_t *size) {
+  Context *m = ctx;
+  Buf strings = {0};
+  Buf nodes = {0};
+  Buf shape = {0};
+  size_t deps_len = 1 + m->modules_len;
+  ModuleDep *deps = CHECK_ALLOC(malloc(deps_len * sizeof(ModuleDep)));
+  deps[0] = *self;
+  deps[0].path = module_string(&strings, m->srcname, strlen(m->srcname));
+  for (size_t i = 0; i < m->modules_len; i++) {
+    Module *mod = m->modules[i];
+    deps[i + 1] = mod->deps[0];
+    deps[i + 1].path = module_string(&strings, mod->path, strlen(mod->path));
+  }
+
+  ModuleMacro *macros =
+      CHECK_ALLOC(malloc((m->macros_len + 1) * sizeof(ModuleMacro)));
+  size_t macros_len = 0;
+  Obj **objs = NULL; // by node index, the trees being written
+  size_t objs_len = 0;
+  size_t objs_buffer = 0;
+  for (size_t i = 0; i < m->macros_len; i++) {
+    Macro *macro = &m->macros[i];
+    if (macro->module != NULL) {
+      continue;
+    }
+    size_t first = objs_len;
+    if (objs_len + 2 > objs_buffer) {
+      objs_buffer = objs_buffer == 0 ? 64 : objs_buffer * 2;
+      objs = CHECK_ALLOC(realloc(objs, objs_buffer * sizeof(Obj *)));
+    }
+    objs[objs_len++] = macro->params;
+    objs[objs_len++] = macro->template;
+    shape.len = 0;
+    for (size_t k = first; k < objs_len; k++) {
+      Obj *o = objs[k];
+      ModuleNode node = {.tag = o->tag, .len = o->len};
+      if (o->tag == ATOM) {
+        node.ref = module_string(&strings, obj_text(o), o->len);
+        buf_write(&shape, obj_text(o), o->len + 1);
+      } else {
+        node.ref = objs_len - first;
+        while (objs_len + o->len > objs_buffer) {
+          objs_buffer *= 2;
+          objs = CHECK_ALLOC(realloc(objs, objs_buffer * sizeof(Obj *)));
+        }
+        for (uint32_t j = 0; j < o->len; j++) {
+          objs[objs_len++] = obj_at(o, j);
+        }
+        buf_write(&shape, (const char *)&o->len, sizeof(o->len));
+        buf_write(&shape, "(", 1);
+      }
+      buf_write(&nodes, (const char *)&node, sizeof(node));
+    }
+    macros[macros_len++] = (ModuleMacro){
+        .name = module_string(&strings, macro->name, strlen(macro->name)),
+        .def = text_hash(shape.data, shape.len),
+        .nodes = (uint32_t)first,
+        .len = (uint32_t)(objs_len - first),
+        .has_rest = macro->has_rest};
+  }
+
+  ModuleHeader h = {.deps_len = (uint32_t)deps_len,
+                    .macros_len = (uint32_t)macros_len,
+                    .nodes_len = (uint32_t)objs_len,
+                    .strings_len = strings.len,
+                    .c_len = c_len};
+  memcpy(h.magic, MODULE_MAGIC, 8);
+  memcpy(h.build, MODULE_BUILD, sizeof(MODULE_BUILD));
+  Buf image = {0};
+  buf_write(&image, (const char *)&h, sizeof(h));
+  buf_write(&image, (const char *)deps, deps_len * sizeof(ModuleDep));
+  buf_write(&image, (const char *)macros, macros_len * sizeof(ModuleMacro));
+  if (nodes.len > 0) {
+    buf_write(&image, nodes.data, nodes.len);
+  }
+  buf_write(&image, strings.data, strings.len);
+  buf_write(&image, c, c_len + 1);
+  free(deps);
+  free(macros);
+  free(objs);
+  free(nodes.data);
+  free(strings.data);
+  free(shape.data);
+  *size = image.len;
+  return image.data;
+}
+
+// Expands the module's top-level forms for their errors and their
+// macros' sake, but emits only what importers see of them.
+static void transpile_module(SrcFile *src, const ModuleDep *self,
+                             SicOutput *out) {
+  ctx->parser = parser_init(src, &ctx->arena);
+  parser_parse(ctx->parser);
+  Obj *top = ctx->parser->root;
+  expand_toplevel(top, &ctx->arena);
+  ctx->code = ccode_init();
+  for (size_t i = 0; i < top->len; i++) {
+    module_declare(obj_at(top, i), ctx->code);
+  }
+  size_t c_len;
+  char *c = ccode_take(ctx->code, &c_len);
+  out->c = module_image(self, c, c_len, &out->len);
+  free(c);
+}
+
+// Compiles the module at `path` in a context of its own, whose failure
+// becomes this one's. The file is stat'ed before it is read, so an edit
+// in between leaves the image stale rather than wrong.
+static Module *module_compile(const char *path, Pos pos) {
+  ModuleDep self;
+  if (!module_stat(path, &self)) {
+    fail_at(pos, "can't import %s: %s", path, strerror(errno));
+  }
+  Context *c = CHECK_ALLOC(sic_init());
+  c->parent = ctx;
+  SicOutput out;
+  SicCall call = {.name = path,
+                  .path = path,
+                  .module = &self,
+                  .out = &out};
+  if (!sic_run(c, &call)) {
+    const SicError *e = &c->error;
+    char file[strlen(e->file) + 1];
+    char message[strlen(e->message) + 1];
+    memcpy(file, e->file, sizeof(file));
+    memcpy(message, e->message, sizeof(message));
+    SicError error = {.file = file,
+                      .line = e->line,
+                      .column = e->column,
+                      .message = message};
+    sic_free(c);
+    fail_in(&error);
+  }
+  sic_free(c);
+  module_write(path, out.c, out.len);
+  return module_init(path, out.c, out.len, false);
+}
+
+static void module_register(Module *mod, Pos pos) {
+  for (uint32_t i = 0; i < mod->header->macros_len; i++) {
+    const ModuleMacro *mm = &mod->macros[i];
+    if (mm->name >= mod->header->strings_len || mm->len < 2 ||
+        mm->len > mod->header->nodes_len ||
+        mm->nodes > mod->header->nodes_len - mm->len) {
+      fail("the image of %s is corrupt", mod->path);
+    }
+    char *name = (char *)mod->strings + mm->name;
+    uint32_t sym = sym_intern(name, strlen(name));
+    if (macro_find(sym) != NULL) {
+      fail_at(pos, "macro '%s' from %s is already defined", name, mod->path);
+    }
+    macro_add((Macro){.name = name,
+                      .sym = sym,
+                      .has_rest = mm->has_rest,
+                      .module = mod,
+                      .index = i});
+  }
+}
+
+// Builds an imported macro's trees, in the context's module arena.
+// Literal text longer than a node holds stays in the image.
+static void module_macro_load(Macro *m) {
+  Module *mod = m->module;
+  const ModuleMacro *mm = &mod->macros[m->index];
+  const ModuleNode *nodes = &mod->nodes[mm->nodes];
+  Obj *objs = arena_alloc(&ctx->module_arena, mm->len * sizeof(Obj));
+  for (uint32_t i = 0; i < mm->len; i++) {
+    const ModuleNode *n = &nodes[i];
+    bool ok = n->tag == SEXP ? n->ref <= mm->len && n->len <= mm->len - n->ref
+              : n->tag == ATOM
+                  ? n->ref < mod->header->strings_len &&
+                        n->len < mod->header->strings_len - n->ref &&
+                        mod->strings[n->ref + n->len] == '\0'
+                  : false;
+    if (!ok || (i == 0 && n->tag != SEXP)) {
+      fail("the image of %s is corrupt", mod->path);
+    }
+    if (n->tag == SEXP) {
+      objs[i] = (Obj){.tag = SEXP, .len = n->len, .items = &objs[n->ref]};
+      continue;
+    }
+    char *text = (char *)mod->strings + n->ref;
+    objs[i] = atom_is_literal(text)
+                  ? obj_atom_ref(text, n->len, (Pos){0})
+                  : obj_sym(sym_intern(text, n->len), (Pos){0});
+  }
+  m->params = &objs[0];
+  m->template = &objs[1];
+}
+
+static void module_load_all(void) {
+  for (size_t i = 0; i < ctx->macros_len; i++) {
+    if (ctx->macros[i].template == NULL) {
+      module_macro_load(&ctx->macros[i]);
+    }
+  }
+}
+
+static uint64_t module_macro_def(Macro *m) {
+  return m->module->macros[m->index].def;
+}
+
+// Imports the module at the canonical `path` and, first, everything it
+// imports, unless this file already has. `pos` is the import's.
+static void module_import_path(const char *path, Pos pos) {
+  for (Context *c = ctx; c != NULL; c = c->parent) {
+    for (Importing *in = c->importing; in != NULL; in = in->outer) {
+      if (strcmp(in->path, path) == 0) {
+        fail_at(pos, "import cycle through %s", path);
+      }
+    }
+  }
+  for (size_t i = 0; i < ctx->modules_len; i++) {
+    if (strcmp(ctx->modules[i]->path, path) == 0) {
+      return;
+    }
+  }
+
+  Importing importing = {.path = path, .outer = ctx->importing};
+  ctx->importing = &importing;
+  Module *mod = module_map(path);
+  if (mod == NULL) {
+    mod = module_compile(path, pos);
+  }
+  // Owned by the context from here on, and moved after its imports once
+  // they are in.
+  Context *c = ctx;
+  c->modules = CHECK_ALLOC(
+      realloc(c->modules, (c->modules_len + 1) * sizeof(Module *)));
+  size_t at = c->modules_len++;
+  c->modules[at] = mod;
+  for (uint32_t i = 1; i < mod->header->deps_len; i++) {
+    module_import_path(mod->strings + mod->deps[i].path, pos);
+  }
+  memmove(&c->modules[at], &c->modules[at + 1],
+          (c->modules_len - at - 1) * sizeof(Module *));
+  c->modules[c->modules_len - 1] = mod;
+  module_register(mod, pos);
+  ctx->importing = importing.outer;
+}
+
+// The import form `o`, at the top level: registers what it brings in and
+// remembers it for transpile_import.
+static void module_import(Obj *o) {
+  Obj *name = o->len == 2 ? obj_at(o, 1) : NULL;
+  const char *text = name != NULL && name->tag == ATOM ? obj_text(name) : "";
+  size_t len = strlen(text);
+  if (len < 2 || text[0] != '"' || text[len - 1] != '"' ||
+      memchr(text + 1, '\\', len - 2) != NULL) {
+    fail_at(o->beg, "import needs a file name in double quotes, e.g. "
+                    "(import \"prelude.sic\")");
+  }
+
+  const char *slash = strrchr(ctx->srcname, '/');
+  int dir = slash == NULL ? 1 : (int)(slash - ctx->srcname);
+  char path[dir + len];
+  if (text[1] == '/') {
+    snprintf(path, sizeof(path), "%.*s", (int)len - 2, text + 1);
+  } else {
+    snprintf(path, sizeof(path), "%.*s/%.*s", dir,
+             slash == NULL ? "." : ctx->srcname, (int)len - 2, text + 1);
+  }
+  char *real = realpath(path, NULL);
+  if (real == NULL) {
+    fail_at(name->beg, "can't import %s: %s", path, strerror(errno));
+  }
+  size_t first = ctx->modules_len;
+  char canonical[strlen(real) + 1];
+  memcpy(canonical, real, sizeof(canonical));
+  free(real);
+  module_import_path(canonical, o->beg);
+
+  Context *c = ctx;
+  c->imports = CHECK_ALLOC(
+      realloc(c->imports, (c->imports_len + 1) * sizeof(ImportSite)));
+  c->imports[c->imports_len++] = (ImportSite){
+      .pos = o->beg, .first = first, .len = c->modules_len - first};
+}
+
+static ImportSite *import_site(Obj *o) {
+  for (size_t i = 0; i < ctx->imports_len; i++) {
+    Pos pos = ctx->imports[i].pos;
+    if (pos.row == o->beg.row && pos.col == o->beg.col) {
+      return &ctx->imports[i];
+    }
+  }
+  fail_at(o->beg, "import is only allowed at the top level");
+}
+
+static void module_emit(Module *mod, CCode *code) {
+  for (const char *p = mod->c; *p != '\0';) {
+    size_t n = strcspn(p, "\n");
+    if (!code->unmarked || strncmp(p, "#line ", 6) != 0 ||
+        !line_marker_p(p, p)) {
+      ccode_printf_line(code, "%.*s", (int)n, p);
+    }
+    p += n + (p[n] != '\0');
+  }
+}
+
+void transpile_import(Obj *o, CCode *code) {
+  ImportSite *site = import_site(o);
+  for (size_t i = site->first; i < site->first + site->len; i++) {
+    module_emit(ctx->modules[i], code);
+  }
+}
+
+// ==== Headers ====
+// With SicOptions.header a file's C comes with a header for the files
+// compiled separately that call into it: what an import of it would
+// bring in -- prototypes, type definitions, #defines and #includes --
+// and the C of the modules it imports, behind an include guard named
+// for the file. A header carries no #line markers, so an edit that only
+// moves rows, or only changes function bodies, leaves it byte for byte
+// the same, and build tools can tell by comparing it.
+
+static CCode *header_init(void) {
+  CCode *header = ccode_init();
+  header->unmarked = true;
+  return header;
+}
+
+// Nothing calls main, so it is left out.
+static void header_declare(Obj *o, CCode *header) {
+  if (form_is_import(o)) {
+    transpile_statement(o, header);
+  } else if (!(o->tag == SEXP && o->len > 1 && obj_at(o, 1)->tag == ATOM &&
+               strcmp(obj_text(obj_at(o, 1)), "main") == 0)) {
+    module_declare(o, header);
+  }
+}
+
+static void header_finish(const char *decls, size_t len, SicOutput *out) {
+  const char *name = strrchr(ctx->srcname, '/');
+  name = name == NULL ? ctx->srcname : name + 1;
+  size_t name_len = strlen(name);
+  if (name_len > 4 && strcmp(name + name_len - 4, ".sic") == 0) {
+    name_len -= 4;
+  }
+  Buf guard = {0};
+  if (name_len == 0 || isdigit((unsigned char)name[0])) {
+    buf_write(&guard, "_", 1);
+  }
+  for (size_t i = 0; i < name_len; i++) {
+    char ch = isalnum((unsigned char)name[i])
+                  ? (char)toupper((unsigned char)name[i])
+                  : '_';
+    buf_write(&guard, &ch, 1);
+  }
+  buf_write(&guard, "_H\n", 3);
+
+  Buf h = {0};
+  buf_write(&h, "#ifndef ", 8);
+  buf_write(&h, guard.data, guard.len);
+  buf_write(&h, "#define ", 8);
+  buf_write(&h, guard.data, guard.len);
+  if (len > 0) {
+    buf_write(&h, decls, len);
+  }
+  buf_write(&h, "#endif\n", sizeof("#endif\n"));
+  out->h = h.data;
+  out->h_len = h.len - 1;
+  free(guard.data);
+}
+
+// ==== Unity builds ====
+// sic_transpile_unity makes one translation unit of many files, so the
+// C compiler sees -- and can inline -- across what were separate files
+// without LTO. Each file is transpiled in a context of its own, as if
+// alone, into blocks: one per top-level form, and one per module an
+// import brings in. A file that imports another file of the build goes
+// after it, in place of that module's declarations; the rest keep their
+// order, and each starts with a #line naming it. The unit drops a
+// declaration block -- #include, #define, struct, union, enum, typedef
+// -- whose C, #line markers aside, is already in, and a module's
+// declarations after the first time. Every function the build defines
+// is made static, prototypes included, unless it is main or exported.
+// Macros stay per file; names that are static in each of two files
+// collide.
+typedef struct UnityBlock {
+  size_t beg; // bytes [beg, end) of its file's C
+  size_t end;
+  uint64_t key; // of a declaration, to keep it once; 0 to always keep it
+  uint64_t fn;  // hash of the name of the function it declares, or 0
+} UnityBlock;
+
+struct UnityPart {
+  const char *name; // as given
+  char *path;       // canonical
+  char *c;
+  UnityBlock *blocks;
+  size_t len;
+  size_t buffer;
+  size_t *deps; // the parts it imports
+  size_t deps_len;
+  bool placed;
+};
+
+struct Unity {
+  const char *const *paths;   // as given; transpile_unity makes the parts
+  const char *const *exports; // NULL-terminated; may be NULL
+  UnityPart *parts;
+  size_t len;
+  DefTable exported; // name hash -> 1
+  DefTable internal; // likewise, each function to make static
+  DefTable seen;     // keys of the blocks already in
+  Buf out;
+};
+
+static void unity_block(UnityPart *part, UnityBlock block) {
+  if (part->len >= part->buffer) {
+    size_t buffer = part->buffer * 2 + 16;
+    part->blocks =
+        CHECK_ALLOC(realloc(part->blocks, buffer * sizeof(UnityBlock)));
+    part->buffer = buffer;
+  }
+  part->blocks[part->len++] = block;
+}
+
+// What a declaration's C is the same as, whichever file's rows its
+// #line markers carry.
+static uint64_t unity_key(const char *c, size_t len) {
+  uint64_t h = 14695981039346656037u;
+  for (const char *p = c, *end = c + len; p < end;) {
+    const char *next = memchr(p, '\n', (size_t)(end - p));
+    next = next == NULL ? end : next + 1;
+    if (strncmp(p, "#line ", 6) != 0 || !line_marker_p(p, p)) {
+      for (; p < next; p++) {
+        h = (h ^ (unsigned char)*p) * 1099511628211u;
+      }
+    }
+    p = next;
+  }
+  return h == 0 ? 1 : h;
+}
+
+// The modules an import brought in: a part's are left to it, the rest
+// each become a block.
+static void unity_import(Unity *u, UnityPart *part, Obj *o, CCode *code) {
+  ImportSite *site = import_site(o);
+  for (size_t i = site->first; i < site->first + site->len; i++) {
+    Module *mod = ctx->modules[i];
+    size_t dep = 0;
+    while (dep < u->len && strcmp(u->parts[dep].path, mod->path) != 0) {
+      dep++;
+    }
+    if (dep < u->len) {
+      part->deps = CHECK_ALLOC(
+          realloc(part->deps, (part->deps_len + 1) * sizeof(size_t)));
+      part->deps[part->deps_len++] = dep;
+      continue;
+    }
+    size_t first = code->count;
+    module_emit(mod, code);
+    if (code->count > first) {
+      unity_block(part, (UnityBlock){
+                            .beg = code->lines[first],
+                            .end = code->out.len,
+                            .key = text_hash(mod->path, strlen(mod->path)),
+                        });
+    }
+  }
+}
+
+// One file of the build, in its own context.
+static void transpile_unity_part(SrcFile *src, Unity *u, UnityPart *part) {
+  ctx->parser = parser_init(src, &ctx->arena);
+  parser_parse(ctx->parser);
+  Obj *top = ctx->parser->root;
+  expand_toplevel(top, &ctx->arena);
+  CCode *code = ctx->code = ccode_init();
+  for (size_t i = 0; i < top->len; i++) {
+    Obj *o = obj_at(top, i);
+    if (form_is_import(o)) {
+      unity_import(u, part, o, code);
+      continue;
+    }
+    size_t first = code->count;
+    transpile_statement(o, code);
+    if (code->count == first) {
+      continue;
+    }
+    UnityBlock block = {.beg = code->lines[first], .end = code->out.len};
+    int kind = declare_kind(o);
+    if (kind > 0) {
+      block.key = unity_key(code->out.data + block.beg, block.end - block.beg);
+    } else if (kind == 0) {
+      const char *name = obj_text(obj_at(o, 1));
+      block.fn = text_hash(name, strlen(name));
+      if (o->len > 4 && deftable_get(&u->exported, block.fn) == 0) {
+        deftable_put(&u->internal, block.fn, 1);
+      }
+    }
+    unity_block(part, block);
+  }
+  size_t len;
+  part->c = ccode_take(code, &len);
+}
+
+// Appends a part's blocks, after those of the parts it imports.
+static void unity_place(Unity *u, UnityPart *part) {
+  if (part->placed) {
+    return; // imports refuse cycles, so this is only a part already in
+  }
+  part->placed = true;
+  for (size_t i = 0; i < part->deps_len; i++) {
+    unity_place(u, &u->parts[part->deps[i]]);
+  }
+#ifndef DISABLE_LINE
+  buf_write(&u->out, "#line 1 \"", 9);
+  buf_write(&u->out, part->name, strlen(part->name));
+  buf_write(&u->out, "\"\n", 2);
+#endif
+  for (size_t i = 0; i < part->len; i++) {
+    UnityBlock *b = &part->blocks[i];
+    if (b->key != 0) {
+      if (deftable_get(&u->seen, b->key) != 0) {
+        continue;
+      }
+      deftable_put(&u->seen, b->key, 1);
+    }
+    const char *c = part->c + b->beg;
+    size_t at = 0; // where the signature starts, past its #line
+    if (b->fn != 0 && deftable_get(&u->internal, b->fn) != 0) {
+      while (strncmp(c + at, "#line ", 6) == 0 &&
+             line_marker_p(c + at, c + at)) {
+        at += strcspn(c + at, "\n") + 1;
+      }
+      buf_write(&u->out, c, at);
+      if (strncmp(c + at, "static ", 7) != 0 &&
+          strncmp(c + at, "extern ", 7) != 0) {
+        buf_write(&u->out, "static ", 7);
+      }
+    }
+    buf_write(&u->out, c + at, b->end - b->beg - at);
+    buf_write(&u->out, "\n", 1);
+  }
+}
+
+static void transpile_unity(Unity *u, SicOutput *out) {
+  u->parts = CHECK_ALLOC(calloc(u->len + 1, sizeof(UnityPart)));
+  deftable_put(&u->exported, text_hash("main", 4), 1);
+  for (size_t i = 0; u->exports != NULL && u->exports[i] != NULL; i++) {
+    const char *name = u->exports[i];
+    deftable_put(&u->exported, text_hash(name, strlen(name)), 1);
+  }
+  for (size_t i = 0; i < u->len; i++) {
+    UnityPart *part = &u->parts[i];
+    part->name = u->paths[i];
+    part->path = realpath(part->name, NULL);
+    if (part->path == NULL) {
+      fail("Unable to access %s.", part->name);
+    }
+    for (size_t j = 0; j < i; j++) {
+      if (strcmp(u->parts[j].path, part->path) == 0) {
+        fail("%s is in the unity build twice", part->name);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < u->len; i++) {
+    UnityPart *part = &u->parts[i];
+    Context *c = CHECK_ALLOC(sic_init());
+    SicOutput part_out;
+    SicCall call = {.name = part->name,
+                    .path = part->name,
+                    .unity = u,
+                    .part = part,
+                    .out = &part_out};
+    bool ok = sic_run(c, &call);
+    out->tree_peak =
+        part_out.tree_peak > out->tree_peak ? part_out.tree_peak
+                                            : out->tree_peak;
+    if (!ok) {
+      const SicError *e = &c->error;
+      char file[strlen(e->file) + 1];
+      char message[strlen(e->message) + 1];
+      memcpy(file, e->file, sizeof(file));
+      memcpy(message, e->message, sizeof(message));
+      SicError error = {.file = file,
+                        .line = e->line,
+                        .column = e->column,
+                        .message = message};
+      sic_free(c);
+      fail_in(&error);
+    }
+    sic_free(c);
+  }
+
+  for (size_t i = 0; i < u->len; i++) {
+    unity_place(u, &u->parts[i]);
+  }
+  buf_write(&u->out, "", 1);
+  out->c = u->out.data;
+  out->len = u->out.len - 1;
+  u->out = (Buf){0};
+}
+
+// === Library interface ===
+
+// Points this thread's `ctx` and `failure` at `c` for the call, and
+// frees the file's state on the way out whether or not it failed. A
+// failure, even running out of memory while listing the imports, jumps
+// back to the one setjmp; `step` keeps what was done from being redone.
+static bool sic_run(Context *c, SicCall *call) {
+  Context *saved_ctx = ctx;
+  Failure *saved_failure = failure;
+  free(c->srcname);
+  c->srcname = NULL;
+  ctx = c;
+  failure = &c->failure;
+  *call->out = (SicOutput){0};
+  c->mapping = call->options != NULL && call->options->source_map;
+
+  volatile bool ok = false;
+  volatile int step = 0;
+  if (setjmp(c->failure.jump) != 0) {
+    ok = false;
+    c->error = (SicError){.file = c->srcname == NULL ? "" : c->srcname,
+                          .message = failure_message(&c->failure)};
+    if (c->failure.positioned) {
+      c->error.line = c->failure.pos.row + 1;
+      c->error.column = c->failure.pos.col + 1;
+    }
+    if (c->failure.file.len > 0) {
+      c->error.file = c->failure.file.data;
+    }
+    c->imported.len = 0;
+  }
+
+  if (step == 0) {
+    step = 1;
+    c->srcname = CHECK_ALLOC(strdup(call->name));
+    c->error = (SicError){.file = c->srcname};
+    if (call->path != NULL) {
+      call->src = srcfile_init((char *)call->path);
+    } else if (call->text != NULL) {
+      call->src = srcfile_init_text(call->name, call->text, call->text_len);
+    }
+    if (call->options != NULL && call->options->header) {
+      c->header = header_init();
+    }
+    if (call->module != NULL) {
+      transpile_module(call->src, call->module, call->out);
+    } else if (call->part != NULL) {
+      transpile_unity_part(call->src, call->unity, call->part);
+    } else if (call->unity != NULL) {
+      transpile_unity(call->unity, call->out);
+    } else if (call->stream != NULL) {
+      transpile_stream(call->src, call->stream);
+    } else if (call->options != NULL && call->options->incremental) {
+      transpile_incremental(call->src, call->options, call->out);
+    } else {
+      transpile_whole(call->src, call->options, call->out);
+    }
+    ok = true;
+  }
+
+  if (step == 1) {
+    step = 2;
+    c->imported.len = 0;
+    for (size_t i = 0; i < c->modules_len; i++) {
+      const char *path = c->modules[i]->path;
+      buf_write(&c->imported, path, strlen(path));
+      buf_write(&c->imported, "\n", 1);
+    }
+    buf_write(&c->imported, "", 1);
+  }
+
+  if (step == 2) {
+    step = 3;
+    if (c->incremental != NULL) {
+      incremental_finish(c, ok);
+    }
+  }
+  if (call->unity == NULL) {
+    call->out->tree_peak = c->arena.peak;
+    call->out->tree_reserved = c->arena.reserved;
+  }
+  context_reset(c);
+  ctx = saved_ctx;
+  failure = saved_failure;
+  return ok;
+}
+
+SicContext *sic_init(void) { return calloc(1, sizeof(Context)); }
+
+void sic_free(SicContext *c) {
+  context_reset(c);
+  for (size_t i = 0; i < c->caches_len; i++) {
+    form_cache_clear(&c->caches[i]);
+  }
+  free(c->caches);
+  free(c->srcname);
+  free(c->failure.message.data);
+  free(c->failure.file.data);
+  free(c->imported.data);
+  free(c);
+}
+
+bool sic_transpile(SicContext *c, const char *name, const char *text,
+                   size_t len, const SicOptions *options, SicOutput *out) {
+  SicCall call = {.name = name,
+                  .text = text == NULL ? "" : text,
+                  .text_len = len,
+                  .options = options,
+                  .out = out};
+  return sic_run(c, &call);
+}
+
+bool sic_transpile_file(SicContext *c, const char *path,
+                        const SicOptions *options, SicOutput *out) {
+  SicCall call = {.name = strcmp(path, "-") == 0 ? "<stdin>" : path,
+                  .path = path,
+                  .options = options,
+                  .out = out};
+  return sic_run(c, &call);
+}
+
+bool sic_transpile_stream(SicContext *c, const char *path, FILE *stream,
+                          SicOutput *out) {
+  SicCall call = {.name = strcmp(path, "-") == 0 ? "<stdin>" : path,
+                  .path = path,
+                  .stream = stream,
+                  .out = out};
+  return sic_run(c, &call);
+}
+
+bool sic_transpile_unity(SicContext *c, const char *const *paths, size_t len,
+                         const char *const *exports, SicOutput *out) {
+  Unity u = {.paths = paths, .exports = exports, .len = len};
+  SicCall call = {.name = "<unity>", .unity = &u, .out = out};
+  bool ok = sic_run(c, &call);
+  for (size_t i = 0; u.parts != NULL && i < len; i++) {
+    free(u.parts[i].path);
+    free(u.parts[i].c);
+    free(u.parts[i].blocks);
+    free(u.parts[i].deps);
+  }
+  free(u.parts);
+  free(u.exported.keys);
+  free(u.exported.values);
+  free(u.internal.keys);
+  free(u.internal.values);
+  free(u.seen.keys);
+  free(u.seen.values);
+  free(u.out.data);
+  return ok;
+}
+
+const SicError *sic_error(const SicContext *c) { return &c->error; }
+
+const char *sic_imports(const SicContext *c) {
+  return c->imported.len == 0 ? "" : c->imported.data;
+}
@@ -0,0 +1,108 @@
+// libsic: the sic-to-C transpiler as a library. Nothing here exits or
+// prints; every entry point returns false on failure and leaves the
+// reason in sic_error. A context holds no state between calls beyond
+// the last error and, for incremental calls, what it keeps to make the
+// next one cheap, so one context per thread serves any number of files;
+// contexts never share anything.
+#ifndef SIC_H
+#define SIC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct SicContext SicContext;
+
+typedef struct SicOptions {
+  size_t threads; // expand and emit top-level forms on this many threads
+  // Keep each top-level form's C, keyed by the source name, and reuse it
+  // next time for forms whose text is unchanged and whose macros still
+  // mean the same; for editors re-sending a file on every change. The
+  // last 16 names are kept. Forms are done on one thread.
+  bool incremental;
+  // Also generate a header of the file's declarations, for other files
+  // to include: SicOutput.h. Not for sic_transpile_stream.
+  bool header;
+  // Also map the C back to the source: SicOutput.spans.
+  bool source_map;
+} SicOptions;
+
+// A stretch of one line of the C and the node it was generated for:
+// where the node starts, and the byte after it ends. A node a macro's
+// template made spans the whole call; a macro argument keeps its own
+// span. Either way, `call_line` and `call_column` say where the
+// innermost macro call it came from starts, and are 0 for a node no
+// macro made. Lines and columns are 1-based, columns in bytes.
+typedef struct SicSpan {
+  uint32_t c_line;
+  uint32_t c_column;
+  uint32_t c_end; // column after the stretch
+  uint32_t line;
+  uint32_t column;
+  uint32_t end_line;
+  uint32_t end_column;
+  uint32_t call_line;
+  uint32_t call_column;
+} SicSpan;
+
+typedef struct SicOutput {
+  char *c;              // the generated C, '\0'-terminated; free() it
+  size_t len;           // bytes of C, minus the '\0'
+  size_t tree_peak;     // most bytes the syntax tree took at once
+  size_t tree_reserved; // bytes reserved for it at the end
+  size_t worker_peak;   // the -j workers' own trees, summed
+  char *h;              // with SicOptions.header, '\0'-terminated; free() it
+  size_t h_len;         // bytes of header, minus the '\0'
+  // With SicOptions.source_map, in order of the C and not overlapping;
+  // #line marker lines have none. free() it.
+  SicSpan *spans;
+  size_t spans_len;
+} SicOutput;
+
+typedef struct SicError {
+  const char *file;    // the name the input was given
+  uint32_t line;       // 1-based; 0 when the error has no position
+  uint32_t column;     // 1-based
+  const char *message; // without file, position, or "error: "
+} SicError;
+
+// NULL if there is no memory for a context.
+SicContext *sic_init(void);
+void sic_free(SicContext *ctx);
+
+// Transpiles `len` bytes of `text`, which is copied. `name` is what #line
+// directives and errors call the source. `options` may be NULL.
+bool sic_transpile(SicContext *ctx, const char *name, const char *text,
+                   size_t len, const SicOptions *options, SicOutput *out);
+
+// Like sic_transpile, for the file at `path` ("-" for stdin), which is
+// mapped rather than copied when it can be.
+bool sic_transpile_file(SicContext *ctx, const char *path,
+                        const SicOptions *options, SicOutput *out);
+
+// Writes each top-level form to `stream` as soon as it is generated and
+// frees it, so memory stays bounded by the largest form. On failure what
+// was written stays written. Only the statistics in `out` are set.
+bool sic_transpile_stream(SicContext *ctx, const char *path, FILE *stream,
+                          SicOutput *out);
+
+// Transpiles the `len` files at `paths` into one translation unit, each
+// part under its own #line name, a file that another imports first.
+// Shared #includes, type definitions, #defines and modules' declarations
+// appear once, and every function the files define becomes static unless
+// it is main or named in `exports` (NULL-terminated; may be NULL). Only
+// out->c, out->len and out->tree_peak (the largest part's) are set.
+bool sic_transpile_unity(SicContext *ctx, const char *const *paths,
+                         size_t len, const char *const *exports,
+                         SicOutput *out);
+
+// The failure of the last call on `ctx`; valid until the next one.
+const SicError *sic_error(const SicContext *ctx);
+
+// The files the last call on `ctx` imported, directly or through other
+// imports, one canonical path per line; "" if none. Valid until the next
+// call. Compiling a module caches its image in .sic-cache/ beside it.
+const char *sic_imports(const SicContext *ctx);
+
+#endif
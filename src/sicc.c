@@ -1,1806 +1,1621 @@
 #define _POSIX_C_SOURCE 200809L
-
-#include <ctype.h>
-#include <math.h>
-#include <regex.h>
-#include <stdarg.h>
+#define _DEFAULT_SOURCE // realpath
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
+#include <strings.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
-// === Headers & Data Structures ===
-
-typedef enum Tag Tag;
-typedef struct Obj Obj;
-typedef struct SrcFile SrcFile;
-typedef struct Pos Pos;
-typedef struct Parser Parser;
-typedef struct List List;
-typedef struct Atom Atom;
-typedef struct Result Result;
-typedef struct CCode CCode;
-
-struct Pos {
-  size_t row;
-  size_t col;
-};
-
-struct SrcFile {
-  char *name;
-  FILE *fp;
-  bool eof;
-  Pos pos;
-};
-
-struct CCode {
-  char **lines;
-  size_t count;
-  size_t buffer;
-};
-
-enum Tag {
-  SEXP,
-  ATOM,
-};
-
-struct List {
-  Obj **buffer;
-  size_t buffer_len;
-  size_t len;
-};
-
-List *list_init();
-void list_resize(List *, size_t);
-void list_add(List *, Obj *);
-void list_free(List *);
-void list_print(List *, size_t indent);
-
-struct Atom {
-  char *buffer;
-  size_t buffer_len;
-  size_t len;
-};
-
-Atom *atom_init();
-void atom_resize(Atom *, size_t);
-void atom_add(Atom *, char);
-void atom_free(Atom *);
-void atom_print(Atom *);
-
-struct Result {
-  enum { OK, Err } tag;
-};
-
-struct Obj {
-  Pos beg;
-  Pos end;
-
-  Tag tag;
-  union {
-    Atom *atom;
-    List *sexp;
-  };
-};
-
-Obj *obj_init(Tag tag);
-void obj_free(Obj *obj);
-void obj_print(Obj *obj);
-
-struct Parser {
-  List *list;
-  SrcFile *srcfile;
-};
-
-typedef enum RuleContext {
-  EXPRESSION = 1 << 0,
-  STATEMENT = 1 << 1,
-} RuleContext;
-
-typedef struct TRule {
-  char *match;
-  void (*fn)(Obj *o, CCode *code);
-  RuleContext ctx;
-} TRule;
-
-void transpile_obj(Obj *o, CCode *code, RuleContext ctx);
-void transpile_return(Obj *o, CCode *code);
-void transpile_include(Obj *o, CCode *code);
-void transpile_fn(Obj *o, CCode *code);
-void transpile_call(Obj *o, CCode *code);
-void transpile_binary_op(Obj *o, CCode *code);
-void transpile_deref(Obj *o, CCode *code);
-void transpile_decl(Obj *o, CCode *code);
-void transpile_set(Obj *o, CCode *code);
-void transpile_while(Obj *o, CCode *code);
-void transpile_cast(Obj *o, CCode *code);
-void transpile_op_assign(Obj *o, CCode *code);
-void transpile_statement(Obj *o, CCode *code);
-void transpile_expression(Obj *o, CCode *code);
-void transpile_condition(Obj *o, CCode *code);
-void transpile_for(Obj *o, CCode *code);
-void transpile_if(Obj *o, CCode *code);
-void transpile_do(Obj *o, CCode *code);
-void transpile_ternary(Obj *o, CCode *code);
-void transpile_incdec(Obj *o, CCode *code);
-void transpile_aref(Obj *o, CCode *code);
-void transpile_member(Obj *o, CCode *code);
-void transpile_sizeof(Obj *o, CCode *code);
-void transpile_struct(Obj *o, CCode *code);
-void transpile_enum(Obj *o, CCode *code);
-void transpile_typedef(Obj *o, CCode *code);
-void transpile_switch(Obj *o, CCode *code);
-void transpile_init(Obj *o, CCode *code);
-void transpile_define(Obj *o, CCode *code);
-void transpile_undef(Obj *o, CCode *code);
-void transpile_guard(Obj *o, CCode *code);
-void transpile_hash_else(Obj *o, CCode *code);
-void transpile_pragma(Obj *o, CCode *code);
-void transpile_typeop(Obj *o, CCode *code);
-void transpile_do_while(Obj *o, CCode *code);
-void transpile_goto(Obj *o, CCode *code);
-void transpile_launch(Obj *o, CCode *code);
-
-// === Implementations ===
-
-// ==== Utilities ====
-#define CHECK_ALLOC(ptr)                                                       \
-  ({                                                                           \
-    void *_tmp_ptr = (ptr);                                                    \
-    if (_tmp_ptr == NULL) {                                                    \
-      fprintf(stderr,                                                          \
-              "error: " __FILE__ ":%d "                                        \
-              "Couldn't allocate memory! Exiting.",                            \
-              __LINE__);                                                       \
-      exit(1);                                                                 \
-    }                                                                          \
-    _tmp_ptr;                                                                  \
-  })
-
-#define X(msg, ...)                                                            \
-  do {                                                                         \
-    time_t t = time(NULL);                                                     \
-    struct tm *tm_info = localtime(&t);                                        \
-    char time_buf[20];                                                         \
-    strftime(time_buf, 20, "%Y-%m-%d %H:%M:%S", tm_info);                      \
-    fprintf(stderr, "[%s] %s:%d: " msg "\n", time_buf, __FILE__, __LINE__,     \
-            ##__VA_ARGS__);                                                    \
-    fflush(stderr);                                                            \
-  } while (0)
-
-static const char *sic_srcname = "<input>";
-
-_Noreturn static void fail_at(Pos pos, const char *fmt, ...) {
-  fprintf(stderr, "%s:%zu:%zu: error: ", sic_srcname, pos.row + 1,
-          pos.col + 1);
-  va_list args;
-  va_start(args, fmt);
-  vfprintf(stderr, fmt, args);
-  va_end(args);
-  fprintf(stderr, "\n");
+#include "sic.h"
+
+// The command-line driver over libsic: argument handling, reading and
+// writing files, and printing what went wrong.
+
+extern char **environ;
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "Usage: %s [--stats] [--stream | -j N] <file to transpile, or -> "
+          "[output file]\n"
+          "       %s [--stats] [-j N] [--header] [--source-map] "
+          "<file to transpile, or -> <output file>\n"
+          "       %s [--stats] [-j N] [--header] --out-dir DIR "
+          "<file to transpile>...\n"
+          "       %s [--stats] [--export NAME]... --unity OUTPUT "
+          "<file to transpile>...\n"
+          "       %s --server\n"
+          "       %s --watch DIR [--header] [--out-dir DIR]\n"
+          "       %s build [-j N] [-o OUTPUT] [--cache DIR] "
+          "<file to build>...\n"
+          "       %s run [--cache DIR] <file to run> [argument]...\n",
+          argv0, argv0, argv0, argv0, argv0, argv0, argv0, argv0);
   exit(EXIT_FAILURE);
 }
 
-// ==== Source files ====
-
-SrcFile *srcfile_init(char *name) {
-  FILE *fp = fopen(name, "r");
-  if (fp == NULL) {
-    return NULL;
-  }
-
-  SrcFile *srcfile = CHECK_ALLOC(calloc(1, sizeof(SrcFile)));
-
-  size_t namelen = strnlen(name, FILENAME_MAX);
-  srcfile->name = CHECK_ALLOC(malloc((namelen + 1) * sizeof(char)));
-
-  memcpy(srcfile->name, name, namelen);
-  srcfile->name[namelen] = '\0';
-
-  srcfile->pos.row = 0;
-  srcfile->pos.col = 0;
-
-  srcfile->fp = fp;
-  srcfile->eof = false;
-
-  return srcfile;
-}
-
-void srcfile_free(SrcFile *srcfile) {
-  free(srcfile->name);
-  fclose(srcfile->fp);
-  free(srcfile);
-}
-
-int srcfile_peek(SrcFile *srcfile) {
-  int ch = fgetc(srcfile->fp);
-  if (ch != EOF) {
-    ungetc(ch, srcfile->fp);
-  }
-  return ch;
-}
-
-int srcfile_getc(SrcFile *srcfile) {
-  int ch = fgetc(srcfile->fp);
-  srcfile->pos.col++;
-  if (ch == '\n') {
-    srcfile->pos.row++;
-    srcfile->pos.col = 0;
-  } else if (ch == EOF) {
-    srcfile->eof = true;
-  }
-
-  return ch;
-}
-
-bool srcfile_finished_p(SrcFile *srcfile) { return srcfile->eof; }
-
-// ==== Objects ====
-
-Obj *obj_init(Tag tag) {
-  Obj *obj = CHECK_ALLOC(calloc(sizeof(Obj), 1));
-  obj->tag = tag;
-  switch (tag) {
-  case SEXP:
-    obj->sexp = list_init();
-    break;
-  case ATOM:
-    obj->atom = atom_init();
-    break;
-  }
-  return obj;
-}
-
-void obj_free(Obj *obj) {
-  switch (obj->tag) {
-  case SEXP:
-    list_free(obj->sexp);
-    break;
-  case ATOM:
-    atom_free(obj->atom);
-    break;
-  };
-
-  free(obj);
-}
-
-void obj_print(Obj *obj) {
-  switch (obj->tag) {
-  case SEXP:
-    printf("SEXP: (");
-    for (size_t i = 0; i < obj->sexp->len; i++) {
-      if (i > 0)
-        printf(" ");
-      switch (obj->sexp->buffer[i]->tag) {
-      case ATOM:
-        printf("%s", obj->sexp->buffer[i]->atom->buffer);
-        break;
-      case SEXP:
-        printf("[%zu]", obj->sexp->buffer[i]->sexp->len);
-        break;
-      }
-    }
-    printf(") [%zu]\n", obj->sexp->len);
-    break;
-  case ATOM:
-    printf("ATOM: %s\n", obj->atom->buffer);
-    break;
+static void *build_alloc(void *p) {
+  if (p == NULL) {
+    fprintf(stderr, "error: Couldn't allocate memory! Exiting.\n");
+    exit(EXIT_FAILURE);
   }
+  return p;
 }
 
-// ==== List handling ====
-
-List *list_init() {
-  List *list = CHECK_ALLOC(malloc(sizeof(List)));
-  list->len = 0;
-  list->buffer = NULL;
-  list->buffer_len = 0;
-  return list;
-}
-
-void list_resize(List *l, size_t buffer_len) {
-  if (l->buffer != NULL) {
-    l->buffer = CHECK_ALLOC(realloc(l->buffer, buffer_len * sizeof(Obj *)));
-  } else {
-    l->buffer = CHECK_ALLOC(malloc(buffer_len * sizeof(Obj *)));
+// The N of `-j N` or `-jN` at argv[*argi], which is left on its last word.
+static long parse_jobs(char **argv, int *argi) {
+  const char *n = argv[*argi][2] != '\0' ? argv[*argi] + 2 : argv[++*argi];
+  char *end = NULL;
+  long threads = n == NULL ? 0 : strtol(n, &end, 10);
+  if (threads < 1 || *end != '\0') {
+    usage(argv[0]);
   }
-  l->buffer_len = buffer_len;
+  return threads;
 }
 
-void list_add(List *list, Obj *obj) {
-  if (list->len >= list->buffer_len) {
-    size_t new_size = list->buffer_len == 0 ? 8 : list->buffer_len * 2;
-    list_resize(list, new_size);
+static void report_error(const SicError *error) {
+  flockfile(stderr);
+  if (error->line > 0) {
+    fprintf(stderr, "%s:%" PRIu32 ":%" PRIu32 ": ", error->file, error->line,
+            error->column);
   }
-
-  list->buffer[list->len++] = obj;
+  fprintf(stderr, "error: %s\n", error->message);
+  funlockfile(stderr);
 }
 
-void list_free(List *l) {
-  for (size_t i = 0; i < l->len; i++) {
-    obj_free(l->buffer[i]);
+static void report_stats(const char *name, const SicOutput *out) {
+  flockfile(stderr);
+  fprintf(stderr, "sicc: %s: tree arena peak %zu bytes (%zu reserved)\n",
+          name, out->tree_peak, out->tree_reserved);
+  if (out->worker_peak > 0) {
+    fprintf(stderr, "sicc: %s: worker arenas peak %zu bytes in total\n",
+            name, out->worker_peak);
   }
-  free(l->buffer);
-  free(l);
+  funlockfile(stderr);
 }
 
-void list_print(List *l, size_t indent) {
-  if (l->len == 0) {
-    return;
+// NULL, with the error printed, if `output` can't be written.
+static FILE *open_output(const char *output) {
+  if (output == NULL) {
+    return stdout;
   }
-
-  size_t num_width = 1 + (size_t)log10(l->len);
-  char formatstr[100];
-  snprintf(formatstr, 100, "%%%zus%%%zuzu: %%s [%%zu, %%zu] -> [%%zu, %%zu]\n",
-           indent, num_width);
-
-  for (size_t i = 0; i < l->len; i++) {
-    Obj *o = l->buffer[i];
-    switch (o->tag) {
-    case SEXP:
-      printf(formatstr, "", i, "(", o->beg.row, o->beg.col, o->end.row,
-             o->end.col);
-      list_print(o->sexp, indent + 2);
-      printf(formatstr, "", i, ")", o->beg.row, o->beg.col, o->end.row,
-             o->end.col);
-      break;
-    case ATOM:
-      printf(formatstr, "", i, o->atom->buffer, o->beg.row, o->beg.col,
-             o->end.row, o->end.col);
-      break;
-    }
+  FILE *fp = fopen(output, "w");
+  if (fp == NULL) {
+    fprintf(stderr, "error: Unable to open %s for writing.\n", output);
   }
+  return fp;
 }
 
-// ==== Atom ====
-
-Atom *atom_init() {
-  Atom *atom = CHECK_ALLOC(malloc(sizeof(Atom)));
-  atom->buffer = NULL;
-  atom->buffer_len = 0;
-  atom->len = 0;
-  return atom;
-}
+static bool write_changed(const char *path, const char *data, size_t len);
+static void json_string(FILE *fp, const char *text, size_t len);
+static void json_spans(FILE *fp, const SicSpan *spans, size_t len);
 
-void atom_resize(Atom *a, size_t buffer_len) {
-  if (a->buffer != NULL) {
-    a->buffer = CHECK_ALLOC(realloc(a->buffer, buffer_len * sizeof(char)));
-  } else {
-    a->buffer = CHECK_ALLOC(malloc(buffer_len * sizeof(char)));
+// --header: OUTPUT with its .c or .cu swapped for .h.
+static char *header_output(const char *output) {
+  size_t n = strlen(output);
+  if (n > 2 && strcmp(output + n - 2, ".c") == 0) {
+    n -= 2;
+  } else if (n > 3 && strcmp(output + n - 3, ".cu") == 0) {
+    n -= 3;
   }
-  a->buffer_len = buffer_len;
-}
-
-void atom_add(Atom *atom, char ch) {
-  if (atom->len >= atom->buffer_len) {
-    size_t new_size = atom->buffer_len == 0 ? 8 : atom->buffer_len * 2;
-    atom_resize(atom, new_size);
+  char *path = malloc(n + 3);
+  if (path == NULL) {
+    fprintf(stderr, "error: Couldn't allocate memory! Exiting.\n");
+    exit(EXIT_FAILURE);
   }
-  atom->buffer[atom->len++] = ch;
-}
-
-void atom_free(Atom *a) {
-  free(a->buffer);
-  free(a);
-}
-
-void atom_print(Atom *a) {
-  for (size_t i = 0; i < a->len; i++)
-    printf("%c", a->buffer[i]);
-}
-
-// ==== Parser ====
-
-void parser_next(Parser *parser, List *container, Atom *atom, Obj *parent) {
-  int ch;
-
-  while ((ch = srcfile_peek(parser->srcfile)) != EOF) {
-    Obj *o = NULL;
-
-#ifdef DEBUG
-    printf("%c", ch);
-#endif
-
-    if (atom != NULL) {
-      bool finished = false;
-      if (atom->len > 0 &&
-          (atom->buffer[0] == '"' || atom->buffer[0] == '\'')) {
-        if (ch == atom->buffer[0]) {
-          size_t escapes = 0;
-          size_t idx = atom->len;
-          while (idx > 1 && atom->buffer[idx - 1] == '\\') {
-            escapes++;
-            idx--;
-          }
-          if ((escapes & 1) == 0) {
-            atom_add(atom, srcfile_getc(parser->srcfile));
-            finished = true;
-          }
-        }
-      } else if (isspace(ch) || ch == ')' || ch == ';') {
-        finished = true;
-      }
-
-      if (finished) {
-        atom_add(atom, '\0');
-        return;
-      }
-
-      atom_add(atom, srcfile_getc(parser->srcfile));
-    } else {
-      if (isspace(ch)) {
-        srcfile_getc(parser->srcfile);
-        continue;
-      }
-
-      if (ch == ';') {
-        while (ch != EOF && ch != '\n') {
-          ch = srcfile_getc(parser->srcfile);
-        }
-        continue;
-      }
-
-      if (ch == ')') {
-        if (parent == NULL) {
-          fail_at(parser->srcfile->pos, "unmatched ')'");
-        }
-        srcfile_getc(parser->srcfile);
-        return;
-      }
-
-      if (ch == '(') {
-        o = obj_init(SEXP);
-        o->beg = parser->srcfile->pos;
-        list_add(container, o);
-        srcfile_getc(parser->srcfile);
-        parser_next(parser, o->sexp, NULL, o);
-        o->end = parser->srcfile->pos;
-        continue;
-      }
-
-      o = obj_init(ATOM);
-      o->beg = parser->srcfile->pos;
-      list_add(container, o);
-      parser_next(parser, container, o->atom, parent);
-      o->end = parser->srcfile->pos;
-    }
+  memcpy(path, output, n);
+  memcpy(path + n, ".h", 3);
+  return path;
+}
+
+// --source-map: OUTPUT.map, JSON
+//   {"file": "INPUT", "spans": [[c_line, c_column, c_end, line, column,
+//                                end_line, end_column, call_line,
+//                                call_column], ...]}
+// one SicSpan each, in order of the C, so a position in either file is
+// found by bisecting.
+static bool write_source_map(const char *input, const char *output,
+                             const SicOutput *out) {
+  size_t n = strlen(output);
+  char *path = malloc(n + 5);
+  if (path == NULL) {
+    fprintf(stderr, "error: Couldn't allocate memory! Exiting.\n");
+    exit(EXIT_FAILURE);
   }
-
-  if (atom != NULL) {
-    if (atom->len > 0 && (atom->buffer[0] == '"' || atom->buffer[0] == '\'')) {
-      fail_at(parser->srcfile->pos, "unterminated %s literal",
-              atom->buffer[0] == '"' ? "string" : "character");
+  memcpy(path, output, n);
+  memcpy(path + n, ".map", 5);
+  FILE *fp = open_output(path);
+  free(path);
+  if (fp == NULL) {
+    return false;
+  }
+  fputs("{\"file\": ", fp);
+  json_string(fp, input, strlen(input));
+  fputs(", \"spans\": ", fp);
+  json_spans(fp, out->spans, out->spans_len);
+  fputs("}\n", fp);
+  fclose(fp);
+  return true;
+}
+
+// Transpiles `input` whole, and only then writes `output` (stdout when
+// NULL), so a failure leaves no partial file. With `header`, the header
+// goes beside `output`, and is only rewritten when it changes, so what
+// includes it isn't rebuilt for an edit that didn't touch it. With
+// `source_map`, so does the source map.
+static bool transpile_file(SicContext *sic, const char *input,
+                           const char *output, size_t threads, bool stats,
+                           bool header, bool source_map) {
+  SicOptions options = {
+      .threads = threads, .header = header, .source_map = source_map};
+  SicOutput out;
+  bool ok = sic_transpile_file(sic, input, &options, &out);
+  if (stats) {
+    report_stats(strcmp(input, "-") == 0 ? "<stdin>" : input, &out);
+  }
+  if (!ok) {
+    report_error(sic_error(sic));
+    return false;
+  }
+
+  FILE *fp = open_output(output);
+  if (fp != NULL) {
+    fwrite(out.c, 1, out.len, fp);
+    if (fp != stdout) {
+      fclose(fp);
     }
-    atom_add(atom, '\0');
-  } else if (parent != NULL) {
-    fail_at(parent->beg, "unclosed '('");
   }
-
-  srcfile_getc(parser->srcfile);
-}
-
-void parser_parse(Parser *parser) {
-  if (parser->srcfile == NULL) {
-    fprintf(stderr, "error: Unable to access file.\n");
+  ok = fp != NULL;
+  if (ok && header) {
+    char *path = header_output(output);
+    ok = write_changed(path, out.h, out.h_len);
+    free(path);
+  }
+  if (ok && source_map) {
+    ok = write_source_map(input, output, &out);
+  }
+  free(out.c);
+  free(out.h);
+  free(out.spans);
+  return ok;
+}
+
+// --out-dir: every input is transpiled whole to DIR/<name>.c
+// (DIR/<name>.cu for .cu.sic). `threads` workers, each with its own
+// context, claim the inputs in order, one file at a time each. A file
+// that fails is reported under its own name and leaves no output; the
+// rest carry on.
+typedef struct Batch {
+  char **inputs;
+  char **outputs;
+  size_t len;
+  bool stats;
+  bool header;
+  size_t next;   // the next input to claim, taken with an atomic add
+  size_t failed; // counted with an atomic add
+} Batch;
+
+static char *batch_output(const char *dir, const char *input) {
+  const char *base = strrchr(input, '/');
+  base = base == NULL ? input : base + 1;
+  size_t n = strlen(base);
+  if (n > 4 && strcmp(base + n - 4, ".sic") == 0) {
+    n -= 4;
+  }
+  bool cu = n > 3 && strncmp(base + n - 3, ".cu", 3) == 0;
+  size_t len = strlen(dir) + n + 4;
+  char *path = malloc(len);
+  if (path == NULL) {
+    fprintf(stderr, "error: Couldn't allocate memory! Exiting.\n");
     exit(EXIT_FAILURE);
   }
-
-  parser_next(parser, parser->list, NULL, NULL);
-}
-
-void parser_print(Parser *parser) {
-  if (parser->list == NULL) {
-    printf("(NULL)\n");
-    return;
-  }
-
-  printf("=== %s ===\n", parser->srcfile->name);
-  list_print(parser->list, 0);
+  snprintf(path, len, "%s/%.*s%s", dir, (int)n, base, cu ? "" : ".c");
+  return path;
 }
 
-Parser *parser_init(char *filename) {
-  Parser *parser = CHECK_ALLOC(malloc(sizeof(Parser)));
-  parser->srcfile = srcfile_init(filename);
-  parser->list = list_init();
-  return parser;
+static int compare_strings(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
 }
 
-void parser_free(Parser *parser) {
-  srcfile_free(parser->srcfile);
-  list_free(parser->list);
-  free(parser);
-}
-
-// === Macro expansion ===
-
-typedef struct Macro {
-  char *name;    // borrowed from def
-  List *params;  // borrowed from def; atoms, last may end in "..."
-  bool has_rest;
-  Obj *template; // borrowed from def
-  Obj *def;      // owns the whole defmacro form
-} Macro;
-
-static Macro *macros = NULL;
-static size_t macros_len = 0;
-static size_t macros_buffer = 0;
-static size_t gensym_counter = 0;
-
-#define MACRO_MAX_DEPTH 200
-
-static Macro *macro_find(const char *name) {
-  for (size_t i = 0; i < macros_len; i++) {
-    if (strcmp(macros[i].name, name) == 0) {
-      return &macros[i];
+static void *batch_worker(void *arg) {
+  Batch *b = arg;
+  SicContext *sic = build_alloc(sic_init());
+  for (;;) {
+    size_t i = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED);
+    if (i >= b->len) {
+      break;
+    }
+    if (!transpile_file(sic, b->inputs[i], b->outputs[i], 1, b->stats,
+                        b->header, false)) {
+      __atomic_fetch_add(&b->failed, 1, __ATOMIC_RELAXED);
     }
   }
+  sic_free(sic);
   return NULL;
 }
 
-static bool macro_param_is_rest(const char *name) {
-  size_t n = strlen(name);
-  return n > 3 && strcmp(name + n - 3, "...") == 0;
-}
-
-static void macro_register(Obj *o) {
-  if (o->sexp->len != 4 || o->sexp->buffer[1]->tag != ATOM ||
-      o->sexp->buffer[2]->tag != SEXP) {
-    fail_at(o->beg, "defmacro needs a name, a parameter list, and one "
-                    "template form, e.g. (defmacro twice (x) (do x x))");
+static int transpile_batch(char **inputs, size_t len, const char *dir,
+                           size_t threads, bool stats, bool header) {
+  Batch b = {.inputs = inputs,
+             .outputs = calloc(len, sizeof(char *)),
+             .len = len,
+             .stats = stats,
+             .header = header};
+  char **sorted = malloc(len * sizeof(char *));
+  pthread_t *workers = calloc(threads, sizeof(pthread_t));
+  if (b.outputs == NULL || sorted == NULL || workers == NULL) {
+    fprintf(stderr, "error: Couldn't allocate memory! Exiting.\n");
+    exit(EXIT_FAILURE);
   }
-
-  char *name = o->sexp->buffer[1]->atom->buffer;
-  if (macro_find(name) != NULL) {
-    fail_at(o->sexp->buffer[1]->beg, "macro '%s' is already defined", name);
+  for (size_t i = 0; i < len; i++) {
+    b.outputs[i] = batch_output(dir, inputs[i]);
   }
-
-  List *params = o->sexp->buffer[2]->sexp;
-  bool has_rest = false;
-  for (size_t i = 0; i < params->len; i++) {
-    Obj *p = params->buffer[i];
-    if (p->tag != ATOM) {
-      fail_at(p->beg, "macro parameters must be plain atoms");
-    }
-    if (macro_param_is_rest(p->atom->buffer)) {
-      if (i != params->len - 1) {
-        fail_at(p->beg, "only the last macro parameter may end in '...'");
-      }
-      has_rest = true;
+  memcpy(sorted, b.outputs, len * sizeof(char *));
+  qsort(sorted, len, sizeof(char *), compare_strings);
+  for (size_t i = 1; i < len; i++) {
+    if (strcmp(sorted[i - 1], sorted[i]) == 0) {
+      fprintf(stderr, "error: two inputs would both write %s\n", sorted[i]);
+      exit(EXIT_FAILURE);
     }
   }
+  free(sorted);
 
-  if (macros_len >= macros_buffer) {
-    macros_buffer = macros_buffer == 0 ? 8 : macros_buffer * 2;
-    macros = CHECK_ALLOC(realloc(macros, macros_buffer * sizeof(Macro)));
-  }
-  macros[macros_len++] = (Macro){.name = name,
-                                 .params = params,
-                                 .has_rest = has_rest,
-                                 .template = o->sexp->buffer[3],
-                                 .def = o};
-}
-
-static void macros_free(void) {
-  for (size_t i = 0; i < macros_len; i++) {
-    obj_free(macros[i].def);
-  }
-  free(macros);
-  macros = NULL;
-  macros_len = macros_buffer = 0;
-}
-
-// Expanded code is stamped with the call site's position, so diagnostics
-// and #line directives point at the user's code, not the template.
-static Obj *obj_clone(Obj *o, Pos pos) {
-  Obj *c = obj_init(o->tag);
-  c->beg = pos;
-  c->end = pos;
-  switch (o->tag) {
-  case ATOM:
-    for (size_t i = 0; i < o->atom->len; i++) {
-      atom_add(c->atom, o->atom->buffer[i]);
-    }
-    break;
-  case SEXP:
-    for (size_t i = 0; i < o->sexp->len; i++) {
-      list_add(c->sexp, obj_clone(o->sexp->buffer[i], pos));
+  threads = threads < len ? threads : len;
+  for (size_t i = 0; i < threads; i++) {
+    if (pthread_create(&workers[i], NULL, batch_worker, &b) != 0) {
+      fprintf(stderr, "error: couldn't start worker thread\n");
+      exit(EXIT_FAILURE);
     }
-    break;
   }
-  return c;
-}
-
-static Obj *obj_atom_new(const char *text, Pos pos) {
-  Obj *o = obj_init(ATOM);
-  o->beg = pos;
-  o->end = pos;
-  do {
-    atom_add(o->atom, *text);
-  } while (*text++ != '\0');
-  return o;
-}
-
-// Template atoms ending in '#' (e.g. tmp#) rename to a fresh identifier,
-// shared within one expansion, unique across expansions.
-typedef struct Gensyms {
-  char **names;   // template spellings, e.g. "tmp#"
-  char **uniques; // generated names, e.g. "tmp__3"
-  size_t len;
-  size_t buffer;
-} Gensyms;
-
-static bool atom_is_gensym(const char *name) {
-  size_t n = strlen(name);
-  return n >= 2 && name[n - 1] == '#';
-}
-
-static const char *gensym_lookup(Gensyms *g, const char *name) {
-  for (size_t i = 0; i < g->len; i++) {
-    if (strcmp(g->names[i], name) == 0) {
-      return g->uniques[i];
-    }
+  for (size_t i = 0; i < threads; i++) {
+    pthread_join(workers[i], NULL);
   }
 
-  if (g->len >= g->buffer) {
-    g->buffer = g->buffer == 0 ? 4 : g->buffer * 2;
-    g->names = CHECK_ALLOC(realloc(g->names, g->buffer * sizeof(char *)));
-    g->uniques = CHECK_ALLOC(realloc(g->uniques, g->buffer * sizeof(char *)));
+  for (size_t i = 0; i < len; i++) {
+    free(b.outputs[i]);
   }
-
-  size_t n = strlen(name);
-  char *uniq = CHECK_ALLOC(malloc(n + 32));
-  snprintf(uniq, n + 32, "%.*s__%zu", (int)(n - 1), name, gensym_counter++);
-  g->names[g->len] = CHECK_ALLOC(strdup(name));
-  g->uniques[g->len] = uniq;
-  g->len++;
-  return uniq;
+  free(b.outputs);
+  free(workers);
+  return b.failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-static void gensyms_free(Gensyms *g) {
-  for (size_t i = 0; i < g->len; i++) {
-    free(g->names[i]);
-    free(g->uniques[i]);
+// --unity OUTPUT: the inputs as one translation unit (sic_transpile_unity),
+// written once it is all done. --export NAME keeps a function extern.
+static int transpile_unity(char **inputs, size_t len, const char *output,
+                           char **exports, bool stats) {
+  SicContext *sic = build_alloc(sic_init());
+  SicOutput out;
+  bool ok = sic_transpile_unity(sic, (const char *const *)inputs, len,
+                                (const char *const *)exports, &out);
+  if (stats) {
+    report_stats(output, &out);
   }
-  free(g->names);
-  free(g->uniques);
-}
-
-static Obj *macro_substitute(Obj *t, Macro *m, Obj *call, Gensyms *gensyms) {
-  Pos pos = call->beg;
-
-  if (t->tag == ATOM) {
-    char *text = t->atom->buffer;
-    for (size_t i = 0; i < m->params->len; i++) {
-      char *param = m->params->buffer[i]->atom->buffer;
-      if (strcmp(text, param) != 0) {
-        continue;
-      }
-      if (m->has_rest && i == m->params->len - 1) {
-        fail_at(pos,
-                "rest parameter '%s' of macro '%s' can only be spliced "
-                "inside a form",
-                param, m->name);
-      }
-      return obj_clone(call->sexp->buffer[i + 1], pos);
+  if (!ok) {
+    report_error(sic_error(sic));
+  } else {
+    FILE *fp = open_output(output);
+    if (fp != NULL) {
+      fwrite(out.c, 1, out.len, fp);
+      fclose(fp);
     }
-    if (atom_is_gensym(text)) {
-      return obj_atom_new(gensym_lookup(gensyms, text), pos);
+    ok = fp != NULL;
+    free(out.c);
+  }
+  sic_free(sic);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// --server: transpiles source text sent on stdin, one request after
+// another, in a single process that keeps each source's forms between
+// requests (SicOptions.incremental). Frames are LSP-style: headers, a
+// blank line, then Content-Length bytes of body.
+//
+//   request:  Content-Length: N, optional Source-Name: NAME (what #line
+//             and errors call the source); body is the source text
+//   reply:    Content-Length: N; body is JSON
+//             {"ok": true, "c": "...", "map": [...], "spans": [...],
+//              "diagnostics": []}
+//
+// `map` has one entry per line of `c` (split on '\n'): [L, "FILE"], the
+// 1-based sic line the C line came from and the file it is a line of,
+// per the #line markers, or [0, ""] before the first. FILE is an
+// imported module's for what the import brought in. `spans` are the
+// SicSpans, as in --source-map, down to the column. On failure "c" is
+// null, "map" and "spans" empty, and each diagnostic is
+// {"file": "FILE", "line": L, "column": C, "message": "..."} (line 0:
+// no position), FILE being the module's for an error in an import.
+// Exits when stdin closes.
+
+static void json_string(FILE *fp, const char *text, size_t len) {
+  fputc('"', fp);
+  for (size_t i = 0; i < len; i++) {
+    unsigned char c = (unsigned char)text[i];
+    if (c == '"' || c == '\\') {
+      fprintf(fp, "\\%c", c);
+    } else if (c == '\n') {
+      fputs("\\n", fp);
+    } else if (c == '\t') {
+      fputs("\\t", fp);
+    } else if (c < 0x20) {
+      fprintf(fp, "\\u%04x", c);
+    } else {
+      fputc(c, fp);
     }
-    return obj_clone(t, pos);
-  }
-
-  Obj *out = obj_init(SEXP);
-  out->beg = pos;
-  out->end = pos;
-  for (size_t i = 0; i < t->sexp->len; i++) {
-    Obj *child = t->sexp->buffer[i];
-    bool splice = child->tag == ATOM && m->has_rest &&
-                  strcmp(child->atom->buffer,
-                         m->params->buffer[m->params->len - 1]->atom->buffer) ==
-                      0;
-    if (splice) {
-      for (size_t j = m->params->len; j < call->sexp->len; j++) {
-        list_add(out->sexp, obj_clone(call->sexp->buffer[j], pos));
+  }
+  fputc('"', fp);
+}
+
+static void json_spans(FILE *fp, const SicSpan *spans, size_t len) {
+  fputc('[', fp);
+  for (size_t i = 0; i < len; i++) {
+    const SicSpan *s = &spans[i];
+    fprintf(fp,
+            "%s[%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32
+            ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 "]",
+            i == 0 ? "" : ",", s->c_line, s->c_column, s->c_end, s->line,
+            s->column, s->end_line, s->end_column, s->call_line,
+            s->call_column);
+  }
+  fputc(']', fp);
+}
+
+static void server_map(FILE *fp, const char *c, size_t len) {
+  unsigned long line = 0;
+  const char *file = "";
+  size_t file_len = 0;
+  fputc('[', fp);
+  for (size_t i = 0;; i++) {
+    if (strncmp(c + i, "#line ", 6) == 0) {
+      char *end;
+      line = strtoul(c + i + 6, &end, 10);
+      if (strncmp(end, " \"", 2) == 0) {
+        file = end + 2;
+        file_len = strcspn(file, "\"\n");
       }
-      continue;
     }
-    list_add(out->sexp, macro_substitute(child, m, call, gensyms));
-  }
-  return out;
-}
-
-static Obj *macro_expand_call(Macro *m, Obj *call) {
-  size_t fixed = m->params->len - (m->has_rest ? 1 : 0);
-  size_t given = call->sexp->len - 1;
-  if (given < fixed || (!m->has_rest && given > fixed)) {
-    fail_at(call->beg, "macro '%s' takes %s%zu argument%s, got %zu", m->name,
-            m->has_rest ? "at least " : "", fixed, fixed == 1 ? "" : "s",
-            given);
-  }
-
-  Gensyms gensyms = {0};
-  Obj *result = macro_substitute(m->template, m, call, &gensyms);
-  gensyms_free(&gensyms);
-  return result;
-}
-
-// Outermost-first: keep expanding the head until it is no longer a macro,
-// then recurse into children. Macro invocations look like calls — a form
-// whose head atom names a macro; bare atoms never expand.
-static Obj *expand_obj(Obj *o, size_t depth) {
-  while (o->tag == SEXP && o->sexp->len > 0 &&
-         o->sexp->buffer[0]->tag == ATOM) {
-    char *head = o->sexp->buffer[0]->atom->buffer;
-    if (strcmp(head, "defmacro") == 0) {
-      fail_at(o->beg, "defmacro is only allowed at the top level");
+    fprintf(fp, "%s[%lu,", i == 0 ? "" : ",", line);
+    json_string(fp, file, file_len);
+    fputc(']', fp);
+    const char *next = memchr(c + i, '\n', len - i);
+    if (next == NULL) {
+      break;
     }
-
-    Macro *m = macro_find(head);
-    if (m == NULL) {
+    i = (size_t)(next - c);
+  }
+  fputc(']', fp);
+}
+
+// False at the end of input. `name` is set from Source-Name, or NULL.
+static bool server_read(char **text, size_t *len, char **name) {
+  char *line = NULL;
+  size_t cap = 0;
+  ssize_t n;
+  long length = -1;
+  bool blank = false;
+  free(*name);
+  *name = NULL;
+  while ((n = getline(&line, &cap, stdin)) > 0) {
+    while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r')) {
+      line[--n] = '\0';
+    }
+    if (n == 0) {
+      blank = true;
       break;
     }
-    if (depth++ >= MACRO_MAX_DEPTH) {
-      fail_at(o->beg,
-              "macro expansion nested deeper than %d levels; is '%s' "
-              "recursive?",
-              MACRO_MAX_DEPTH, head);
+    if (strncasecmp(line, "Content-Length:", 15) == 0) {
+      length = strtol(line + 15, NULL, 10);
+    } else if (strncasecmp(line, "Source-Name:", 12) == 0) {
+      const char *value = line + 12 + strspn(line + 12, " ");
+      free(*name);
+      *name = strdup(value);
     }
-
-    Obj *expanded = macro_expand_call(m, o);
-    obj_free(o);
-    o = expanded;
   }
-
-  if (o->tag == SEXP) {
-    for (size_t i = 0; i < o->sexp->len; i++) {
-      o->sexp->buffer[i] = expand_obj(o->sexp->buffer[i], depth);
+  free(line);
+  if (!blank || length < 0) {
+    return false;
+  }
+  *len = (size_t)length;
+  *text = malloc(*len + 1);
+  return *text != NULL && fread(*text, 1, *len, stdin) == *len;
+}
+
+static int serve(void) {
+  SicContext *sic = build_alloc(sic_init());
+  SicOptions options = {.incremental = true, .source_map = true};
+  char *text = NULL;
+  size_t len = 0;
+  char *name = NULL;
+  while (server_read(&text, &len, &name)) {
+    char *body = NULL;
+    size_t body_len = 0;
+    FILE *fp = open_memstream(&body, &body_len);
+    if (fp == NULL) {
+      fprintf(stderr, "error: Couldn't allocate memory! Exiting.\n");
+      exit(EXIT_FAILURE);
     }
-  }
-  return o;
-}
-
-// Consumes defmacro forms (definitions must precede uses) and expands
-// everything else in place.
-void expand_toplevel(List *top) {
-  size_t kept = 0;
-  for (size_t i = 0; i < top->len; i++) {
-    Obj *o = top->buffer[i];
-    if (o->tag == SEXP && o->sexp->len > 0 &&
-        o->sexp->buffer[0]->tag == ATOM &&
-        strcmp(o->sexp->buffer[0]->atom->buffer, "defmacro") == 0) {
-      macro_register(o);
-      continue;
+    SicOutput out;
+    if (sic_transpile(sic, name == NULL ? "<input>" : name, text, len,
+                      &options, &out)) {
+      fputs("{\"ok\": true, \"c\": ", fp);
+      json_string(fp, out.c, out.len);
+      fputs(", \"map\": ", fp);
+      server_map(fp, out.c, out.len);
+      fputs(", \"spans\": ", fp);
+      json_spans(fp, out.spans, out.spans_len);
+      fputs(", \"diagnostics\": []}", fp);
+      free(out.c);
+      free(out.spans);
+    } else {
+      const SicError *error = sic_error(sic);
+      fputs("{\"ok\": false, \"c\": null, \"map\": [], \"spans\": [], "
+            "\"diagnostics\": [{\"file\": ",
+            fp);
+      json_string(fp, error->file, strlen(error->file));
+      fprintf(fp,
+              ", \"line\": %" PRIu32 ", \"column\": %" PRIu32
+              ", \"message\": ",
+              error->line, error->column);
+      json_string(fp, error->message, strlen(error->message));
+      fputs("}]}", fp);
     }
-    top->buffer[kept++] = expand_obj(o, 0);
-  }
-  top->len = kept;
-}
-
-// === Output behavior ===
-
-CCode *ccode_init() {
-  CCode *code = CHECK_ALLOC(malloc(sizeof(CCode)));
-  code->lines = NULL;
-  code->buffer = 0;
-  code->count = 0;
-  return code;
-}
-
-void ccode_free(CCode *code) {
-  for (size_t i = 0; i < code->count; i++) {
-    free(code->lines[i]);
-  }
-  free(code->lines);
-  free(code);
-}
-
-void ccode_resize(CCode *code, size_t size) {
-  if (code->lines == NULL) {
-    code->lines = CHECK_ALLOC(calloc(size, sizeof(char *)));
-  } else {
-    code->lines = CHECK_ALLOC(realloc(code->lines, sizeof(char *) * size));
-  }
-
-  code->buffer = size;
-}
-
-char *ccode_alloc_line(CCode *code, size_t size) {
-  if (code->count >= code->buffer) {
-    ccode_resize(code, code->buffer == 0 ? 8 : code->buffer * 2);
-  }
-
-  char *line = CHECK_ALLOC(malloc(sizeof(char) * size));
-  code->lines[code->count++] = line;
-  return line;
-}
-
-char *ccode_printf_line(CCode *code, const char *format, ...) {
-  va_list args;
-  va_start(args, format);
-  va_list size_args;
-  va_copy(size_args, args);
-  int result = vsnprintf(NULL, 0, format, size_args);
-  va_end(size_args);
-  if (result < 0) {
-    va_end(args);
-    fprintf(stderr, "internal error: couldn't format generated C\n");
-    exit(EXIT_FAILURE);
-  }
-
-  size_t size = (size_t)result;
-  char *line = ccode_alloc_line(code, size + 1);
-  vsnprintf(line, size + 1, format, args);
-  va_end(args);
-
-  return line;
-}
-
-void ccode_append(CCode *code, const char *format, ...) {
-  if (code->count == 0) {
-    ccode_printf_line(code, "");
-  }
-
-  va_list args;
-  va_start(args, format);
-  va_list size_args;
-  va_copy(size_args, args);
-  int result = vsnprintf(NULL, 0, format, size_args);
-  va_end(size_args);
-  if (result < 0) {
-    va_end(args);
-    fprintf(stderr, "internal error: couldn't format generated C\n");
-    exit(EXIT_FAILURE);
+    fclose(fp);
+    printf("Content-Length: %zu\r\n\r\n", body_len);
+    fwrite(body, 1, body_len, stdout);
+    fflush(stdout);
+    free(body);
+    free(text);
+    text = NULL;
+  }
+  free(text);
+  free(name);
+  sic_free(sic);
+  return EXIT_SUCCESS;
+}
+
+// sicc build: transpiles, compiles and links .sic files into one program,
+// skipping whatever a content-addressed cache already holds. An input's
+// key hashes the sicc executable, the working directory, $CC, $CFLAGS,
+// the input's name and its bytes; the cache keeps <key>.c, <key>.o and
+// <key>.deps, which lists each header the compile read (from cc -MD),
+// and each module the transpile imported, with a hash of its contents.
+// An input whose object exists and whose headers all hash as listed is
+// neither transpiled nor compiled; one whose C exists is not transpiled,
+// unless it imports modules, whose C is only good while they don't
+// change. `threads` workers claim inputs in
+// order and run one cc each. The link is skipped when the output exists
+// and the objects' keys and headers, $LDFLAGS and $LDLIBS hash as they
+// did for the last link of that output.
+
+#define HEADER_BUCKETS 4096
+
+typedef struct Unit {
+  const char *input;
+  uint64_t key; // names <key>.c and <key>.deps
+  uint64_t id;  // the key and its headers' paths and hashes; names <id>.o
+  char *imports; // the modules its transpile imported, one per line
+} Unit;
+
+// Headers are hashed once per build, however many inputs include them.
+typedef struct Header {
+  char *path;
+  uint64_t hash;
+  bool ok; // readable
+  struct Header *next;
+} Header;
+
+typedef struct Build {
+  Unit *units;
+  size_t len;
+  const char *cache;
+  uint64_t base; // the sicc executable, working directory, $CC and $CFLAGS
+  char **cc;     // $CC and $CFLAGS, one word each
+  size_t cc_len;
+  size_t next;   // the next unit to claim, taken with an atomic add
+  size_t failed; // counted with an atomic add
+  pthread_mutex_t lock; // guards headers
+  Header *headers[HEADER_BUCKETS];
+} Build;
+
+// FNV-1a, continuing from `hash`, taken a word at a time rather than a
+// byte: `sicc run` hashes every header a script includes on each start.
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t len) {
+  const unsigned char *p = data;
+  for (; len >= 8; p += 8, len -= 8) {
+    uint64_t word;
+    memcpy(&word, p, 8);
+    hash = (hash ^ word) * 0x100000001b3ULL;
+  }
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ p[i]) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// The string with its '\0', so that "ab","c" and "a","bc" differ.
+static uint64_t hash_string(uint64_t hash, const char *s) {
+  return hash_bytes(hash, s == NULL ? "" : s, s == NULL ? 1 : strlen(s) + 1);
+}
+
+// NULL if `path` can't be read.
+static char *read_file(const char *path, size_t *len) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
   }
-
-  size_t size = (size_t)result;
-  char *last = code->lines[code->count - 1];
-  size_t cur = strlen(last);
-  last = CHECK_ALLOC(realloc(last, cur + size + 1));
-
-  vsnprintf(last + cur, size + 1, format, args);
-  va_end(args);
-
-  code->lines[code->count - 1] = last;
-}
-
-void ccode_mark_line(CCode *code, Obj *o) {
-#ifndef DISABLE_LINE
-  ccode_printf_line(code, "#line %zu \"%s\"", o->beg.row + 1, sic_srcname);
-#endif
-}
-
-void ccode_write(CCode *code, FILE *stream) {
-  for (size_t i = 0; i < code->count; i++) {
-    fprintf(stream, "%s\n", code->lines[i]);
+  struct stat st;
+  char *data = NULL;
+  if (fstat(fd, &st) == 0) {
+    data = build_alloc(malloc((size_t)st.st_size + 1));
+    size_t done = 0;
+    ssize_t n;
+    while (done < (size_t)st.st_size &&
+           (n = read(fd, data + done, (size_t)st.st_size - done)) > 0) {
+      done += (size_t)n;
+    }
+    if (done < (size_t)st.st_size) {
+      free(data);
+      data = NULL;
+    } else {
+      data[done] = '\0';
+      *len = done;
+    }
   }
+  close(fd);
+  return data;
 }
 
-// === Transpiler ===
-// Feeling this out, will need to be dramatically rewritten
-
-// ":const-char*" becomes a malloc'd "const char*"; hyphens are illegal in
-// C type names so the mapping is unambiguous. Translation stops at '[' to
-// leave array-size expressions alone.
-char *type_to_c(const char *atom) {
-  char *type = CHECK_ALLOC(strdup(atom + 1));
-  for (char *p = type; *p != '\0' && *p != '['; p++) {
-    if (*p == '-') {
-      *p = ' ';
+static bool hash_file(uint64_t hash, const char *path, uint64_t *out) {
+  size_t len;
+  char *data = read_file(path, &len);
+  if (data == NULL) {
+    return false;
+  }
+  *out = hash_bytes(hash, data, len);
+  free(data);
+  return true;
+}
+
+static bool header_hash(Build *b, const char *path, uint64_t *out) {
+  size_t bucket = hash_string(0xcbf29ce484222325ULL, path) % HEADER_BUCKETS;
+  pthread_mutex_lock(&b->lock);
+  Header *h = b->headers[bucket];
+  while (h != NULL && strcmp(h->path, path) != 0) {
+    h = h->next;
+  }
+  if (h == NULL) {
+    h = build_alloc(calloc(1, sizeof(Header)));
+    h->path = build_alloc(strdup(path));
+    h->ok = hash_file(0xcbf29ce484222325ULL, path, &h->hash);
+    h->next = b->headers[bucket];
+    b->headers[bucket] = h;
+  }
+  pthread_mutex_unlock(&b->lock);
+  *out = h->hash;
+  return h->ok;
+}
+
+// Appends `word`, which `words` then owns, keeping the array
+// NULL-terminated.
+static void add_word(char ***words, size_t *len, char *word) {
+  *words = build_alloc(realloc(*words, (*len + 2) * sizeof(char *)));
+  (*words)[(*len)++] = build_alloc(word);
+  (*words)[*len] = NULL;
+}
+
+// Appends the whitespace-separated words of `text` (may be NULL).
+static void split_words(const char *text, char ***words, size_t *len) {
+  while (text != NULL && *text != '\0') {
+    text += strspn(text, " \t\n");
+    size_t n = strcspn(text, " \t\n");
+    if (n > 0) {
+      add_word(words, len, strndup(text, n));
     }
+    text += n;
   }
-  return type;
 }
 
-// Appends "type name" with any array suffix moved after the name, as C
-// declarators want: (x :int[4]) becomes "int x[4]".
-void ccode_append_declarator(CCode *code, const char *type_atom,
-                             const char *name) {
-  char *type = type_to_c(type_atom);
-  char *bits = strchr(type, ':');
-  if (bits != NULL) {
-    ccode_append(code, "%.*s %s : %s", (int)(bits - type), type, name,
-                 bits + 1);
-    free(type);
-    return;
-  }
-
-  char *arr = strchr(type, '[');
-  if (arr == NULL) {
-    arr = type + strlen(type);
+static void free_words(char **words, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    free(words[i]);
   }
-  ccode_append(code, "%.*s %s%s", (int)(arr - type), type, name, arr);
-  free(type);
+  free(words);
 }
 
-// Like ccode_append_declarator, but the type may also be a
-// (fnptr :ret (:argtypes...)) form, emitted as "ret (*name)(args)".
-void ccode_append_declarator_obj(CCode *code, Obj *type, const char *name) {
-  if (type->tag == ATOM && type->atom->buffer[0] == ':') {
-    ccode_append_declarator(code, type->atom->buffer, name);
-    return;
-  }
-
-  if (type->tag == SEXP && type->sexp->len == 3 &&
-      type->sexp->buffer[0]->tag == ATOM &&
-      strcmp(type->sexp->buffer[0]->atom->buffer, "fnptr") == 0 &&
-      type->sexp->buffer[1]->tag == ATOM &&
-      type->sexp->buffer[1]->atom->buffer[0] == ':' &&
-      type->sexp->buffer[2]->tag == SEXP) {
-    char *ret = type_to_c(type->sexp->buffer[1]->atom->buffer);
-    ccode_append(code, "%s (*%s)(", ret, name);
-    free(ret);
-
-    List *args = type->sexp->buffer[2]->sexp;
-    if (args->len == 0) {
-      ccode_append(code, "void");
+// Runs `argv`, with its output going where ours does; true if it exits 0.
+// `len` bytes of `input` are its stdin, or ours when `input` is NULL.
+static bool run(char **argv, const char *input, size_t len) {
+  pid_t pid;
+  int status;
+  int fds[2];
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  if (input != NULL) {
+    if (pipe(fds) != 0) {
+      fprintf(stderr, "error: couldn't make a pipe: %s\n", strerror(errno));
+      return false;
     }
-    for (size_t i = 0; i < args->len; i++) {
-      Obj *arg = args->buffer[i];
-      if (arg->tag != ATOM || arg->atom->buffer[0] != ':') {
-        fail_at(arg->beg, "fnptr argument types must be :type atoms");
+    posix_spawn_file_actions_adddup2(&actions, fds[0], STDIN_FILENO);
+    posix_spawn_file_actions_addclose(&actions, fds[0]);
+    posix_spawn_file_actions_addclose(&actions, fds[1]);
+  }
+  int err = posix_spawnp(&pid, argv[0], &actions, NULL, argv, environ);
+  posix_spawn_file_actions_destroy(&actions);
+  if (input != NULL) {
+    close(fds[0]);
+    // A compiler that stops reading early is an EPIPE here (SIGPIPE is
+    // ignored), and its exit status says why.
+    for (size_t done = 0; err == 0 && done < len;) {
+      ssize_t n = write(fds[1], input + done, len - done);
+      if (n < 0 && errno != EINTR) {
+        break;
       }
-      char *arg_type = type_to_c(arg->atom->buffer);
-      ccode_append(code, "%s%s", i == 0 ? "" : ", ", arg_type);
-      free(arg_type);
+      done += n < 0 ? 0 : (size_t)n;
     }
-    ccode_append(code, ")");
-    return;
+    close(fds[1]);
   }
-
-  fail_at(type->beg, "expected a :type or (fnptr :ret (:argtypes...))");
-}
-
-static const TRule TRANSPILE_RULES[] = {
-    {"^#include$", transpile_include, STATEMENT},
-    {"^#define$", transpile_define, STATEMENT},
-    {"^#undef$", transpile_undef, STATEMENT},
-    {"^#(ifdef|ifndef|if)$", transpile_guard, STATEMENT},
-    {"^#else$", transpile_hash_else, STATEMENT},
-    {"^#pragma$", transpile_pragma, STATEMENT},
-    {"^fn$", transpile_fn, STATEMENT},
-    {"^return$", transpile_return, STATEMENT},
-    {"^([-+*/%&|^]=|<<=|>>=)$", transpile_op_assign, EXPRESSION},
-    {"^(\\+\\+|--)$", transpile_incdec, EXPRESSION},
-    {"^(\\+|-|\\*|/|%|<|>|<=|>=|==|!=|&&|\\|\\||&|\\||\\^|<<|>>|!|~|,)$",
-     transpile_binary_op, EXPRESSION},
-    {"^deref$", transpile_deref, EXPRESSION},
-    {"^aref$", transpile_aref, EXPRESSION},
-    {"^(->|\\.)$", transpile_member, EXPRESSION},
-    {"^decl$", transpile_decl, STATEMENT},
-    {"^set$", transpile_set, EXPRESSION},
-    {"^while$", transpile_while, STATEMENT},
-    {"^for$", transpile_for, STATEMENT},
-    {"^if$", transpile_if, STATEMENT},
-    {"^do$", transpile_do, STATEMENT},
-    {"^\\?:$", transpile_ternary, EXPRESSION},
-    {"^sizeof$", transpile_sizeof, EXPRESSION},
-    {"^init$", transpile_init, EXPRESSION},
-    {"^(offsetof|alignof)$", transpile_typeop, EXPRESSION},
-    {"^switch$", transpile_switch, STATEMENT},
-    {"^do-while$", transpile_do_while, STATEMENT},
-    {"^(goto|label)$", transpile_goto, STATEMENT},
-    {"^launch$", transpile_launch, EXPRESSION},
-    {"^(struct|union)$", transpile_struct, STATEMENT},
-    {"^enum$", transpile_enum, STATEMENT},
-    {"^typedef$", transpile_typedef, STATEMENT},
-    {"^:.*$", transpile_cast, EXPRESSION},
-    {".*", transpile_call, EXPRESSION},
-};
-#define TRANSPILE_RULE_LEN (sizeof(TRANSPILE_RULES) / sizeof(TRule))
-
-// The first rule whose regex matches the head decides what a form is.
-// Every lookup goes through here, so the table stays the one place that
-// says which head means which rule.
-static const TRule *rule_for(const char *head) {
-  static regex_t TRANSPILE_REGEXES[TRANSPILE_RULE_LEN];
-  static bool initialized = false;
-  if (!initialized) {
-    for (size_t i = 0; i < TRANSPILE_RULE_LEN; i++) {
-#ifdef DEBUG
-      printf("REGEX: %s\n", TRANSPILE_RULES[i].match);
-#endif
-      if (regcomp(&TRANSPILE_REGEXES[i], TRANSPILE_RULES[i].match,
-                  REG_EXTENDED | REG_NOSUB) != 0) {
-        fprintf(stderr, "internal error: bad rule regex '%s'\n",
-                TRANSPILE_RULES[i].match);
-        exit(EXIT_FAILURE);
-      }
+  if (err != 0) {
+    fprintf(stderr, "error: couldn't run %s: %s\n", argv[0], strerror(err));
+    return false;
+  }
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR) {
+      return false;
     }
-    initialized = true;
   }
-
-  for (size_t i = 0; i < TRANSPILE_RULE_LEN; i++) {
-    if (regexec(&TRANSPILE_REGEXES[i], head, 0, NULL, 0) != REG_NOMATCH) {
-      return &TRANSPILE_RULES[i];
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static char *cache_path(const Build *b, uint64_t key, const char *ext) {
+  size_t len = strlen(b->cache) + strlen(ext) + 18;
+  char *path = build_alloc(malloc(len));
+  snprintf(path, len, "%s/%016" PRIx64 "%s", b->cache, key, ext);
+  return path;
+}
+
+// `path` + ".<pid>.tmp": written first and renamed into place, so neither
+// a failed write nor another sicc building into the same cache ever sees
+// half a file.
+static char *temp_path(const char *path) {
+  size_t len = strlen(path) + 32;
+  char *tmp = build_alloc(malloc(len));
+  snprintf(tmp, len, "%s.%ld.tmp", path, (long)getpid());
+  return tmp;
+}
+
+static bool write_file(const char *path, const char *data, size_t len) {
+  char *tmp = temp_path(path);
+  FILE *fp = fopen(tmp, "w");
+  bool ok = fp != NULL && fwrite(data, 1, len, fp) == len;
+  if (fp != NULL && fclose(fp) != 0) {
+    ok = false;
+  }
+  if (ok && rename(tmp, path) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    fprintf(stderr, "error: Unable to write %s.\n", path);
+    remove(tmp);
+  }
+  free(tmp);
+  return ok;
+}
+
+// write_file, unless `path` already holds exactly `data`: its mtime is
+// left alone for make and the like.
+static bool write_changed(const char *path, const char *data, size_t len) {
+  size_t old_len;
+  char *old = read_file(path, &old_len);
+  bool same = old != NULL && old_len == len && memcmp(old, data, len) == 0;
+  free(old);
+  return same || write_file(path, data, len);
+}
+
+// Sets `id` from the headers `deps` lists, one path per line, as they
+// are now; false if one can't be read.
+static bool unit_id(Build *b, Unit *u, const char *deps) {
+  u->id = u->key;
+  for (const char *line = deps; *line != '\0';) {
+    size_t n = strcspn(line, "\n");
+    char *path = build_alloc(strndup(line, n));
+    uint64_t hash;
+    bool ok = header_hash(b, path, &hash);
+    free(path);
+    if (!ok) {
+      return false;
     }
+    u->id = hash_bytes(u->id, line, n + 1);
+    u->id = hash_bytes(u->id, &hash, sizeof(hash));
+    line += n + (line[n] != '\0');
   }
-  return NULL;
+  return true;
 }
 
-// `parens` is false only where the caller already emits the pair C
-// requires, so the operator doesn't add a second, redundant one.
-static void binary_op_emit(Obj *o, CCode *code, bool parens) {
-  char *op = o->sexp->buffer[0]->atom->buffer;
-  bool prefix_ok = op[1] == '\0' && strchr("+-*&!~", op[0]) != NULL;
-  bool prefix_only = op[1] == '\0' && (op[0] == '!' || op[0] == '~');
-  bool comparison = strcmp(op, "<") == 0 || strcmp(op, ">") == 0 ||
-                    strcmp(op, "<=") == 0 || strcmp(op, ">=") == 0 ||
-                    strcmp(op, "==") == 0 || strcmp(op, "!=") == 0;
-
-  if (o->sexp->len == 2 && prefix_ok) {
-    if (parens) {
-      ccode_append(code, "(");
+// The headers of `cfile` from the make rule `cc -MD` left in `dfile`, one
+// path per line, then the unit's imports, written to `<key>.deps` and
+// hashed into `id`.
+static bool deps_write(Build *b, Unit *u, const char *dfile,
+                       const char *cfile) {
+  size_t len;
+  char *rule = read_file(dfile, &len);
+  if (rule == NULL) {
+    fprintf(stderr, "error: %s: cc left no dependencies\n", u->input);
+    return false;
+  }
+  const char *imports = u->imports == NULL ? "" : u->imports;
+  char *deps = build_alloc(malloc(len + strlen(imports) + 1));
+  size_t deps_len = 0;
+  char *p = strchr(rule, ':');
+  p = p == NULL ? rule + len : p + 1;
+  while (*p != '\0') {
+    size_t start = deps_len;
+    for (; *p != '\0' && *p != ' ' && *p != '\t' && *p != '\n'; p++) {
+      if (p[0] == '\\' && p[1] == '\n') {
+        break;
+      }
+      if ((p[0] == '\\' && p[1] == ' ') || (p[0] == '$' && p[1] == '$')) {
+        p++;
+      }
+      deps[deps_len++] = *p;
     }
-    ccode_append(code, "%s", op);
-    transpile_expression(o->sexp->buffer[1], code);
-    if (parens) {
-      ccode_append(code, ")");
+    deps[deps_len] = '\0';
+    if (deps_len == start || strcmp(deps + start, cfile) == 0) {
+      deps_len = start;
+    } else {
+      deps[deps_len++] = '\n';
     }
-    return;
-  }
-
-  if (prefix_only) {
-    fail_at(o->beg, "operator '%s' takes exactly one operand", op);
-  }
-  if (comparison && o->sexp->len != 3) {
-    fail_at(o->beg, "comparison operator '%s' takes exactly two operands", op);
-  }
-  if (o->sexp->len < 3) {
-    fail_at(o->beg, "operator '%s' needs at least two operands", op);
-  }
-
-  if (parens) {
-    ccode_append(code, "(");
-  }
-  for (size_t i = 1; i < o->sexp->len; i++) {
-    if (i != 1) {
-      ccode_append(code, " %s ", op);
+    p += *p == '\\' ? 2 : *p != '\0';
+  }
+  strcpy(deps + deps_len, imports);
+  deps_len += strlen(imports);
+  char *path = cache_path(b, u->key, ".deps");
+  bool ok = unit_id(b, u, deps) && write_file(path, deps, deps_len);
+  free(path);
+  free(deps);
+  free(rule);
+  return ok;
+}
+
+// Compiles `cfile` to `<id>.o`, learning `id` from the headers it read.
+static bool compile_unit(Build *b, Unit *u, const char *cfile) {
+  // Quoted #includes are looked up next to the .sic, not in the cache.
+  const char *slash = strrchr(u->input, '/');
+  char *dir = slash == NULL ? strdup(".")
+              : slash == u->input
+                  ? strdup("/")
+                  : strndup(u->input, (size_t)(slash - u->input));
+  char *path = cache_path(b, u->key, ".o");
+  char *otmp = temp_path(path);
+  free(path);
+  path = cache_path(b, u->key, ".d");
+  char *dfile = temp_path(path);
+  free(path);
+  char **argv = NULL;
+  size_t argc = 0;
+  for (size_t i = 0; i < b->cc_len; i++) {
+    add_word(&argv, &argc, strdup(b->cc[i]));
+  }
+  split_words("-iquote", &argv, &argc);
+  add_word(&argv, &argc, dir);
+  split_words("-MD -MF", &argv, &argc);
+  add_word(&argv, &argc, strdup(dfile));
+  split_words("-c -o", &argv, &argc);
+  add_word(&argv, &argc, strdup(otmp));
+  add_word(&argv, &argc, strdup(cfile));
+  bool ok = run(argv, NULL, 0) && deps_write(b, u, dfile, cfile);
+  if (ok) {
+    char *object = cache_path(b, u->id, ".o");
+    ok = rename(otmp, object) == 0;
+    free(object);
+  }
+  if (!ok) {
+    fprintf(stderr, "error: %s: compilation failed\n", u->input);
+    remove(otmp);
+  }
+  remove(dfile);
+  free_words(argv, argc);
+  free(dfile);
+  free(otmp);
+  return ok;
+}
+
+// Keeps what `sic` imported for the unit's dependencies.
+static void unit_imports(Unit *u, SicContext *sic) {
+  const char *imports = sic_imports(sic);
+  u->imports = *imports == '\0' ? NULL : build_alloc(strdup(imports));
+}
+
+static bool transpile_cached(SicContext *sic, Unit *u, const char *cfile) {
+  SicOutput out;
+  if (!sic_transpile_file(sic, u->input, NULL, &out)) {
+    report_error(sic_error(sic));
+    return false;
+  }
+  unit_imports(u, sic);
+  bool ok = write_file(cfile, out.c, out.len);
+  free(out.c);
+  return ok;
+}
+
+// True if `<key>.deps` exists and the object (`ext` ".o") or program
+// ("") for its headers as they are now is already in the cache.
+static bool unit_cached(Build *b, Unit *u, const char *ext) {
+  char *path = cache_path(b, u->key, ".deps");
+  size_t len;
+  char *deps = read_file(path, &len);
+  free(path);
+  bool cached = deps != NULL && unit_id(b, u, deps);
+  if (cached) {
+    char *object = cache_path(b, u->id, ext);
+    cached = access(object, F_OK) == 0;
+    free(object);
+  }
+  free(deps);
+  return cached;
+}
+
+// Brings `<id>.o` up to date, transpiling and compiling only what the
+// cache lacks.
+static bool build_unit(Build *b, SicContext *sic, Unit *u) {
+  if (unit_cached(b, u, ".o")) {
+    return true;
+  }
+  char *cfile = cache_path(b, u->key, ".c");
+  bool ok = (access(cfile, F_OK) == 0 || transpile_cached(sic, u, cfile)) &&
+            compile_unit(b, u, cfile);
+  if (u->imports != NULL) {
+    remove(cfile);
+  }
+  free(cfile);
+  return ok;
+}
+
+static void *build_worker(void *arg) {
+  Build *b = arg;
+  SicContext *sic = build_alloc(sic_init());
+  for (;;) {
+    size_t i = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED);
+    if (i >= b->len) {
+      break;
     }
-    transpile_expression(o->sexp->buffer[i], code);
-  }
-  if (parens) {
-    ccode_append(code, ")");
-  }
-}
-
-void transpile_binary_op(Obj *o, CCode *code) { binary_op_emit(o, code, true); }
-
-// if/while/do-while already wrap the condition in the parens C requires,
-// so an operator form there would emit a second pair. Beyond being noise,
-// clang reads the doubled pair in if ((a == b)) as a typo'd assignment
-// and warns (-Wparentheses-equality).
-void transpile_condition(Obj *o, CCode *code) {
-  if (o->tag == SEXP && o->sexp->len > 0 && o->sexp->buffer[0]->tag == ATOM) {
-    const TRule *rule = rule_for(o->sexp->buffer[0]->atom->buffer);
-    if (rule != NULL && rule->fn == transpile_binary_op) {
-      binary_op_emit(o, code, false);
-      return;
+    if (!build_unit(b, sic, &b->units[i])) {
+      __atomic_fetch_add(&b->failed, 1, __ATOMIC_RELAXED);
     }
   }
-  transpile_expression(o, code);
-}
-
-void transpile_incdec(Obj *o, CCode *code) {
-  if (o->sexp->len != 2) {
-    fail_at(o->beg, "'%s' takes exactly one operand",
-            o->sexp->buffer[0]->atom->buffer);
-  }
-
-  ccode_append(code, "(%s", o->sexp->buffer[0]->atom->buffer);
-  transpile_expression(o->sexp->buffer[1], code);
-  ccode_append(code, ")");
-}
-
-void transpile_decl(Obj *o, CCode *code) {
-  if ((o->sexp->len != 3 && o->sexp->len != 4) ||
-      o->sexp->buffer[1]->tag != ATOM) {
-    fail_at(o->beg, "decl needs a name and a :type, with at most one "
-                    "initializer, e.g. (decl x :int 1)");
-  }
-
-  ccode_mark_line(code, o);
-  ccode_printf_line(code, "");
-  ccode_append_declarator_obj(code, o->sexp->buffer[2],
-                              o->sexp->buffer[1]->atom->buffer);
-  if (o->sexp->len > 3) {
-    ccode_append(code, " = ");
-    transpile_expression(o->sexp->buffer[3], code);
-  }
-  ccode_append(code, ";");
+  sic_free(sic);
+  return NULL;
 }
 
-void transpile_set(Obj *o, CCode *code) {
-  if (o->sexp->len != 3) {
-    fail_at(o->beg, "set needs a place and a value, e.g. (set x 1)");
-  }
-
-  ccode_append(code, "(");
-  transpile_expression(o->sexp->buffer[1], code);
-  ccode_append(code, " = ");
-  transpile_expression(o->sexp->buffer[2], code);
-  ccode_append(code, ")");
-};
-
-// Postfix operators bind tighter than the prefix forms a base expression
-// may end with, so anything but a plain atom gets wrapped in parens.
-void transpile_postfix_base(Obj *o, CCode *code) {
-  if (o->tag == ATOM) {
-    transpile_expression(o, code);
-  } else {
-    ccode_append(code, "(");
-    transpile_expression(o, code);
-    ccode_append(code, ")");
+// Hashes the running sicc's file identity -- device, inode, size and
+// mtime -- so rebuilding it invalidates the cache without it being read
+// on every `sicc run`. Where it can't be found, the time this file was
+// compiled stands in.
+static uint64_t sicc_hash(void) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  struct stat st;
+  if (stat("/proc/self/exe", &st) != 0) {
+    return hash_string(hash, __DATE__ " " __TIME__);
   }
+  uint64_t id[] = {(uint64_t)st.st_dev, (uint64_t)st.st_ino,
+                   (uint64_t)st.st_size, (uint64_t)st.st_mtim.tv_sec,
+                   (uint64_t)st.st_mtim.tv_nsec};
+  return hash_bytes(hash, id, sizeof(id));
 }
 
-void transpile_aref(Obj *o, CCode *code) {
-  if (o->sexp->len < 3) {
-    fail_at(o->beg, "aref needs an array and at least one index");
-  }
-
-  transpile_postfix_base(o->sexp->buffer[1], code);
-  for (size_t i = 2; i < o->sexp->len; i++) {
-    ccode_append(code, "[");
-    transpile_expression(o->sexp->buffer[i], code);
-    ccode_append(code, "]");
+// $CC (or cc) and $CFLAGS, split into words.
+static void build_compiler(Build *b) {
+  split_words(getenv("CC"), &b->cc, &b->cc_len);
+  if (b->cc_len == 0) {
+    split_words("cc", &b->cc, &b->cc_len);
   }
+  split_words(getenv("CFLAGS"), &b->cc, &b->cc_len);
 }
 
-void transpile_member(Obj *o, CCode *code) {
-  char *op = o->sexp->buffer[0]->atom->buffer;
-  if (o->sexp->len < 3) {
-    fail_at(o->beg, "'%s' needs a struct and a field", op);
-  }
-
-  transpile_postfix_base(o->sexp->buffer[1], code);
-  for (size_t i = 2; i < o->sexp->len; i++) {
-    Obj *field = o->sexp->buffer[i];
-    if (field->tag != ATOM) {
-      fail_at(field->beg, "field names must be plain atoms");
+static void build_free(Build *b) {
+  for (size_t i = 0; i < HEADER_BUCKETS; i++) {
+    for (Header *h = b->headers[i], *next; h != NULL; h = next) {
+      next = h->next;
+      free(h->path);
+      free(h);
     }
-    ccode_append(code, "%s%s", op, field->atom->buffer);
   }
-}
-
-void transpile_while(Obj *o, CCode *code) {
-  if (o->sexp->len < 2) {
-    fail_at(o->beg, "while needs a condition");
+  free_words(b->cc, b->cc_len);
+  for (size_t i = 0; i < b->len; i++) {
+    free(b->units[i].imports);
   }
-
-  ccode_mark_line(code, o);
-  ccode_printf_line(code, "while (");
-  transpile_condition(o->sexp->buffer[1], code);
-  ccode_append(code, ") {");
-  for (size_t i = 2; i < o->sexp->len; i++) {
-    transpile_statement(o->sexp->buffer[i], code);
-  }
-  ccode_printf_line(code, "}");
-};
-
-void transpile_cast(Obj *o, CCode *code) {
-  if (o->sexp->len != 2) {
-    fail_at(o->beg, "a cast takes exactly one value, e.g. (:int x)");
-  }
-
-  char *type = type_to_c(o->sexp->buffer[0]->atom->buffer);
-  ccode_append(code, "((%s)", type);
-  free(type);
-  transpile_expression(o->sexp->buffer[1], code);
-  ccode_append(code, ")");
-};
-
-void transpile_op_assign(Obj *o, CCode *code) {
-  if (o->sexp->len != 3) {
-    fail_at(o->beg, "'%s' needs a place and a value, e.g. (%s x 1)",
-            o->sexp->buffer[0]->atom->buffer, o->sexp->buffer[0]->atom->buffer);
-  }
-
-  ccode_append(code, "(");
-  transpile_expression(o->sexp->buffer[1], code);
-  ccode_append(code, " %s ", o->sexp->buffer[0]->atom->buffer);
-  transpile_expression(o->sexp->buffer[2], code);
-  ccode_append(code, ")");
-};
-
-void transpile_deref(Obj *o, CCode *code) {
-  if (o->sexp->len != 2) {
-    fail_at(o->beg, "deref takes exactly one value");
-  }
-
-  ccode_append(code, "*(");
-  transpile_expression(o->sexp->buffer[1], code);
-  ccode_append(code, ")");
+  free(b->units);
+  pthread_mutex_destroy(&b->lock);
 }
 
-void transpile_return(Obj *o, CCode *code) {
-  if (o->sexp->len > 2) {
-    fail_at(o->beg, "return takes at most one value");
-  }
-
-  if (o->sexp->len == 1) {
-    ccode_mark_line(code, o);
-    ccode_printf_line(code, "return;");
-    return;
+static bool build_link(Build *b, const char *output) {
+  uint64_t key = hash_string(b->base, getenv("LDFLAGS"));
+  key = hash_string(key, getenv("LDLIBS"));
+  for (size_t i = 0; i < b->len; i++) {
+    key = hash_bytes(key, &b->units[i].id, sizeof(uint64_t));
   }
-
-  Obj *t = o->sexp->buffer[1];
-  ccode_mark_line(code, t);
-  ccode_printf_line(code, "return ");
-  transpile_expression(t, code);
-  ccode_append(code, ";");
-}
-
-void transpile_include(Obj *o, CCode *code) {
-  if (o->sexp->len < 2) {
-    fail_at(o->beg, "#include needs at least one header");
-  }
-
-  for (size_t i = 1; i < o->sexp->len; i++) {
-    Obj *t = o->sexp->buffer[i];
-    if (t->tag != ATOM) {
-      fail_at(t->beg, "#include takes header names, not expressions");
+  char *stamp = cache_path(b, hash_string(0xcbf29ce484222325ULL, output),
+                           ".link");
+  size_t len;
+  char *last = read_file(stamp, &len);
+  bool current = last != NULL && access(output, F_OK) == 0 &&
+                 strtoull(last, NULL, 16) == key;
+  free(last);
+  if (current) {
+    free(stamp);
+    return true;
+  }
+
+  char **argv = NULL;
+  size_t argc = 0;
+  for (size_t i = 0; i < b->cc_len; i++) {
+    add_word(&argv, &argc, strdup(b->cc[i]));
+  }
+  split_words(getenv("LDFLAGS"), &argv, &argc);
+  for (size_t i = 0; i < b->len; i++) {
+    add_word(&argv, &argc, cache_path(b, b->units[i].id, ".o"));
+  }
+  split_words(getenv("LDLIBS"), &argv, &argc);
+  split_words("-o", &argv, &argc);
+  add_word(&argv, &argc, strdup(output));
+  bool ok = run(argv, NULL, 0);
+  if (ok) {
+    char text[17];
+    snprintf(text, sizeof(text), "%016" PRIx64, key);
+    ok = write_file(stamp, text, 16);
+  } else {
+    fprintf(stderr, "error: linking %s failed\n", output);
+  }
+  free_words(argv, argc);
+  free(stamp);
+  return ok;
+}
+
+static int build(int argc, char **argv) {
+  long threads = sysconf(_SC_NPROCESSORS_ONLN);
+  const char *output = NULL;
+  Build b = {.cache = ".sic-cache"};
+  int argi = 2;
+  for (; argi < argc && argv[argi][0] == '-'; argi++) {
+    if (strcmp(argv[argi], "-o") == 0 && argi + 1 < argc) {
+      output = argv[++argi];
+    } else if (strcmp(argv[argi], "--cache") == 0 && argi + 1 < argc) {
+      b.cache = argv[++argi];
+    } else if (strncmp(argv[argi], "-j", 2) == 0) {
+      threads = parse_jobs(argv, &argi);
+    } else {
+      usage(argv[0]);
     }
-
-    ccode_mark_line(code, t);
-    ccode_printf_line(code, "#include %s", t->atom->buffer);
   }
-}
-
-void transpile_define(Obj *o, CCode *code) {
-  if (o->sexp->len < 2 || o->sexp->len > 3) {
-    fail_at(o->beg, "#define needs a name or (name params...), and an "
-                    "optional value");
-  }
-
-  ccode_mark_line(code, o);
-  Obj *name = o->sexp->buffer[1];
-  if (name->tag == ATOM) {
-    ccode_printf_line(code, "#define %s", name->atom->buffer);
-  } else {
-    if (name->sexp->len < 2) {
-      fail_at(name->beg, "a function-like #define needs a name and at "
-                         "least one parameter");
+  if (argi == argc) {
+    usage(argv[0]);
+  }
+  b.len = (size_t)(argc - argi);
+  b.units = build_alloc(calloc(b.len, sizeof(Unit)));
+  threads = threads < 1 ? 1 : threads;
+
+  char *cwd = getcwd(NULL, 0);
+  b.base = hash_string(hash_string(sicc_hash(), cwd), getenv("CC"));
+  b.base = hash_string(b.base, getenv("CFLAGS"));
+  free(cwd);
+  build_compiler(&b);
+  for (size_t i = 0; i < b.len; i++) {
+    const char *input = argv[argi + (int)i];
+    size_t n = strlen(input);
+    if (n < 5 || strcmp(input + n - 4, ".sic") != 0 ||
+        (n > 7 && strcmp(input + n - 7, ".cu.sic") == 0)) {
+      fprintf(stderr, "error: %s: sicc build takes .sic (not .cu.sic) "
+                      "sources\n", input);
+      return EXIT_FAILURE;
     }
-    for (size_t i = 0; i < name->sexp->len; i++) {
-      if (name->sexp->buffer[i]->tag != ATOM) {
-        fail_at(name->sexp->buffer[i]->beg,
-                "#define names and parameters must be plain atoms");
+    for (size_t j = 0; j < i; j++) {
+      if (strcmp(b.units[j].input, input) == 0) {
+        fprintf(stderr, "error: %s is given twice\n", input);
+        return EXIT_FAILURE;
       }
     }
-
-    ccode_printf_line(code, "#define %s(", name->sexp->buffer[0]->atom->buffer);
-    for (size_t i = 1; i < name->sexp->len; i++) {
-      ccode_append(code, "%s%s", i == 1 ? "" : ", ",
-                   name->sexp->buffer[i]->atom->buffer);
+    b.units[i].input = input;
+    if (!hash_file(hash_string(b.base, input), input, &b.units[i].key)) {
+      fprintf(stderr, "error: Unable to open %s for reading.\n", input);
+      return EXIT_FAILURE;
     }
-    ccode_append(code, ")");
   }
-
-  if (o->sexp->len == 3) {
-    ccode_append(code, " ");
-    transpile_expression(o->sexp->buffer[2], code);
-  }
-}
-
-void transpile_undef(Obj *o, CCode *code) {
-  if (o->sexp->len != 2 || o->sexp->buffer[1]->tag != ATOM) {
-    fail_at(o->beg, "#undef needs a name");
-  }
-
-  ccode_mark_line(code, o);
-  ccode_printf_line(code, "#undef %s", o->sexp->buffer[1]->atom->buffer);
-}
-
-void transpile_guard(Obj *o, CCode *code) {
-  char *head = o->sexp->buffer[0]->atom->buffer;
-  if (o->sexp->len < 2) {
-    fail_at(o->beg, "%s needs a condition", head);
+  if (mkdir(b.cache, 0777) != 0 && errno != EEXIST) {
+    fprintf(stderr, "error: Unable to create %s.\n", b.cache);
+    return EXIT_FAILURE;
   }
 
-  ccode_mark_line(code, o);
-  if (strcmp(head, "#if") == 0) {
-    ccode_printf_line(code, "#if ");
-    transpile_expression(o->sexp->buffer[1], code);
-  } else {
-    if (o->sexp->buffer[1]->tag != ATOM) {
-      fail_at(o->sexp->buffer[1]->beg, "%s takes a plain name", head);
+  pthread_mutex_init(&b.lock, NULL);
+  threads = (size_t)threads < b.len ? threads : (long)b.len;
+  pthread_t *workers = build_alloc(calloc((size_t)threads, sizeof(pthread_t)));
+  for (long i = 0; i < threads; i++) {
+    if (pthread_create(&workers[i], NULL, build_worker, &b) != 0) {
+      fprintf(stderr, "error: couldn't start worker thread\n");
+      exit(EXIT_FAILURE);
     }
-    ccode_printf_line(code, "%s %s", head, o->sexp->buffer[1]->atom->buffer);
-  }
-
-  for (size_t i = 2; i < o->sexp->len; i++) {
-    transpile_statement(o->sexp->buffer[i], code);
   }
-  ccode_printf_line(code, "#endif");
-}
-
-void transpile_hash_else(Obj *o, CCode *code) {
-  if (o->sexp->len != 1) {
-    fail_at(o->beg, "(#else) takes no arguments; place statements after it");
+  for (long i = 0; i < threads; i++) {
+    pthread_join(workers[i], NULL);
   }
+  free(workers);
 
-  ccode_printf_line(code, "#else");
-}
-
-void transpile_pragma(Obj *o, CCode *code) {
-  ccode_mark_line(code, o);
-  ccode_printf_line(code, "#pragma");
-  for (size_t i = 1; i < o->sexp->len; i++) {
-    if (o->sexp->buffer[i]->tag != ATOM) {
-      fail_at(o->sexp->buffer[i]->beg, "#pragma takes plain atoms");
-    }
-    ccode_append(code, " %s", o->sexp->buffer[i]->atom->buffer);
-  }
-}
-
-void transpile_call(Obj *o, CCode *code) {
-  transpile_postfix_base(o->sexp->buffer[0], code);
-  ccode_append(code, "(");
-
-  for (size_t j = 1; j < o->sexp->len; j++) {
-    if (j > 1) {
-      ccode_append(code, ", ");
+  bool ok = b.failed == 0;
+  if (ok) {
+    char *named = NULL;
+    if (output == NULL) {
+      const char *base_name = strrchr(b.units[0].input, '/');
+      base_name = base_name == NULL ? b.units[0].input : base_name + 1;
+      named = build_alloc(strndup(base_name, strlen(base_name) - 4));
     }
-    transpile_expression(o->sexp->buffer[j], code);
+    ok = build_link(&b, output != NULL ? output : named);
+    free(named);
   }
 
-  ccode_append(code, ")");
+  build_free(&b);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-void transpile_fn(Obj *o, CCode *code) {
-  if (o->sexp->len < 4 || o->sexp->buffer[1]->tag != ATOM ||
-      o->sexp->buffer[2]->tag != ATOM ||
-      o->sexp->buffer[2]->atom->buffer[0] != ':') {
-    fail_at(o->beg,
-            "fn needs a name, a :type, an argument list, and an optional "
-            "body, e.g. (fn main :int (argc :int argv :char**) ...)");
-  }
-
-  Obj *name = o->sexp->buffer[1];
-  Obj *type = o->sexp->buffer[2];
-
-  ccode_mark_line(code, name);
-  char *ret = type_to_c(type->atom->buffer);
-  ccode_printf_line(code, "%s %s(", ret, name->atom->buffer);
-  free(ret);
+// sicc run: runs a script, compiling it only when the cache of programs
+// lacks it. The program's key hashes the sicc executable, $CC, $CFLAGS,
+// $LDFLAGS, $LDLIBS, the script's absolute path and its bytes, and then
+// the headers its last compile read, as sicc build does for objects. The
+// C goes to cc on a pipe, compiled and linked in one step; the program
+// replaces sicc (execv) with the script's path as argv[0]. A "#!" first
+// line is skipped by the reader, so `#!/usr/bin/env -S sicc run` works.
 
-  Obj *args = o->sexp->buffer[3];
-  if (args->tag != SEXP) {
-    fail_at(o->sexp->buffer[3]->beg,
-            "fn arguments must be name :type pairs, e.g. (argc :int)");
-  }
-
-  size_t nargs = args->sexp->len;
-  Obj *last = nargs > 0 ? args->sexp->buffer[nargs - 1] : NULL;
-  bool variadic =
-      last != NULL && last->tag == ATOM && strcmp(last->atom->buffer, "...") == 0;
-  if (variadic) {
-    nargs--;
-  }
-  if ((nargs & 1) != 0) {
-    fail_at(args->beg,
-            "fn arguments must be name :type pairs, e.g. (argc :int)");
+// $XDG_CACHE_HOME/sicc, or ~/.cache/sicc, created if need be.
+static char *run_cache(void) {
+  const char *xdg = getenv("XDG_CACHE_HOME");
+  const char *home = getenv("HOME");
+  if ((xdg == NULL || *xdg == '\0') && (home == NULL || *home == '\0')) {
+    fprintf(stderr, "error: set HOME or XDG_CACHE_HOME, or pass --cache\n");
+    return NULL;
   }
-
-  for (size_t j = 0; j < nargs; j += 2) {
-    Obj *arg_name = args->sexp->buffer[j];
-    if (arg_name->tag != ATOM) {
-      fail_at(arg_name->beg,
-              "fn arguments must be name :type pairs, e.g. (argc :int)");
-    }
-
-    if (j > 0) {
-      ccode_append(code, ", ");
+  size_t len = strlen(xdg != NULL && *xdg != '\0' ? xdg : home) + 16;
+  char *dir = build_alloc(malloc(len));
+  if (xdg != NULL && *xdg != '\0') {
+    snprintf(dir, len, "%s/sicc", xdg);
+  } else {
+    snprintf(dir, len, "%s/.cache/sicc", home);
+  }
+  return dir;
+}
+
+// mkdir -p.
+static bool make_dirs(const char *path) {
+  char *dir = build_alloc(strdup(path));
+  bool ok = true;
+  for (char *p = dir + 1; ok; p++) {
+    bool last = *p == '\0';
+    if (*p == '/' || last) {
+      *p = '\0';
+      ok = mkdir(dir, 0777) == 0 || errno == EEXIST;
+      *p = '/';
+      if (last) {
+        break;
+      }
     }
-    ccode_append_declarator_obj(code, args->sexp->buffer[j + 1],
-                                arg_name->atom->buffer);
-  }
-
-  if (variadic) {
-    ccode_append(code, "%s...", nargs > 0 ? ", " : "");
-  }
-
-  if (o->sexp->len == 4) {
-    ccode_append(code, ");");
-    return;
-  }
-
-  ccode_append(code, ") {");
-
-  for (size_t j = 4; j < o->sexp->len; j++) {
-    transpile_statement(o->sexp->buffer[j], code);
   }
-
-  ccode_printf_line(code, "}");
+  if (!ok) {
+    fprintf(stderr, "error: Unable to create %s.\n", path);
+  }
+  free(dir);
+  return ok;
+}
+
+// Transpiles the script and pipes the C to cc, which writes `<id>`.
+static bool compile_script(Build *b, Unit *u) {
+  SicContext *sic = build_alloc(sic_init());
+  SicOutput out;
+  if (!sic_transpile_file(sic, u->input, NULL, &out)) {
+    report_error(sic_error(sic));
+    sic_free(sic);
+    return false;
+  }
+  unit_imports(u, sic);
+  sic_free(sic);
+
+  const char *slash = strrchr(u->input, '/'); // the path is absolute
+  char *path = cache_path(b, u->key, "");
+  char *ptmp = temp_path(path);
+  free(path);
+  path = cache_path(b, u->key, ".d");
+  char *dfile = temp_path(path);
+  free(path);
+  char **argv = NULL;
+  size_t argc = 0;
+  for (size_t i = 0; i < b->cc_len; i++) {
+    add_word(&argv, &argc, strdup(b->cc[i]));
+  }
+  split_words("-iquote", &argv, &argc);
+  add_word(&argv, &argc, slash == u->input
+                             ? strdup("/")
+                             : strndup(u->input, (size_t)(slash - u->input)));
+  split_words("-MD -MF", &argv, &argc);
+  add_word(&argv, &argc, strdup(dfile));
+  split_words("-x c - -x none", &argv, &argc);
+  split_words(getenv("LDFLAGS"), &argv, &argc);
+  split_words("-o", &argv, &argc);
+  add_word(&argv, &argc, strdup(ptmp));
+  split_words(getenv("LDLIBS"), &argv, &argc);
+  bool ok = run(argv, out.c, out.len) && deps_write(b, u, dfile, "-");
+  if (ok) {
+    path = cache_path(b, u->id, "");
+    ok = rename(ptmp, path) == 0;
+    free(path);
+  }
+  if (!ok) {
+    fprintf(stderr, "error: %s: compilation failed\n", u->input);
+    remove(ptmp);
+  }
+  remove(dfile);
+  free_words(argv, argc);
+  free(dfile);
+  free(ptmp);
+  free(out.c);
+  return ok;
+}
+
+static int run_script(int argc, char **argv) {
+  Build b = {0};
+  char *cache = NULL;
+  int argi = 2;
+  if (argi + 1 < argc && strcmp(argv[argi], "--cache") == 0) {
+    b.cache = argv[argi + 1];
+    argi += 2;
+  } else {
+    b.cache = cache = run_cache();
+  }
+  if (argi == argc) {
+    usage(argv[0]);
+  }
+  if (b.cache == NULL || !make_dirs(b.cache)) {
+    return EXIT_FAILURE;
+  }
+  char *script = realpath(argv[argi], NULL);
+  Unit unit = {.input = script};
+  b.base = hash_string(sicc_hash(), getenv("CC"));
+  b.base = hash_string(b.base, getenv("CFLAGS"));
+  b.base = hash_string(b.base, getenv("LDFLAGS"));
+  b.base = hash_string(b.base, getenv("LDLIBS"));
+  if (script == NULL ||
+      !hash_file(hash_string(b.base, script), script, &unit.key)) {
+    fprintf(stderr, "error: Unable to open %s for reading.\n", argv[argi]);
+    return EXIT_FAILURE;
+  }
+  pthread_mutex_init(&b.lock, NULL);
+  build_compiler(&b);
+  signal(SIGPIPE, SIG_IGN);
+  bool ok = unit_cached(&b, &unit, "") || compile_script(&b, &unit);
+  signal(SIGPIPE, SIG_DFL);
+  char *program = cache_path(&b, unit.id, "");
+  free(unit.imports);
+  build_free(&b);
+  free(cache);
+  free(script);
+  if (ok) {
+    execv(program, argv + argi); // argv[0] is the script, as it was named
+    fprintf(stderr, "error: couldn't run %s: %s\n", program,
+            strerror(errno));
+  }
+  free(program);
+  return EXIT_FAILURE;
+}
+
+// --watch DIR: transpiles each .sic under DIR whose output is missing or
+// older than it, then waits on inotify and redoes the files that change,
+// until killed. A save sets off a burst of events (and an editor saving
+// by rename more than one), so events are collected until none has come
+// for WATCH_QUIET_MS and each file is then done once. Outputs go next to
+// their sources, or to --out-dir, named as in batch mode, and are
+// replaced by rename -- only when their bytes change -- so a make or
+// compiler watching them never reads half a file. One context serves
+// every event with SicOptions.incremental, keeping the forms and macro
+// definitions of the files being edited between saves. A file with an
+// error is reported and keeps its old output. With --header each output
+// gets its header beside it, also written only when it changes.
+//
+// Each transpile's imports (sic_imports, plus the module an error was
+// in) are kept, so a change to a module also redoes every file that
+// imported it, directly or not. The start-up scan can't know a file's
+// imports without transpiling it, so it also does every file that
+// mentions import; an output whose C didn't change isn't rewritten.
+
+#define WATCH_QUIET_MS 50
+
+typedef struct Watch {
+  int fd;
+  const char *out_dir; // NULL: next to each source
+  char **dirs;         // indexed by watch descriptor
+  size_t dirs_len;
+  char **pending; // sources to redo once the burst is over
+  size_t pending_len;
+  char **sources; // those done that imported anything
+  char **imports; // what each did, one canonical path per line
+  size_t sources_len;
+  SicContext *sic;
+  bool header;
+} Watch;
+
+static bool sic_name_p(const char *name) {
+  size_t n = strlen(name);
+  return n > 4 && strcmp(name + n - 4, ".sic") == 0;
 }
 
-void transpile_for(Obj *o, CCode *code) {
-  if (o->sexp->len < 4) {
-    fail_at(o->beg, "for needs an init statement, a condition, and a step");
-  }
-
-  ccode_mark_line(code, o);
-  ccode_printf_line(code, "for (");
-  transpile_statement(o->sexp->buffer[1], code);
-  ccode_append(code, " ");
-  transpile_expression(o->sexp->buffer[2], code);
-  ccode_append(code, "; ");
-  transpile_expression(o->sexp->buffer[3], code);
-  ccode_append(code, ") {");
-  for (size_t i = 4; i < o->sexp->len; i++) {
-    transpile_statement(o->sexp->buffer[i], code);
-  }
-  ccode_printf_line(code, "}");
+static char *join_path(const char *dir, const char *name) {
+  size_t len = strlen(dir) + strlen(name) + 2;
+  char *path = build_alloc(malloc(len));
+  snprintf(path, len, "%s/%s", dir, name);
+  return path;
 }
 
-void transpile_if(Obj *o, CCode *code) {
-  if (o->sexp->len < 3 || o->sexp->len > 4) {
-    fail_at(o->beg, "if needs a condition, a branch, and at most an else "
-                    "branch; use (do ...) to group statements");
-  }
-
-  ccode_mark_line(code, o);
-  ccode_printf_line(code, "if (");
-  transpile_condition(o->sexp->buffer[1], code);
-  ccode_append(code, ") {");
-  transpile_statement(o->sexp->buffer[2], code);
-  if (o->sexp->len == 4) {
-    ccode_printf_line(code, "} else {");
-    transpile_statement(o->sexp->buffer[3], code);
+static char *watch_output(const Watch *w, const char *input) {
+  if (w->out_dir != NULL) {
+    return batch_output(w->out_dir, input);
   }
-  ccode_printf_line(code, "}");
+  const char *slash = strrchr(input, '/');
+  char *dir = build_alloc(strndup(input, (size_t)(slash - input)));
+  char *output = batch_output(dir, input);
+  free(dir);
+  return output;
 }
 
-void transpile_do(Obj *o, CCode *code) {
-  ccode_mark_line(code, o);
-  ccode_printf_line(code, "{");
-  for (size_t i = 1; i < o->sexp->len; i++) {
-    transpile_statement(o->sexp->buffer[i], code);
+// Takes `path`.
+static void watch_queue(Watch *w, char *path) {
+  for (size_t i = 0; i < w->pending_len; i++) {
+    if (strcmp(w->pending[i], path) == 0) {
+      free(path);
+      return;
+    }
   }
-  ccode_printf_line(code, "}");
+  add_word(&w->pending, &w->pending_len, path);
 }
 
-void transpile_sizeof(Obj *o, CCode *code) {
-  if (o->sexp->len != 2) {
-    fail_at(o->beg, "sizeof takes exactly one operand");
+static bool mentions_import(const char *path) {
+  size_t len;
+  char *text = read_file(path, &len);
+  bool found = text != NULL && strstr(text, "import") != NULL;
+  free(text);
+  return found;
+}
+
+// Watches `dir` and everything under it, queueing the sources that need
+// doing: all of them when `all` (a directory that just appeared), else
+// those whose output is missing or older, or that may import.
+static void watch_dir(Watch *w, const char *dir, bool all) {
+  int wd = inotify_add_watch(w->fd, dir,
+                             IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE |
+                                 IN_ONLYDIR);
+  if (wd < 0) {
+    fprintf(stderr, "error: Unable to watch %s: %s\n", dir, strerror(errno));
+    return;
   }
-
-  Obj *t = o->sexp->buffer[1];
-  if (t->tag == ATOM && t->atom->buffer[0] == ':') {
-    char *type = type_to_c(t->atom->buffer);
-    ccode_append(code, "sizeof(%s)", type);
-    free(type);
-  } else {
-    ccode_append(code, "sizeof(");
-    transpile_expression(t, code);
-    ccode_append(code, ")");
+  if ((size_t)wd >= w->dirs_len) {
+    w->dirs = build_alloc(realloc(w->dirs, (size_t)(wd + 1) * sizeof(char *)));
+    memset(w->dirs + w->dirs_len, 0,
+           ((size_t)wd + 1 - w->dirs_len) * sizeof(char *));
+    w->dirs_len = (size_t)wd + 1;
   }
-}
-
-void transpile_typeop(Obj *o, CCode *code) {
-  char *head = o->sexp->buffer[0]->atom->buffer;
-  bool is_offsetof = strcmp(head, "offsetof") == 0;
-  size_t want = is_offsetof ? 3 : 2;
+  free(w->dirs[wd]);
+  w->dirs[wd] = build_alloc(strdup(dir));
 
-  if (o->sexp->len != want || o->sexp->buffer[1]->tag != ATOM ||
-      o->sexp->buffer[1]->atom->buffer[0] != ':' ||
-      (is_offsetof && o->sexp->buffer[2]->tag != ATOM)) {
-    fail_at(o->beg,
-            is_offsetof ? "offsetof needs a :type and a field name"
-                        : "alignof needs a :type");
+  DIR *d = opendir(dir);
+  if (d == NULL) {
+    return;
   }
-
-  char *type = type_to_c(o->sexp->buffer[1]->atom->buffer);
-  if (is_offsetof) {
-    ccode_append(code, "offsetof(%s, %s)", type,
-                 o->sexp->buffer[2]->atom->buffer);
-  } else {
-    ccode_append(code, "_Alignof(%s)", type);
+  struct dirent *e;
+  while ((e = readdir(d)) != NULL) {
+    if (e->d_name[0] == '.') {
+      continue;
+    }
+    char *path = join_path(dir, e->d_name);
+    struct stat st;
+    if (stat(path, &st) != 0) {
+      free(path);
+    } else if (S_ISDIR(st.st_mode)) {
+      watch_dir(w, path, all);
+      free(path);
+    } else if (sic_name_p(e->d_name)) {
+      char *output = watch_output(w, path);
+      struct stat out;
+      bool stale = all || stat(output, &out) != 0 ||
+                   out.st_mtim.tv_sec < st.st_mtim.tv_sec ||
+                   (out.st_mtim.tv_sec == st.st_mtim.tv_sec &&
+                    out.st_mtim.tv_nsec < st.st_mtim.tv_nsec) ||
+                   mentions_import(path);
+      free(output);
+      if (stale) {
+        watch_queue(w, path);
+      } else {
+        free(path);
+      }
+    } else {
+      free(path);
+    }
   }
-  free(type);
+  closedir(d);
 }
 
-void transpile_ternary(Obj *o, CCode *code) {
-  if (o->sexp->len != 4) {
-    fail_at(o->beg, "?: needs a condition and two values");
+static bool has_line(const char *lines, const char *line) {
+  size_t n = strlen(line);
+  for (const char *p = lines; *p != '\0';) {
+    size_t len = strcspn(p, "\n");
+    if (len == n && memcmp(p, line, n) == 0) {
+      return true;
+    }
+    p += len + (p[len] != '\0');
   }
-
-  ccode_append(code, "(");
-  transpile_expression(o->sexp->buffer[1], code);
-  ccode_append(code, " ? ");
-  transpile_expression(o->sexp->buffer[2], code);
-  ccode_append(code, " : ");
-  transpile_expression(o->sexp->buffer[3], code);
-  ccode_append(code, ")");
+  return false;
 }
 
-void transpile_init(Obj *o, CCode *code) {
-  ccode_append(code, "{");
-  for (size_t i = 1; i < o->sexp->len; i++) {
-    if (i > 1) {
-      ccode_append(code, ", ");
+// Keeps what the last transpile of `input` imported, or tried to.
+static void watch_record(Watch *w, const char *input, bool ok) {
+  const char *imported = sic_imports(w->sic);
+  const char *failed = ok ? NULL : sic_error(w->sic)->file;
+  size_t i = 0;
+  while (i < w->sources_len && strcmp(w->sources[i], input) != 0) {
+    i++;
+  }
+  if (i == w->sources_len) {
+    if (*imported == '\0' && failed == NULL) {
+      return;
     }
-
-    Obj *e = o->sexp->buffer[i];
-    bool designated = e->tag == SEXP && e->sexp->len == 2 &&
-                      e->sexp->buffer[0]->tag == ATOM &&
-                      e->sexp->buffer[0]->atom->buffer[0] == '.';
-    if (designated) {
-      ccode_append(code, "%s = ", e->sexp->buffer[0]->atom->buffer);
-      transpile_expression(e->sexp->buffer[1], code);
-    } else {
-      transpile_expression(e, code);
+    w->sources =
+        build_alloc(realloc(w->sources, (i + 1) * sizeof(char *)));
+    w->imports =
+        build_alloc(realloc(w->imports, (i + 1) * sizeof(char *)));
+    w->sources[i] = build_alloc(strdup(input));
+    w->imports[i] = NULL;
+    w->sources_len++;
+  }
+  size_t len = strlen(imported);
+  size_t size = len + (failed == NULL ? 0 : strlen(failed) + 1) + 1;
+  char *imports = build_alloc(malloc(size));
+  snprintf(imports, size, "%s%s%s", imported, failed == NULL ? "" : failed,
+           failed == NULL ? "" : "\n");
+  free(w->imports[i]);
+  w->imports[i] = imports;
+}
+
+// Queues every source that imported one already queued. Imports are
+// recorded transitively, so one pass finds them all.
+static void watch_importers(Watch *w) {
+  size_t changed = w->pending_len;
+  for (size_t i = 0; i < changed; i++) {
+    char *real = realpath(w->pending[i], NULL);
+    if (real == NULL) {
+      continue;
+    }
+    for (size_t j = 0; j < w->sources_len; j++) {
+      if (has_line(w->imports[j], real)) {
+        watch_queue(w, build_alloc(strdup(w->sources[j])));
+      }
     }
+    free(real);
   }
-  ccode_append(code, "}");
 }
 
-void transpile_switch(Obj *o, CCode *code) {
-  if (o->sexp->len < 2) {
-    fail_at(o->beg, "switch needs a value");
-  }
-
-  ccode_mark_line(code, o);
-  ccode_printf_line(code, "switch (");
-  transpile_expression(o->sexp->buffer[1], code);
-  ccode_append(code, ") {");
-
-  for (size_t j = 2; j < o->sexp->len; j++) {
-    Obj *entry = o->sexp->buffer[j];
-    if (entry->tag != SEXP || entry->sexp->len == 0 ||
-        entry->sexp->buffer[0]->tag != ATOM) {
-      fail_at(entry->beg,
-              "switch entries are (case value ...) or (default ...)");
+static void watch_flush(Watch *w) {
+  SicOptions options = {.incremental = true, .header = w->header};
+  watch_importers(w);
+  for (size_t i = 0; i < w->pending_len; i++) {
+    const char *input = w->pending[i];
+    SicOutput out;
+    bool ok = sic_transpile_file(w->sic, input, &options, &out);
+    watch_record(w, input, ok);
+    if (!ok) {
+      report_error(sic_error(w->sic));
+      continue;
     }
-
-    char *head = entry->sexp->buffer[0]->atom->buffer;
-    size_t body;
-    ccode_mark_line(code, entry);
-    if (strcmp(head, "case") == 0) {
-      if (entry->sexp->len < 2) {
-        fail_at(entry->beg, "case needs a value");
-      }
-      ccode_printf_line(code, "case ");
-      transpile_expression(entry->sexp->buffer[1], code);
-      ccode_append(code, ": {");
-      body = 2;
-    } else if (strcmp(head, "default") == 0) {
-      ccode_printf_line(code, "default: {");
-      body = 1;
-    } else {
-      fail_at(entry->beg,
-              "switch entries are (case value ...) or (default ...)");
+    char *output = watch_output(w, input);
+    write_changed(output, out.c, out.len);
+    if (w->header) {
+      char *path = header_output(output);
+      write_changed(path, out.h, out.h_len);
+      free(path);
     }
-
-    for (size_t i = body; i < entry->sexp->len; i++) {
-      transpile_statement(entry->sexp->buffer[i], code);
+    free(output);
+    free(out.c);
+    free(out.h);
+  }
+  free_words(w->pending, w->pending_len);
+  w->pending = NULL;
+  w->pending_len = 0;
+}
+
+// Queues what the events in `buf` touched.
+static void watch_events(Watch *w, const char *buf, size_t len) {
+  for (size_t off = 0; off < len;) {
+    struct inotify_event e;
+    memcpy(&e, buf + off, sizeof(e));
+    const char *name = buf + off + sizeof(e);
+    off += sizeof(e) + e.len;
+    if (e.wd < 0 || (size_t)e.wd >= w->dirs_len || w->dirs[e.wd] == NULL ||
+        e.len == 0 || name[0] == '.') {
+      continue;
+    }
+    char *path = join_path(w->dirs[e.wd], name);
+    if (e.mask & IN_ISDIR) {
+      watch_dir(w, path, true);
+      free(path);
+    } else if (sic_name_p(name) && (e.mask & (IN_CLOSE_WRITE | IN_MOVED_TO))) {
+      watch_queue(w, path);
+    } else {
+      free(path);
     }
-    ccode_printf_line(code, "}");
   }
-
-  ccode_printf_line(code, "}");
 }
 
-void transpile_do_while(Obj *o, CCode *code) {
-  if (o->sexp->len < 2) {
-    fail_at(o->beg, "do-while needs a condition");
+static int watch(const char *dir, const char *out_dir, bool header) {
+  Watch w = {.fd = inotify_init1(IN_CLOEXEC),
+             .out_dir = out_dir,
+             .header = header};
+  if (w.fd < 0) {
+    fprintf(stderr, "error: inotify: %s\n", strerror(errno));
+    return EXIT_FAILURE;
   }
-
-  ccode_mark_line(code, o);
-  ccode_printf_line(code, "do {");
-  for (size_t i = 2; i < o->sexp->len; i++) {
-    transpile_statement(o->sexp->buffer[i], code);
+  if (out_dir != NULL && !make_dirs(out_dir)) {
+    return EXIT_FAILURE;
   }
-  ccode_printf_line(code, "} while (");
-  transpile_condition(o->sexp->buffer[1], code);
-  ccode_append(code, ");");
-}
-
-void transpile_goto(Obj *o, CCode *code) {
-  char *head = o->sexp->buffer[0]->atom->buffer;
-  if (o->sexp->len != 2 || o->sexp->buffer[1]->tag != ATOM) {
-    fail_at(o->beg, "%s needs a label name", head);
+  w.sic = build_alloc(sic_init());
+  char *root = build_alloc(strdup(dir));
+  for (size_t n = strlen(root); n > 1 && root[n - 1] == '/'; n--) {
+    root[n - 1] = '\0';
   }
-
-  ccode_mark_line(code, o);
-  if (strcmp(head, "goto") == 0) {
-    ccode_printf_line(code, "goto %s;", o->sexp->buffer[1]->atom->buffer);
-  } else {
-    ccode_printf_line(code, "%s:;", o->sexp->buffer[1]->atom->buffer);
+  watch_dir(&w, root, false);
+  free(root);
+  if (w.dirs_len == 0) {
+    return EXIT_FAILURE;
   }
-}
 
-// CUDA kernel launch: (launch kernel (grid block [shared stream]) args...)
-// becomes kernel<<<grid, block>>>(args). The config sexp mirrors the
-// <<<>>> grouping; qualifiers like __global__ need no forms at all since
-// they ride on hyphen-types.
-void transpile_launch(Obj *o, CCode *code) {
-  if (o->sexp->len < 3 || o->sexp->buffer[2]->tag != SEXP ||
-      o->sexp->buffer[2]->sexp->len < 2 || o->sexp->buffer[2]->sexp->len > 4) {
-    fail_at(o->beg,
-            "launch needs a kernel and a (grid block) config with optional "
-            "shared-bytes and stream, e.g. (launch add (blocks threads) out)");
-  }
-
-  transpile_postfix_base(o->sexp->buffer[1], code);
-  ccode_append(code, "<<<");
-  List *cfg = o->sexp->buffer[2]->sexp;
-  for (size_t i = 0; i < cfg->len; i++) {
-    if (i > 0) {
-      ccode_append(code, ", ");
-    }
-    transpile_expression(cfg->buffer[i], code);
-  }
-  ccode_append(code, ">>>(");
-  for (size_t i = 3; i < o->sexp->len; i++) {
-    if (i > 3) {
-      ccode_append(code, ", ");
+  char buf[4096];
+  for (;;) {
+    watch_flush(&w);
+    struct pollfd fds = {.fd = w.fd, .events = POLLIN};
+    int timeout = -1;
+    int ready;
+    while ((ready = poll(&fds, 1, timeout)) != 0) {
+      if (ready < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        fprintf(stderr, "error: poll: %s\n", strerror(errno));
+        return EXIT_FAILURE;
+      }
+      ssize_t n = read(w.fd, buf, sizeof(buf));
+      if (n < 0 && errno != EINTR) {
+        fprintf(stderr, "error: inotify: %s\n", strerror(errno));
+        return EXIT_FAILURE;
+      }
+      watch_events(&w, buf, n < 0 ? 0 : (size_t)n);
+      timeout = WATCH_QUIET_MS;
     }
-    transpile_expression(o->sexp->buffer[i], code);
   }
-  ccode_append(code, ")");
 }
 
-void transpile_struct(Obj *o, CCode *code) {
-  char *kind = o->sexp->buffer[0]->atom->buffer;
-  if (o->sexp->len < 2 || o->sexp->buffer[1]->tag != ATOM ||
-      ((o->sexp->len - 2) & 1) != 0) {
-    fail_at(o->beg, "%s needs a name and field name :type pairs, e.g. "
-                    "(%s Point x :int y :int)",
-            kind, kind);
-  }
-
-  ccode_mark_line(code, o);
-  ccode_printf_line(code, "%s %s {", kind, o->sexp->buffer[1]->atom->buffer);
-  for (size_t j = 2; j < o->sexp->len; j += 2) {
-    Obj *field = o->sexp->buffer[j];
-    if (field->tag != ATOM) {
-      fail_at(field->beg, "%s fields must be name :type pairs", kind);
-    }
-
-    ccode_printf_line(code, "");
-    ccode_append_declarator_obj(code, o->sexp->buffer[j + 1],
-                                field->atom->buffer);
-    ccode_append(code, ";");
+int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "build") == 0) {
+    return build(argc, argv);
+  }
+  if (argc > 1 && strcmp(argv[1], "run") == 0) {
+    return run_script(argc, argv);
+  }
+  bool stats = false;
+  bool stream = false;
+  bool server = false;
+  bool header = false;
+  bool source_map = false;
+  long threads = 1;
+  const char *out_dir = NULL;
+  const char *watched = NULL;
+  const char *unity = NULL;
+  char **exports = calloc((size_t)argc, sizeof(char *));
+  size_t exports_len = 0;
+  if (exports == NULL) {
+    fprintf(stderr, "error: Couldn't allocate memory! Exiting.\n");
+    exit(EXIT_FAILURE);
   }
-  ccode_printf_line(code, "};");
-}
-
-void transpile_enum(Obj *o, CCode *code) {
-  if (o->sexp->len < 2 || o->sexp->buffer[1]->tag != ATOM) {
-    fail_at(o->beg, "enum needs a name");
-  }
-
-  ccode_mark_line(code, o);
-  ccode_printf_line(code, "enum %s {", o->sexp->buffer[1]->atom->buffer);
-  for (size_t j = 2; j < o->sexp->len; j++) {
-    Obj *entry = o->sexp->buffer[j];
-    if (entry->tag == ATOM) {
-      ccode_printf_line(code, "%s,", entry->atom->buffer);
-    } else if (entry->sexp->len == 2 && entry->sexp->buffer[0]->tag == ATOM &&
-               entry->sexp->buffer[1]->tag == ATOM) {
-      ccode_printf_line(code, "%s = %s,", entry->sexp->buffer[0]->atom->buffer,
-                        entry->sexp->buffer[1]->atom->buffer);
+  int argi = 1;
+  for (; argi < argc && argv[argi][0] == '-' && argv[argi][1] != '\0';
+       argi++) {
+    if (strcmp(argv[argi], "--stats") == 0) {
+      stats = true;
+    } else if (strcmp(argv[argi], "--stream") == 0) {
+      stream = true;
+    } else if (strcmp(argv[argi], "--server") == 0) {
+      server = true;
+    } else if (strcmp(argv[argi], "--header") == 0) {
+      header = true;
+    } else if (strcmp(argv[argi], "--source-map") == 0) {
+      source_map = true;
+    } else if (strcmp(argv[argi], "--out-dir") == 0 && argi + 1 < argc) {
+      out_dir = argv[++argi];
+    } else if (strcmp(argv[argi], "--watch") == 0 && argi + 1 < argc) {
+      watched = argv[++argi];
+    } else if (strcmp(argv[argi], "--unity") == 0 && argi + 1 < argc) {
+      unity = argv[++argi];
+    } else if (strcmp(argv[argi], "--export") == 0 && argi + 1 < argc) {
+      exports[exports_len++] = argv[++argi];
+    } else if (strncmp(argv[argi], "-j", 2) == 0) {
+      threads = parse_jobs(argv, &argi);
     } else {
-      fail_at(entry->beg, "enum entries are names or (name value) pairs");
+      usage(argv[0]);
     }
   }
-  ccode_printf_line(code, "};");
-}
-
-void transpile_typedef(Obj *o, CCode *code) {
-  if (o->sexp->len != 3 || o->sexp->buffer[1]->tag != ATOM) {
-    fail_at(o->beg, "typedef needs a name and a :type, e.g. "
-                    "(typedef Point :struct-Point)");
+  if ((unity == NULL && exports_len > 0) ||
+      (source_map && (unity != NULL || server || watched != NULL ||
+                      out_dir != NULL || stream))) {
+    usage(argv[0]);
   }
-
-  ccode_mark_line(code, o);
-  ccode_printf_line(code, "typedef ");
-  ccode_append_declarator_obj(code, o->sexp->buffer[2],
-                              o->sexp->buffer[1]->atom->buffer);
-  ccode_append(code, ";");
-}
-
-void transpile_obj(Obj *o, CCode *code, RuleContext ctx) {
-#ifdef DEBUG
-  obj_print(o);
-#endif
-
-  if (o->tag == SEXP) {
-    if (o->sexp->len == 0) {
-      fail_at(o->beg, "empty expression '()'");
+  if (unity != NULL) {
+    if (argi == argc || stream || out_dir != NULL || threads > 1 ||
+        watched != NULL || header || server) {
+      usage(argv[0]);
     }
-    if (o->sexp->buffer[0]->tag != ATOM) {
-      bool as_statement = ctx == STATEMENT;
-      if (as_statement) {
-        ccode_mark_line(code, o);
-        ccode_printf_line(code, "");
-      }
-      transpile_call(o, code);
-      if (as_statement) {
-        ccode_append(code, ";");
-      }
-      return;
-    }
-
-    char *head = o->sexp->buffer[0]->atom->buffer;
-    const TRule *rule = rule_for(head);
-    if (rule == NULL) {
-      fail_at(o->beg, "no rule matches '%s' here", head);
+    int status = transpile_unity(argv + argi, (size_t)(argc - argi), unity,
+                                 exports, stats);
+    free(exports);
+    return status;
+  }
+  free(exports);
+  if (server) {
+    if (argi != argc || stream || out_dir != NULL || threads > 1 ||
+        watched != NULL || header) {
+      usage(argv[0]);
     }
-
-    if (ctx == EXPRESSION && (rule->ctx & EXPRESSION) == 0) {
-      fail_at(o->beg, "'%s' is a statement and has no value here", head);
-    }
-
-    bool as_statement = ctx == STATEMENT && (rule->ctx & STATEMENT) == 0;
-    if (as_statement) {
-      ccode_mark_line(code, o);
-      ccode_printf_line(code, "");
-    }
-
-    rule->fn(o, code);
-
-    if (as_statement) {
-      ccode_append(code, ";");
-    }
-  } else {
-    if (ctx == STATEMENT) {
-      ccode_mark_line(code, o);
-      ccode_printf_line(code, "%s;", o->atom->buffer);
-    } else {
-      ccode_append(code, "%s", o->atom->buffer);
+    return serve();
+  }
+  if (watched != NULL) {
+    if (argi != argc || stream || threads > 1) {
+      usage(argv[0]);
     }
+    return watch(watched, out_dir, header);
   }
-}
-
-CCode *transpile(List *list) {
-  CCode *code = ccode_init();
-
-  for (size_t i = 0; i < list->len; i++) {
-    transpile_statement(list->buffer[i], code);
+  if (argc - argi < 1 ||
+      (stream && (threads > 1 || out_dir != NULL || header))) {
+    usage(argv[0]);
   }
-
-  return code;
-}
-
-void transpile_expression(Obj *o, CCode *code) {
-  transpile_obj(o, code, EXPRESSION);
-}
-
-void transpile_statement(Obj *o, CCode *code) {
-  transpile_obj(o, code, STATEMENT);
-}
-
-// === Main ===
-
-int main(int argc, char **argv) {
-  if (argc < 2) {
-    fprintf(stderr, "Usage: %s <file to transpile> [output file]\n", argv[0]);
-    exit(EXIT_FAILURE);
+  if (out_dir != NULL) {
+    return transpile_batch(argv + argi, (size_t)(argc - argi), out_dir,
+                           (size_t)threads, stats, header);
   }
+  if (argc - argi > 2 || ((header || source_map) && argc - argi < 2)) {
+    usage(argv[0]);
+  }
+  char *input = argv[argi];
+  char *output = argc - argi >= 2 ? argv[argi + 1] : NULL;
 
-  sic_srcname = argv[1];
-  Parser *parser = parser_init(argv[1]);
-  parser_parse(parser);
-  expand_toplevel(parser->list);
-  CCode *code = transpile(parser->list);
-  macros_free();
-  parser_free(parser);
-
-  FILE *fp = stdout;
-  if (argc >= 3) {
-    fp = fopen(argv[2], "w");
+  SicContext *sic = build_alloc(sic_init());
+  bool ok = true;
+  if (stream) {
+    FILE *fp = open_output(output);
     if (fp == NULL) {
-      fprintf(stderr, "error: Unable to open %s for writing.\n", argv[2]);
-      exit(EXIT_FAILURE);
+      return EXIT_FAILURE;
     }
+    SicOutput out;
+    ok = sic_transpile_stream(sic, input, fp, &out);
+    if (fp != stdout) {
+      fclose(fp);
+    }
+    if (stats) {
+      report_stats(strcmp(input, "-") == 0 ? "<stdin>" : input, &out);
+    }
+    if (!ok) {
+      report_error(sic_error(sic));
+    }
+  } else {
+    ok = transpile_file(sic, input, output, (size_t)threads, stats, header,
+                        source_map);
   }
-  ccode_write(code, fp);
-  if (fp != stdout) {
-    fclose(fp);
-  }
-  ccode_free(code);
+  sic_free(sic);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
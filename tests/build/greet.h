@@ -0,0 +1,2 @@
+#define GREETING "hello"
+int greet(const char *who);
@@ -0,0 +1,87 @@
+#line 1 "tests/cases/control.sic"
+#include <stdio.h>
+#line 3 "tests/cases/control.sic"
+void describe(int n) {
+#line 4 "tests/cases/control.sic"
+switch (n) {
+#line 5 "tests/cases/control.sic"
+case 1: {
+#line 5 "tests/cases/control.sic"
+printf("one\n");
+#line 5 "tests/cases/control.sic"
+break;
+}
+#line 6 "tests/cases/control.sic"
+case 2: {
+#line 6 "tests/cases/control.sic"
+printf("two\n");
+}
+#line 7 "tests/cases/control.sic"
+default: {
+#line 7 "tests/cases/control.sic"
+printf("other\n");
+#line 7 "tests/cases/control.sic"
+break;
+}
+}
+}
+#line 9 "tests/cases/control.sic"
+int main(int argc, char** argv) {
+#line 10 "tests/cases/control.sic"
+describe(1);
+#line 11 "tests/cases/control.sic"
+describe(2);
+#line 12 "tests/cases/control.sic"
+describe(9);
+#line 14 "tests/cases/control.sic"
+int i = 0;
+#line 15 "tests/cases/control.sic"
+do {
+#line 16 "tests/cases/control.sic"
+printf("i=%d\n", i);
+#line 17 "tests/cases/control.sic"
+(++i);
+} while (i < 3);
+#line 19 "tests/cases/control.sic"
+int j = 0;
+#line 20 "tests/cases/control.sic"
+while (1) {
+#line 21 "tests/cases/control.sic"
+(++j);
+#line 22 "tests/cases/control.sic"
+if (j == 2) {
+#line 22 "tests/cases/control.sic"
+continue;
+}
+#line 23 "tests/cases/control.sic"
+if (j > 4) {
+#line 23 "tests/cases/control.sic"
+break;
+}
+#line 24 "tests/cases/control.sic"
+printf("j=%d\n", j);
+}
+#line 26 "tests/cases/control.sic"
+int vals[4] = {3, 1, 4, 0};
+#line 27 "tests/cases/control.sic"
+int k = 0;
+#line 28 "tests/cases/control.sic"
+int v;
+#line 29 "tests/cases/control.sic"
+while ((v = vals[k]) != 0) {
+#line 30 "tests/cases/control.sic"
+printf("v=%d\n", v);
+#line 31 "tests/cases/control.sic"
+(++k);
+}
+#line 33 "tests/cases/control.sic"
+goto skip;
+#line 34 "tests/cases/control.sic"
+printf("not printed\n");
+#line 35 "tests/cases/control.sic"
+skip:;
+#line 36 "tests/cases/control.sic"
+printf("done\n");
+#line 37 "tests/cases/control.sic"
+return 0;
+}
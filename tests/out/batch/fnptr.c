@@ -0,0 +1,56 @@
+#line 1 "tests/cases/fnptr.sic"
+#include <stdio.h>
+#line 3 "tests/cases/fnptr.sic"
+int add(int a, int b) {
+#line 3 "tests/cases/fnptr.sic"
+return (a + b);
+}
+#line 4 "tests/cases/fnptr.sic"
+int mul(int a, int b) {
+#line 4 "tests/cases/fnptr.sic"
+return (a * b);
+}
+#line 6 "tests/cases/fnptr.sic"
+typedef int (*BinOp)(int, int);
+#line 7 "tests/cases/fnptr.sic"
+struct Op {
+const char* name;
+int (*apply)(int, int);
+};
+#line 9 "tests/cases/fnptr.sic"
+BinOp pick(int which) {
+#line 10 "tests/cases/fnptr.sic"
+return (which ? add : mul);
+}
+#line 12 "tests/cases/fnptr.sic"
+int apply_twice(int (*f)(int, int), int x) {
+#line 13 "tests/cases/fnptr.sic"
+return f(f(x, x), f(x, x));
+}
+#line 15 "tests/cases/fnptr.sic"
+int main(int argc, char** argv) {
+#line 16 "tests/cases/fnptr.sic"
+int (*f)(int, int) = add;
+#line 17 "tests/cases/fnptr.sic"
+printf("%d\n", f(2, 3));
+#line 18 "tests/cases/fnptr.sic"
+(f = mul);
+#line 19 "tests/cases/fnptr.sic"
+printf("%d\n", f(2, 3));
+#line 21 "tests/cases/fnptr.sic"
+BinOp g = add;
+#line 22 "tests/cases/fnptr.sic"
+printf("%d\n", g(10, 5));
+#line 24 "tests/cases/fnptr.sic"
+struct Op op;
+#line 25 "tests/cases/fnptr.sic"
+(op.apply = mul);
+#line 26 "tests/cases/fnptr.sic"
+printf("%d\n", (op.apply)(4, 5));
+#line 28 "tests/cases/fnptr.sic"
+printf("%d\n", (pick(1))(6, 7));
+#line 29 "tests/cases/fnptr.sic"
+printf("%d\n", apply_twice(add, 3));
+#line 30 "tests/cases/fnptr.sic"
+return 0;
+}
@@ -0,0 +1,9 @@
+#line 1 "examples/hello.sic"
+#include "stdio.h"
+#line 3 "examples/hello.sic"
+int main(int argc, char** argv) {
+#line 4 "examples/hello.sic"
+printf("hello, world!\n");
+#line 5 "examples/hello.sic"
+return 0;
+}
@@ -0,0 +1,58 @@
+#line 1 "tests/cases/lvalues.sic"
+#include <stdio.h>
+#line 1 "tests/cases/lvalues.sic"
+#include <stdlib.h>
+#line 3 "tests/cases/lvalues.sic"
+int main(int argc, char** argv) {
+#line 4 "tests/cases/lvalues.sic"
+int a[4];
+#line 5 "tests/cases/lvalues.sic"
+for (
+#line 5 "tests/cases/lvalues.sic"
+int i = 0; (i < 4); (++i)) {
+#line 6 "tests/cases/lvalues.sic"
+(a[i] = (i * i));
+}
+#line 7 "tests/cases/lvalues.sic"
+(a[0] = 42);
+#line 8 "tests/cases/lvalues.sic"
+printf("%d %d %d %d\n", a[0], a[1], a[2], a[3]);
+#line 10 "tests/cases/lvalues.sic"
+int* p = (&a[1]);
+#line 11 "tests/cases/lvalues.sic"
+((*p) = 99);
+#line 12 "tests/cases/lvalues.sic"
+printf("%d\n", a[1]);
+#line 14 "tests/cases/lvalues.sic"
+div_t d = div(17, 5);
+#line 15 "tests/cases/lvalues.sic"
+printf("%d %d\n", d.quot, d.rem);
+#line 16 "tests/cases/lvalues.sic"
+div_t* dp = (&d);
+#line 17 "tests/cases/lvalues.sic"
+(dp->rem = 7);
+#line 18 "tests/cases/lvalues.sic"
+printf("%d\n", d.rem);
+#line 22 "tests/cases/lvalues.sic"
+int x;
+#line 23 "tests/cases/lvalues.sic"
+int y;
+#line 24 "tests/cases/lvalues.sic"
+(x = (y = 5));
+#line 25 "tests/cases/lvalues.sic"
+printf("%d %d\n", x, y);
+#line 26 "tests/cases/lvalues.sic"
+printf("%d\n", (x = 8));
+#line 29 "tests/cases/lvalues.sic"
+(a[0] += 1);
+#line 30 "tests/cases/lvalues.sic"
+printf("%d\n", a[0]);
+#line 31 "tests/cases/lvalues.sic"
+(dp->rem *= 3);
+#line 32 "tests/cases/lvalues.sic"
+printf("%d\n", d.rem);
+#line 33 "tests/cases/lvalues.sic"
+printf("%d\n", (x -= 3));
+#line 34 "tests/cases/lvalues.sic"
+return 0;
+}
@@ -0,0 +1,43 @@
+#line 1 "tests/cases/misc.sic"
+#include <stdio.h>
+#line 1 "tests/cases/misc.sic"
+#include <stddef.h>
+#line 3 "tests/cases/misc.sic"
+struct Flags {
+unsigned ready : 1;
+unsigned mode : 3;
+int count;
+};
+#line 4 "tests/cases/misc.sic"
+struct Pair {
+char a;
+long b;
+};
+#line 6 "tests/cases/misc.sic"
+int main(int argc, char** argv) {
+#line 7 "tests/cases/misc.sic"
+struct Flags f = {1, 5, 42};
+#line 8 "tests/cases/misc.sic"
+printf("%u %u %d\n", f.ready, f.mode, f.count);
+#line 10 "tests/cases/misc.sic"
+printf("%d\n", (offsetof(struct Pair, a) == 0));
+#line 11 "tests/cases/misc.sic"
+printf("%d\n", (offsetof(struct Pair, b) > 0));
+#line 12 "tests/cases/misc.sic"
+printf("%zu\n", _Alignof(char));
+#line 14 "tests/cases/misc.sic"
+int total = 0;
+#line 15 "tests/cases/misc.sic"
+int j = 10;
+#line 16 "tests/cases/misc.sic"
+for (
+#line 16 "tests/cases/misc.sic"
+int k = 0; (k < 3); ((++k) , (--j))) {
+#line 17 "tests/cases/misc.sic"
+(total += k);
+}
+#line 18 "tests/cases/misc.sic"
+printf("%d %d\n", total, j);
+#line 19 "tests/cases/misc.sic"
+return 0;
+}
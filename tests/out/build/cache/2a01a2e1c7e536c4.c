@@ -0,0 +1,9 @@
+#line 1 "tests/build/main.sic"
+#include "greet.h"
+#line 3 "tests/build/main.sic"
+int main() {
+#line 4 "tests/build/main.sic"
+greet("build");
+#line 5 "tests/build/main.sic"
+return 0;
+}
@@ -0,0 +1,9 @@
+#line 2 "tests/build/greet.sic"
+#include <stdio.h>
+#line 3 "tests/build/greet.sic"
+#include "greet.h"
+#line 5 "tests/build/greet.sic"
+int greet(const char* who) {
+#line 6 "tests/build/greet.sic"
+return printf("%s, %s\n", GREETING, who);
+}
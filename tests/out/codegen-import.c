@@ -0,0 +1,12 @@
+#include <stddef.h>
+#define VEC_DIMS 3
+struct Vec {
+int x;
+int y;
+int z;
+};
+typedef struct Vec Vec;
+int vec_sum(Vec* v);
+int twice(Vec* v) {
+return (2 * vec_sum(v));
+}
@@ -0,0 +1,23 @@
+#line 1 "tests/out/gensyms-moved.sic"
+int unused() {
+#line 1 "tests/out/gensyms-moved.sic"
+return 0;
+}
+#line 3 "tests/out/gensyms-moved.sic"
+int main() {
+#line 3 "tests/out/gensyms-moved.sic"
+int x = 1;
+#line 3 "tests/out/gensyms-moved.sic"
+int y = 2;
+#line 3 "tests/out/gensyms-moved.sic"
+{
+#line 3 "tests/out/gensyms-moved.sic"
+int t__0c2f7152_0 = x;
+#line 3 "tests/out/gensyms-moved.sic"
+(x = y);
+#line 3 "tests/out/gensyms-moved.sic"
+(y = t__0c2f7152_0);
+}
+#line 3 "tests/out/gensyms-moved.sic"
+return x;
+}
@@ -0,0 +1,9 @@
+#line 2 "tests/out/gensyms-twice.sic"
+int counter__68bacfda_0 = 0;
+#line 3 "tests/out/gensyms-twice.sic"
+int counter__68bacfda_1_0 = 0;
+#line 4 "tests/out/gensyms-twice.sic"
+int main() {
+#line 4 "tests/out/gensyms-twice.sic"
+return 0;
+}
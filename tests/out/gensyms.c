@@ -0,0 +1,18 @@
+#line 2 "tests/out/gensyms.sic"
+int main() {
+#line 2 "tests/out/gensyms.sic"
+int x = 1;
+#line 2 "tests/out/gensyms.sic"
+int y = 2;
+#line 2 "tests/out/gensyms.sic"
+{
+#line 2 "tests/out/gensyms.sic"
+int t__0c2f7152_0 = x;
+#line 2 "tests/out/gensyms.sic"
+(x = y);
+#line 2 "tests/out/gensyms.sic"
+(y = t__0c2f7152_0);
+}
+#line 2 "tests/out/gensyms.sic"
+return x;
+}
@@ -0,0 +1,49 @@
+#line 2 "/root/repo/tests/out/header/modules/vec.sic"
+#include <stddef.h>
+#line 3 "/root/repo/tests/out/header/modules/vec.sic"
+#define VEC_DIMS 3
+#line 5 "/root/repo/tests/out/header/modules/vec.sic"
+struct Vec {
+int x;
+int y;
+int z;
+};
+#line 6 "/root/repo/tests/out/header/modules/vec.sic"
+typedef struct Vec Vec;
+#line 12 "/root/repo/tests/out/header/modules/vec.sic"
+int vec_sum(Vec* v);
+#line 4 "tests/out/header/header/shapes.sic"
+#include <stdio.h>
+#line 5 "tests/out/header/header/shapes.sic"
+#define SHAPES_MAX 8
+#line 7 "tests/out/header/header/shapes.sic"
+enum Kind {
+KIND_SQUARE,
+KIND_CIRCLE,
+};
+#line 8 "tests/out/header/header/shapes.sic"
+struct Shape {
+enum Kind kind;
+int size;
+};
+#line 9 "tests/out/header/header/shapes.sic"
+typedef struct Shape Shape;
+#line 13 "tests/out/header/header/shapes.sic"
+int shape_area(Shape* s) {
+#line 14 "tests/out/header/header/shapes.sic"
+return (s->size * s->size);
+}
+#line 16 "tests/out/header/header/shapes.sic"
+void shape_print(Shape* s) {
+#line 17 "tests/out/header/header/shapes.sic"
+printf("%d\n", (2 * shape_area(s)));
+}
+#line 19 "tests/out/header/header/shapes.sic"
+int main() {
+#line 20 "tests/out/header/header/shapes.sic"
+Shape s = {KIND_SQUARE, 3};
+#line 21 "tests/out/header/header/shapes.sic"
+shape_print((&s));
+#line 22 "tests/out/header/header/shapes.sic"
+return 0;
+}
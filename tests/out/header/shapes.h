@@ -0,0 +1,25 @@
+#ifndef SHAPES_H
+#define SHAPES_H
+#include <stddef.h>
+#define VEC_DIMS 3
+struct Vec {
+int x;
+int y;
+int z;
+};
+typedef struct Vec Vec;
+int vec_sum(Vec* v);
+#include <stdio.h>
+#define SHAPES_MAX 8
+enum Kind {
+KIND_SQUARE,
+KIND_CIRCLE,
+};
+struct Shape {
+enum Kind kind;
+int size;
+};
+typedef struct Shape Shape;
+int shape_area(Shape* s);
+void shape_print(Shape* s);
+#endif
@@ -0,0 +1,27 @@
+#line 1 "tests/cases/prototypes.sic"
+#include <stdio.h>
+#line 3 "tests/cases/prototypes.sic"
+int is_odd(int n);
+#line 5 "tests/cases/prototypes.sic"
+int is_even(int n) {
+#line 6 "tests/cases/prototypes.sic"
+return ((n == 0) ? 1 : is_odd((n - 1)));
+}
+#line 8 "tests/cases/prototypes.sic"
+int is_odd(int n) {
+#line 9 "tests/cases/prototypes.sic"
+return ((n == 0) ? 0 : is_even((n - 1)));
+}
+#line 11 "tests/cases/prototypes.sic"
+extern int counter;
+#line 12 "tests/cases/prototypes.sic"
+int counter = 40;
+#line 14 "tests/cases/prototypes.sic"
+int main(int argc, char** argv) {
+#line 15 "tests/cases/prototypes.sic"
+printf("%d %d\n", is_even(10), is_odd(7));
+#line 16 "tests/cases/prototypes.sic"
+printf("%d\n", counter);
+#line 17 "tests/cases/prototypes.sic"
+return 0;
+}
@@ -0,0 +1,52 @@
+#line 1 "examples/aoc_24_1.sic"
+#include <stdio.h>
+#line 2 "examples/aoc_24_1.sic"
+#include <stdlib.h>
+#line 3 "examples/aoc_24_1.sic"
+#include <string.h>
+#line 6 "examples/aoc_24_1.sic"
+int compare(const void* a, const void* b) {
+#line 7 "examples/aoc_24_1.sic"
+return (*(((const int*)a)) - *(((const int*)b)));
+}
+#line 10 "examples/aoc_24_1.sic"
+int main(int argc, char** argv) {
+#line 11 "examples/aoc_24_1.sic"
+char line[1024];
+#line 12 "examples/aoc_24_1.sic"
+int list1[8096];
+#line 13 "examples/aoc_24_1.sic"
+int list2[8096];
+#line 14 "examples/aoc_24_1.sic"
+int count = 0;
+#line 16 "examples/aoc_24_1.sic"
+while (fgets(line, 1024, stdin) != NULL) {
+#line 17 "examples/aoc_24_1.sic"
+char* token1 = strtok(line, " ");
+#line 18 "examples/aoc_24_1.sic"
+(list1[count] = atoi(token1));
+#line 19 "examples/aoc_24_1.sic"
+char* token2 = strtok(NULL, " ");
+#line 20 "examples/aoc_24_1.sic"
+(list2[count] = atoi(token2));
+#line 21 "examples/aoc_24_1.sic"
+(++count);
+}
+#line 23 "examples/aoc_24_1.sic"
+qsort(list1, count, sizeof(int), compare);
+#line 24 "examples/aoc_24_1.sic"
+qsort(list2, count, sizeof(int), compare);
+#line 26 "examples/aoc_24_1.sic"
+int sum = 0;
+#line 27 "examples/aoc_24_1.sic"
+for (
+#line 27 "examples/aoc_24_1.sic"
+int i = 0; (i < count); (++i)) {
+#line 30 "examples/aoc_24_1.sic"
+(sum += abs((list1[i] - list2[i])));
+}
+#line 32 "examples/aoc_24_1.sic"
+printf("%d\n", sum);
+#line 34 "examples/aoc_24_1.sic"
+return 0;
+}
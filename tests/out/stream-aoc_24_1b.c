@@ -0,0 +1,56 @@
+#line 2 "examples/aoc_24_1b.sic"
+#include <stdio.h>
+#line 2 "examples/aoc_24_1b.sic"
+#include <stdlib.h>
+#line 2 "examples/aoc_24_1b.sic"
+#include <string.h>
+#line 4 "examples/aoc_24_1b.sic"
+int count_of(int needle, const int* list, int n) {
+#line 5 "examples/aoc_24_1b.sic"
+int count = 0;
+#line 6 "examples/aoc_24_1b.sic"
+for (
+#line 6 "examples/aoc_24_1b.sic"
+int i = 0; (i < n); (++i)) {
+#line 7 "examples/aoc_24_1b.sic"
+if (list[i] == needle) {
+#line 8 "examples/aoc_24_1b.sic"
+(++count);
+}
+}
+#line 9 "examples/aoc_24_1b.sic"
+return count;
+}
+#line 11 "examples/aoc_24_1b.sic"
+int main(int argc, char** argv) {
+#line 12 "examples/aoc_24_1b.sic"
+char line[1024];
+#line 13 "examples/aoc_24_1b.sic"
+int list1[8096];
+#line 14 "examples/aoc_24_1b.sic"
+int list2[8096];
+#line 15 "examples/aoc_24_1b.sic"
+int count = 0;
+#line 17 "examples/aoc_24_1b.sic"
+while (fgets(line, 1024, stdin) != NULL) {
+#line 18 "examples/aoc_24_1b.sic"
+(list1[count] = atoi(strtok(line, " ")));
+#line 19 "examples/aoc_24_1b.sic"
+(list2[count] = atoi(strtok(NULL, " ")));
+#line 20 "examples/aoc_24_1b.sic"
+(++count);
+}
+#line 22 "examples/aoc_24_1b.sic"
+long score = 0;
+#line 23 "examples/aoc_24_1b.sic"
+for (
+#line 23 "examples/aoc_24_1b.sic"
+int i = 0; (i < count); (++i)) {
+#line 24 "examples/aoc_24_1b.sic"
+(score += (list1[i] * count_of(list1[i], list2, count)));
+}
+#line 26 "examples/aoc_24_1b.sic"
+printf("%ld\n", score);
+#line 27 "examples/aoc_24_1b.sic"
+return 0;
+}
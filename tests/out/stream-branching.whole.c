@@ -0,0 +1,34 @@
+#line 1 "tests/cases/branching.sic"
+#include <stdio.h>
+#line 3 "tests/cases/branching.sic"
+int main(int argc, char** argv) {
+#line 4 "tests/cases/branching.sic"
+for (
+#line 4 "tests/cases/branching.sic"
+int i = 0; (i < 5); (++i)) {
+#line 5 "tests/cases/branching.sic"
+if (i == 2) {
+#line 6 "tests/cases/branching.sic"
+printf("two\n");
+} else {
+#line 7 "tests/cases/branching.sic"
+{
+#line 8 "tests/cases/branching.sic"
+printf("%d", i);
+#line 9 "tests/cases/branching.sic"
+printf("\n");
+}
+}
+}
+#line 11 "tests/cases/branching.sic"
+if (1 < 2) {
+#line 12 "tests/cases/branching.sic"
+printf("ordered\n");
+}
+#line 14 "tests/cases/branching.sic"
+int big = ((10 > 5) ? 1 : 0);
+#line 15 "tests/cases/branching.sic"
+printf("big=%d\n", big);
+#line 16 "tests/cases/branching.sic"
+return 0;
+}
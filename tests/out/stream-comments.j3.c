@@ -0,0 +1,9 @@
+#line 2 "tests/cases/comments.sic"
+#include <stdio.h>
+#line 4 "tests/cases/comments.sic"
+int main(int argc, char** argv) {
+#line 6 "tests/cases/comments.sic"
+printf("%d\n", 42);
+#line 7 "tests/cases/comments.sic"
+return 0;
+}
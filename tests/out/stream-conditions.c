@@ -0,0 +1,46 @@
+#line 5 "tests/codegen/conditions.sic"
+int check(int a, int b, int c, int d) {
+#line 6 "tests/codegen/conditions.sic"
+if (a == b) {
+#line 6 "tests/codegen/conditions.sic"
+return 1;
+}
+#line 7 "tests/codegen/conditions.sic"
+if ((a == b) && (c < d)) {
+#line 7 "tests/codegen/conditions.sic"
+return 2;
+}
+#line 8 "tests/codegen/conditions.sic"
+if (!c) {
+#line 8 "tests/codegen/conditions.sic"
+return 3;
+}
+#line 9 "tests/codegen/conditions.sic"
+while (a != b) {
+#line 9 "tests/codegen/conditions.sic"
+(++a);
+}
+#line 10 "tests/codegen/conditions.sic"
+do {
+#line 10 "tests/codegen/conditions.sic"
+(++a);
+} while (a == b);
+#line 11 "tests/codegen/conditions.sic"
+for (
+#line 11 "tests/codegen/conditions.sic"
+int i = 0; (i == c); (++i)) {
+#line 11 "tests/codegen/conditions.sic"
+(++b);
+}
+#line 12 "tests/codegen/conditions.sic"
+int t = ((a == b) ? 1 : 0);
+#line 13 "tests/codegen/conditions.sic"
+int e = (a == b);
+#line 14 "tests/codegen/conditions.sic"
+if (a) {
+#line 14 "tests/codegen/conditions.sic"
+return 4;
+}
+#line 15 "tests/codegen/conditions.sic"
+return t;
+}
@@ -0,0 +1,13 @@
+#line 3 "tests/codegen/cuda-launch.sic"
+void go(int n, cudaStream_t stream, void (*k)(int)) {
+#line 4 "tests/codegen/cuda-launch.sic"
+add<<<blocks, threads>>>(n, 2.0f, d_x, d_y);
+#line 5 "tests/codegen/cuda-launch.sic"
+add<<<dim3(16, 16), dim3(8, 8)>>>(n);
+#line 6 "tests/codegen/cuda-launch.sic"
+reduce<<<grid, block, (n * sizeof(float))>>>(d_in, d_out);
+#line 7 "tests/codegen/cuda-launch.sic"
+reduce<<<grid, block, 0, stream>>>(d_in, d_out);
+#line 8 "tests/codegen/cuda-launch.sic"
+k<<<1, n>>>();
+}
@@ -0,0 +1,18 @@
+#line 3 "tests/codegen/cuda-qualifiers.sic"
+__global__ void add(float* out, float* a, float* b) {
+#line 4 "tests/codegen/cuda-qualifiers.sic"
+int i = ((blockIdx.x * blockDim.x) + threadIdx.x);
+#line 5 "tests/codegen/cuda-qualifiers.sic"
+(out[i] = (a[i] + b[i]));
+}
+#line 7 "tests/codegen/cuda-qualifiers.sic"
+__device__ float smooth(float* v) {
+#line 8 "tests/codegen/cuda-qualifiers.sic"
+__shared__ float tile[256];
+#line 9 "tests/codegen/cuda-qualifiers.sic"
+(tile[threadIdx.x] = v[threadIdx.x]);
+#line 10 "tests/codegen/cuda-qualifiers.sic"
+__syncthreads();
+#line 11 "tests/codegen/cuda-qualifiers.sic"
+return tile[threadIdx.x];
+}
@@ -0,0 +1,19 @@
+#line 2 "/root/repo/tests/modules/vec.sic"
+#include <stddef.h>
+#line 3 "/root/repo/tests/modules/vec.sic"
+#define VEC_DIMS 3
+#line 5 "/root/repo/tests/modules/vec.sic"
+struct Vec {
+int x;
+int y;
+int z;
+};
+#line 6 "/root/repo/tests/modules/vec.sic"
+typedef struct Vec Vec;
+#line 12 "/root/repo/tests/modules/vec.sic"
+int vec_sum(Vec* v);
+#line 5 "tests/codegen/import.sic"
+int twice(Vec* v) {
+#line 6 "tests/codegen/import.sic"
+return (2 * vec_sum(v));
+}
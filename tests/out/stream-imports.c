@@ -0,0 +1,59 @@
+#line 2 "/root/repo/tests/modules/vec.sic"
+#include <stddef.h>
+#line 3 "/root/repo/tests/modules/vec.sic"
+#define VEC_DIMS 3
+#line 5 "/root/repo/tests/modules/vec.sic"
+struct Vec {
+int x;
+int y;
+int z;
+};
+#line 6 "/root/repo/tests/modules/vec.sic"
+typedef struct Vec Vec;
+#line 12 "/root/repo/tests/modules/vec.sic"
+int vec_sum(Vec* v);
+#line 3 "/root/repo/tests/modules/prelude.sic"
+#include <stdio.h>
+#line 16 "/root/repo/tests/modules/prelude.sic"
+enum Axis {
+AXIS_X,
+AXIS_Y,
+AXIS_Z,
+};
+#line 6 "tests/cases/imports.sic"
+int vec_sum(Vec* v) {
+#line 7 "tests/cases/imports.sic"
+return (v->x + v->y + v->z);
+}
+#line 9 "tests/cases/imports.sic"
+int main() {
+#line 10 "tests/cases/imports.sic"
+Vec v = {1, 2, 3};
+#line 11 "tests/cases/imports.sic"
+int a = 4;
+#line 12 "tests/cases/imports.sic"
+int b = 5;
+#line 13 "tests/cases/imports.sic"
+if (a < b) {
+#line 13 "tests/cases/imports.sic"
+{
+#line 14 "tests/cases/imports.sic"
+{
+#line 14 "tests/cases/imports.sic"
+int tmp__928ae644_0 = a;
+#line 14 "tests/cases/imports.sic"
+(a = b);
+#line 14 "tests/cases/imports.sic"
+(b = tmp__928ae644_0);
+}
+#line 15 "tests/cases/imports.sic"
+printf("%d %d\n", a, b);
+}
+}
+#line 16 "tests/cases/imports.sic"
+printf("%d %d\n", ((v.x * v.x) + (v.y * v.y) + (v.z * v.z)), vec_sum((&v)));
+#line 17 "tests/cases/imports.sic"
+printf("%d %d\n", VEC_DIMS, AXIS_Z);
+#line 18 "tests/cases/imports.sic"
+return 0;
+}
@@ -0,0 +1,40 @@
+#line 1 "tests/cases/initializers.sic"
+#include <stdio.h>
+#line 3 "tests/cases/initializers.sic"
+struct Point {
+int x;
+int y;
+};
+#line 5 "tests/cases/initializers.sic"
+struct Point origin = {0, 0};
+#line 7 "tests/cases/initializers.sic"
+int main(int argc, char** argv) {
+#line 8 "tests/cases/initializers.sic"
+int a[3] = {1, 2, 3};
+#line 9 "tests/cases/initializers.sic"
+int b[] = {4, 5, 6, 7};
+#line 10 "tests/cases/initializers.sic"
+printf("%d %d %zu\n", a[1], b[3], (sizeof(b) / sizeof(int)));
+#line 12 "tests/cases/initializers.sic"
+struct Point p = {7, 8};
+#line 13 "tests/cases/initializers.sic"
+struct Point q = {.y = 9};
+#line 14 "tests/cases/initializers.sic"
+printf("%d %d %d %d\n", p.x, p.y, q.y, q.x);
+#line 16 "tests/cases/initializers.sic"
+int m[2][2] = {{1, 2}, {3, 4}};
+#line 17 "tests/cases/initializers.sic"
+printf("%d\n", m[1][0]);
+#line 19 "tests/cases/initializers.sic"
+int zeroed[100] = {0};
+#line 20 "tests/cases/initializers.sic"
+printf("%d %d\n", zeroed[0], zeroed[99]);
+#line 22 "tests/cases/initializers.sic"
+(p = ((struct Point){40, 2}));
+#line 23 "tests/cases/initializers.sic"
+printf("%d\n", (p.x + p.y));
+#line 24 "tests/cases/initializers.sic"
+printf("%d\n", origin.x);
+#line 25 "tests/cases/initializers.sic"
+return 0;
+}
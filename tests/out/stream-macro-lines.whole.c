@@ -0,0 +1,15 @@
+#line 5 "tests/codegen/macro-lines.sic"
+int f(int x) {
+#line 6 "tests/codegen/macro-lines.sic"
+if (x > 0) {
+#line 6 "tests/codegen/macro-lines.sic"
+{
+#line 7 "tests/codegen/macro-lines.sic"
+printf("positive\n");
+#line 8 "tests/codegen/macro-lines.sic"
+printf("%d\n", x);
+}
+}
+#line 9 "tests/codegen/macro-lines.sic"
+return x;
+}
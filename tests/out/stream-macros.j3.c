@@ -0,0 +1,65 @@
+#line 2 "tests/cases/macros.sic"
+#include <stdio.h>
+#line 21 "tests/cases/macros.sic"
+int main() {
+#line 22 "tests/cases/macros.sic"
+int x = 3;
+#line 23 "tests/cases/macros.sic"
+int y = 8;
+#line 25 "tests/cases/macros.sic"
+if (x < y) {
+#line 25 "tests/cases/macros.sic"
+{
+#line 26 "tests/cases/macros.sic"
+printf("x is smaller\n");
+#line 27 "tests/cases/macros.sic"
+printf("still here\n");
+}
+}
+#line 29 "tests/cases/macros.sic"
+if (!(x > y)) {
+#line 29 "tests/cases/macros.sic"
+{
+#line 30 "tests/cases/macros.sic"
+printf("not bigger\n");
+}
+}
+#line 32 "tests/cases/macros.sic"
+{
+#line 32 "tests/cases/macros.sic"
+int tmp__c00d7c26_0 = x;
+#line 32 "tests/cases/macros.sic"
+(x = y);
+#line 32 "tests/cases/macros.sic"
+(y = tmp__c00d7c26_0);
+}
+#line 33 "tests/cases/macros.sic"
+printf("%d %d\n", x, y);
+#line 36 "tests/cases/macros.sic"
+int tmp = 99;
+#line 37 "tests/cases/macros.sic"
+{
+#line 37 "tests/cases/macros.sic"
+int tmp__c00d7c26_1 = x;
+#line 37 "tests/cases/macros.sic"
+(x = y);
+#line 37 "tests/cases/macros.sic"
+(y = tmp__c00d7c26_1);
+}
+#line 38 "tests/cases/macros.sic"
+printf("tmp is %d\n", tmp);
+#line 41 "tests/cases/macros.sic"
+printf("%d\n", ((x + 1) * (x + 1)));
+#line 43 "tests/cases/macros.sic"
+if (x < 100) {
+#line 43 "tests/cases/macros.sic"
+{
+#line 43 "tests/cases/macros.sic"
+(++x);
+}
+}
+#line 44 "tests/cases/macros.sic"
+printf("%d\n", x);
+#line 45 "tests/cases/macros.sic"
+return 0;
+}
@@ -0,0 +1,45 @@
+#line 1 "tests/cases/operators.sic"
+#include <stdio.h>
+#line 3 "tests/cases/operators.sic"
+int main(int argc, char** argv) {
+#line 4 "tests/cases/operators.sic"
+printf("%d\n", (17 % 5));
+#line 5 "tests/cases/operators.sic"
+printf("%d\n", ((1 < 2) && (2 > 1)));
+#line 6 "tests/cases/operators.sic"
+printf("%d\n", (0 || 0));
+#line 7 "tests/cases/operators.sic"
+printf("%d\n", (!0));
+#line 8 "tests/cases/operators.sic"
+printf("%d\n", (12 & 10));
+#line 9 "tests/cases/operators.sic"
+printf("%d\n", (12 | 10));
+#line 10 "tests/cases/operators.sic"
+printf("%d\n", (12 ^ 10));
+#line 11 "tests/cases/operators.sic"
+printf("%d\n", (~-9));
+#line 12 "tests/cases/operators.sic"
+printf("%d\n", (1 << 4));
+#line 13 "tests/cases/operators.sic"
+printf("%d\n", (32 >> 2));
+#line 14 "tests/cases/operators.sic"
+printf("%d\n", (-5));
+#line 16 "tests/cases/operators.sic"
+int x = 3;
+#line 17 "tests/cases/operators.sic"
+int* p = (&x);
+#line 18 "tests/cases/operators.sic"
+(x = ((*p) + 4));
+#line 19 "tests/cases/operators.sic"
+printf("%d\n", x);
+#line 21 "tests/cases/operators.sic"
+(++x);
+#line 22 "tests/cases/operators.sic"
+(--x);
+#line 23 "tests/cases/operators.sic"
+(x %= 5);
+#line 24 "tests/cases/operators.sic"
+printf("%d\n", x);
+#line 25 "tests/cases/operators.sic"
+return 0;
+}
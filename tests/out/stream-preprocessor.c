@@ -0,0 +1,48 @@
+#line 1 "tests/cases/preprocessor.sic"
+#include <stdio.h>
+#line 3 "tests/cases/preprocessor.sic"
+#define MAX 3
+#line 4 "tests/cases/preprocessor.sic"
+#define SQR(x) (x * x)
+#line 5 "tests/cases/preprocessor.sic"
+#define VERBOSE
+#line 6 "tests/cases/preprocessor.sic"
+#define BIG (4 * 1024)
+#line 8 "tests/cases/preprocessor.sic"
+int main(int argc, char** argv) {
+#line 9 "tests/cases/preprocessor.sic"
+int total = 0;
+#line 10 "tests/cases/preprocessor.sic"
+for (
+#line 10 "tests/cases/preprocessor.sic"
+int i = 0; (i < MAX); (++i)) {
+#line 11 "tests/cases/preprocessor.sic"
+(total += SQR((i + 1)));
+}
+#line 12 "tests/cases/preprocessor.sic"
+printf("%d\n", total);
+#line 13 "tests/cases/preprocessor.sic"
+printf("%d\n", BIG);
+#line 15 "tests/cases/preprocessor.sic"
+#ifdef VERBOSE
+#line 16 "tests/cases/preprocessor.sic"
+printf("verbose\n");
+#else
+#line 18 "tests/cases/preprocessor.sic"
+printf("quiet\n");
+#endif
+#line 20 "tests/cases/preprocessor.sic"
+#undef VERBOSE
+#line 21 "tests/cases/preprocessor.sic"
+#ifndef VERBOSE
+#line 22 "tests/cases/preprocessor.sic"
+printf("undefined now\n");
+#endif
+#line 24 "tests/cases/preprocessor.sic"
+#if (MAX >= 3)
+#line 25 "tests/cases/preprocessor.sic"
+printf("big enough\n");
+#endif
+#line 26 "tests/cases/preprocessor.sic"
+return 0;
+}
@@ -0,0 +1,49 @@
+#line 1 "tests/cases/records.sic"
+#include <stdio.h>
+#line 3 "tests/cases/records.sic"
+struct Point {
+int x;
+int y;
+};
+#line 4 "tests/cases/records.sic"
+typedef struct Point Point;
+#line 6 "tests/cases/records.sic"
+enum Color {
+RED,
+GREEN,
+BLUE = 5,
+};
+#line 8 "tests/cases/records.sic"
+union Word {
+int i;
+char c[4];
+};
+#line 10 "tests/cases/records.sic"
+typedef int Vec[3];
+#line 12 "tests/cases/records.sic"
+int main(int argc, char** argv) {
+#line 13 "tests/cases/records.sic"
+Point p;
+#line 14 "tests/cases/records.sic"
+(p.x = 3);
+#line 15 "tests/cases/records.sic"
+(p.y = 4);
+#line 16 "tests/cases/records.sic"
+printf("%d %d\n", p.x, p.y);
+#line 18 "tests/cases/records.sic"
+Point* pp = (&p);
+#line 19 "tests/cases/records.sic"
+printf("%d\n", pp->y);
+#line 21 "tests/cases/records.sic"
+printf("%d %d %d\n", RED, GREEN, BLUE);
+#line 22 "tests/cases/records.sic"
+printf("%zu\n", sizeof(union Word));
+#line 24 "tests/cases/records.sic"
+Vec v;
+#line 25 "tests/cases/records.sic"
+(v[2] = 7);
+#line 26 "tests/cases/records.sic"
+printf("%d\n", v[2]);
+#line 27 "tests/cases/records.sic"
+return 0;
+}
@@ -0,0 +1,191 @@
+#line 3 "examples/saxpy.cu.sic"
+#include <stdio.h>
+#line 3 "examples/saxpy.cu.sic"
+#include <stdlib.h>
+#line 11 "examples/saxpy.cu.sic"
+__global__ void saxpy(int n, float a, float* x, float* y) {
+#line 12 "examples/saxpy.cu.sic"
+int i = ((blockIdx.x * blockDim.x) + threadIdx.x);
+#line 13 "examples/saxpy.cu.sic"
+if (i < n) {
+#line 14 "examples/saxpy.cu.sic"
+(y[i] = ((a * x[i]) + y[i]));
+}
+}
+#line 16 "examples/saxpy.cu.sic"
+int main() {
+#line 17 "examples/saxpy.cu.sic"
+int n = 1048576;
+#line 18 "examples/saxpy.cu.sic"
+size_t bytes = (n * sizeof(float));
+#line 20 "examples/saxpy.cu.sic"
+float* x = ((float*)malloc(bytes));
+#line 21 "examples/saxpy.cu.sic"
+float* y = ((float*)malloc(bytes));
+#line 22 "examples/saxpy.cu.sic"
+for (
+#line 22 "examples/saxpy.cu.sic"
+int i = 0; (i < n); (++i)) {
+#line 23 "examples/saxpy.cu.sic"
+(x[i] = 1.0f);
+#line 24 "examples/saxpy.cu.sic"
+(y[i] = 2.0f);
+}
+#line 26 "examples/saxpy.cu.sic"
+float* d_x = NULL;
+#line 27 "examples/saxpy.cu.sic"
+float* d_y = NULL;
+#line 28 "examples/saxpy.cu.sic"
+{
+#line 28 "examples/saxpy.cu.sic"
+cudaError_t err__1b1cf1c2_0 = cudaMalloc((&d_x), bytes);
+#line 28 "examples/saxpy.cu.sic"
+if (err__1b1cf1c2_0 != cudaSuccess) {
+#line 28 "examples/saxpy.cu.sic"
+{
+#line 28 "examples/saxpy.cu.sic"
+printf("cuda error: %s\n", cudaGetErrorString(err__1b1cf1c2_0));
+#line 28 "examples/saxpy.cu.sic"
+exit(1);
+}
+}
+}
+#line 29 "examples/saxpy.cu.sic"
+{
+#line 29 "examples/saxpy.cu.sic"
+cudaError_t err__1b1cf1c2_1 = cudaMalloc((&d_y), bytes);
+#line 29 "examples/saxpy.cu.sic"
+if (err__1b1cf1c2_1 != cudaSuccess) {
+#line 29 "examples/saxpy.cu.sic"
+{
+#line 29 "examples/saxpy.cu.sic"
+printf("cuda error: %s\n", cudaGetErrorString(err__1b1cf1c2_1));
+#line 29 "examples/saxpy.cu.sic"
+exit(1);
+}
+}
+}
+#line 30 "examples/saxpy.cu.sic"
+{
+#line 30 "examples/saxpy.cu.sic"
+cudaError_t err__1b1cf1c2_2 = cudaMemcpy(d_x, x, bytes, cudaMemcpyHostToDevice);
+#line 30 "examples/saxpy.cu.sic"
+if (err__1b1cf1c2_2 != cudaSuccess) {
+#line 30 "examples/saxpy.cu.sic"
+{
+#line 30 "examples/saxpy.cu.sic"
+printf("cuda error: %s\n", cudaGetErrorString(err__1b1cf1c2_2));
+#line 30 "examples/saxpy.cu.sic"
+exit(1);
+}
+}
+}
+#line 31 "examples/saxpy.cu.sic"
+{
+#line 31 "examples/saxpy.cu.sic"
+cudaError_t err__1b1cf1c2_3 = cudaMemcpy(d_y, y, bytes, cudaMemcpyHostToDevice);
+#line 31 "examples/saxpy.cu.sic"
+if (err__1b1cf1c2_3 != cudaSuccess) {
+#line 31 "examples/saxpy.cu.sic"
+{
+#line 31 "examples/saxpy.cu.sic"
+printf("cuda error: %s\n", cudaGetErrorString(err__1b1cf1c2_3));
+#line 31 "examples/saxpy.cu.sic"
+exit(1);
+}
+}
+}
+#line 33 "examples/saxpy.cu.sic"
+int threads = 256;
+#line 34 "examples/saxpy.cu.sic"
+int blocks = ((n + (threads - 1)) / threads);
+#line 35 "examples/saxpy.cu.sic"
+saxpy<<<blocks, threads>>>(n, 2.0f, d_x, d_y);
+#line 36 "examples/saxpy.cu.sic"
+{
+#line 36 "examples/saxpy.cu.sic"
+cudaError_t err__1b1cf1c2_4 = cudaGetLastError();
+#line 36 "examples/saxpy.cu.sic"
+if (err__1b1cf1c2_4 != cudaSuccess) {
+#line 36 "examples/saxpy.cu.sic"
+{
+#line 36 "examples/saxpy.cu.sic"
+printf("cuda error: %s\n", cudaGetErrorString(err__1b1cf1c2_4));
+#line 36 "examples/saxpy.cu.sic"
+exit(1);
+}
+}
+}
+#line 37 "examples/saxpy.cu.sic"
+{
+#line 37 "examples/saxpy.cu.sic"
+cudaError_t err__1b1cf1c2_5 = cudaMemcpy(y, d_y, bytes, cudaMemcpyDeviceToHost);
+#line 37 "examples/saxpy.cu.sic"
+if (err__1b1cf1c2_5 != cudaSuccess) {
+#line 37 "examples/saxpy.cu.sic"
+{
+#line 37 "examples/saxpy.cu.sic"
+printf("cuda error: %s\n", cudaGetErrorString(err__1b1cf1c2_5));
+#line 37 "examples/saxpy.cu.sic"
+exit(1);
+}
+}
+}
+#line 39 "examples/saxpy.cu.sic"
+float max_err = 0.0f;
+#line 40 "examples/saxpy.cu.sic"
+for (
+#line 40 "examples/saxpy.cu.sic"
+int i = 0; (i < n); (++i)) {
+#line 41 "examples/saxpy.cu.sic"
+float err = (y[i] - 4.0f);
+#line 42 "examples/saxpy.cu.sic"
+if (err < 0.0f) {
+#line 42 "examples/saxpy.cu.sic"
+(err = (-err));
+}
+#line 43 "examples/saxpy.cu.sic"
+if (err > max_err) {
+#line 43 "examples/saxpy.cu.sic"
+(max_err = err);
+}
+}
+#line 44 "examples/saxpy.cu.sic"
+printf("max error: %f\n", max_err);
+#line 46 "examples/saxpy.cu.sic"
+{
+#line 46 "examples/saxpy.cu.sic"
+cudaError_t err__1b1cf1c2_6 = cudaFree(d_x);
+#line 46 "examples/saxpy.cu.sic"
+if (err__1b1cf1c2_6 != cudaSuccess) {
+#line 46 "examples/saxpy.cu.sic"
+{
+#line 46 "examples/saxpy.cu.sic"
+printf("cuda error: %s\n", cudaGetErrorString(err__1b1cf1c2_6));
+#line 46 "examples/saxpy.cu.sic"
+exit(1);
+}
+}
+}
+#line 47 "examples/saxpy.cu.sic"
+{
+#line 47 "examples/saxpy.cu.sic"
+cudaError_t err__1b1cf1c2_7 = cudaFree(d_y);
+#line 47 "examples/saxpy.cu.sic"
+if (err__1b1cf1c2_7 != cudaSuccess) {
+#line 47 "examples/saxpy.cu.sic"
+{
+#line 47 "examples/saxpy.cu.sic"
+printf("cuda error: %s\n", cudaGetErrorString(err__1b1cf1c2_7));
+#line 47 "examples/saxpy.cu.sic"
+exit(1);
+}
+}
+}
+#line 48 "examples/saxpy.cu.sic"
+free(x);
+#line 49 "examples/saxpy.cu.sic"
+free(y);
+#line 50 "examples/saxpy.cu.sic"
+return 0;
+}
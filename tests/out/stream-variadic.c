@@ -0,0 +1,35 @@
+#line 1 "tests/cases/variadic.sic"
+#include <stdio.h>
+#line 1 "tests/cases/variadic.sic"
+#include <stdarg.h>
+#line 3 "tests/cases/variadic.sic"
+int sum(int n, ...);
+#line 5 "tests/cases/variadic.sic"
+int sum(int n, ...) {
+#line 6 "tests/cases/variadic.sic"
+va_list ap;
+#line 7 "tests/cases/variadic.sic"
+va_start(ap, n);
+#line 8 "tests/cases/variadic.sic"
+int total = 0;
+#line 9 "tests/cases/variadic.sic"
+for (
+#line 9 "tests/cases/variadic.sic"
+int i = 0; (i < n); (++i)) {
+#line 10 "tests/cases/variadic.sic"
+(total += va_arg(ap, int));
+}
+#line 11 "tests/cases/variadic.sic"
+va_end(ap);
+#line 12 "tests/cases/variadic.sic"
+return total;
+}
+#line 14 "tests/cases/variadic.sic"
+int main(int argc, char** argv) {
+#line 15 "tests/cases/variadic.sic"
+printf("%d\n", sum(3, 10, 20, 30));
+#line 16 "tests/cases/variadic.sic"
+printf("%d\n", sum(0));
+#line 17 "tests/cases/variadic.sic"
+return 0;
+}
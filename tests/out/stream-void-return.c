@@ -0,0 +1,21 @@
+#line 1 "tests/cases/void-return.sic"
+#include <stdio.h>
+#line 3 "tests/cases/void-return.sic"
+void maybe(int n) {
+#line 4 "tests/cases/void-return.sic"
+if (n < 0) {
+#line 4 "tests/cases/void-return.sic"
+return;
+}
+#line 5 "tests/cases/void-return.sic"
+printf("%d\n", n);
+}
+#line 7 "tests/cases/void-return.sic"
+int main(int argc, char** argv) {
+#line 8 "tests/cases/void-return.sic"
+maybe(-1);
+#line 9 "tests/cases/void-return.sic"
+maybe(3);
+#line 10 "tests/cases/void-return.sic"
+return 0;
+}
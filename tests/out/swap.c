@@ -0,0 +1,20 @@
+#line 7 "tests/map/swap.sic"
+int main() {
+#line 8 "tests/map/swap.sic"
+int x = 1;
+#line 9 "tests/map/swap.sic"
+int y = 2;
+#line 10 "tests/map/swap.sic"
+{
+#line 10 "tests/map/swap.sic"
+int tmp = x;
+#line 10 "tests/map/swap.sic"
+(x = y);
+#line 10 "tests/map/swap.sic"
+(y = tmp);
+}
+#line 11 "tests/map/swap.sic"
+printf("%d %d\n", x, y);
+#line 12 "tests/map/swap.sic"
+return 0;
+}
@@ -0,0 +1,34 @@
+#line 1 "tests/cases/types.sic"
+#include <stdio.h>
+#line 3 "tests/cases/types.sic"
+double scale(double x, int k) {
+#line 4 "tests/cases/types.sic"
+return (x * ((double)k));
+}
+#line 6 "tests/cases/types.sic"
+int main(int argc, char** argv) {
+#line 7 "tests/cases/types.sic"
+unsigned long total = 0;
+#line 8 "tests/cases/types.sic"
+(total += 4000000000);
+#line 9 "tests/cases/types.sic"
+printf("%lu\n", total);
+#line 11 "tests/cases/types.sic"
+const char* msg = "hi";
+#line 12 "tests/cases/types.sic"
+printf("%s\n", msg);
+#line 14 "tests/cases/types.sic"
+printf("%.1f\n", scale(2.5, 3));
+#line 15 "tests/cases/types.sic"
+printf("%zu\n", sizeof(unsigned char));
+#line 16 "tests/cases/types.sic"
+printf("%zu\n", sizeof(total));
+#line 18 "tests/cases/types.sic"
+int grid[2][2];
+#line 19 "tests/cases/types.sic"
+(grid[1][1] = 9);
+#line 20 "tests/cases/types.sic"
+printf("%d\n", grid[1][1]);
+#line 21 "tests/cases/types.sic"
+return 0;
+}
@@ -0,0 +1,51 @@
+#line 1 "tests/unity/geometry.sic"
+#line 2 "/root/repo/tests/modules/vec.sic"
+#include <stddef.h>
+#line 3 "/root/repo/tests/modules/vec.sic"
+#define VEC_DIMS 3
+#line 5 "/root/repo/tests/modules/vec.sic"
+struct Vec {
+int x;
+int y;
+int z;
+};
+#line 6 "/root/repo/tests/modules/vec.sic"
+typedef struct Vec Vec;
+#line 12 "/root/repo/tests/modules/vec.sic"
+int vec_sum(Vec* v);
+#line 3 "tests/unity/geometry.sic"
+#include <stdio.h>
+#line 4 "tests/unity/geometry.sic"
+#define UNITY_SCALE 2
+#line 6 "tests/unity/geometry.sic"
+struct Point {
+int x;
+int y;
+};
+#line 10 "tests/unity/geometry.sic"
+static int point_norm2(struct Point* p) {
+#line 11 "tests/unity/geometry.sic"
+return ((p->x * p->x) + (p->y * p->y));
+}
+#line 13 "tests/unity/geometry.sic"
+static int vec_norm2(Vec* v) {
+#line 14 "tests/unity/geometry.sic"
+return ((((*v)).x * ((*v)).x) + (((*v)).y * ((*v)).y) + (((*v)).z * ((*v)).z));
+}
+#line 1 "tests/unity/main.sic"
+#line 8 "tests/unity/main.sic"
+static int scaled(int n) {
+#line 9 "tests/unity/main.sic"
+return (UNITY_SCALE * n);
+}
+#line 11 "tests/unity/main.sic"
+int main() {
+#line 12 "tests/unity/main.sic"
+struct Point p = {3, 4};
+#line 13 "tests/unity/main.sic"
+Vec v = {1, 2, 3};
+#line 14 "tests/unity/main.sic"
+printf("%d %d %d\n", point_norm2((&p)), vec_norm2((&v)), scaled(VEC_DIMS));
+#line 15 "tests/unity/main.sic"
+return 0;
+}
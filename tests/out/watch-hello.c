@@ -0,0 +1,52 @@
+#line 1 "tests/out/watch/hello.sic"
+#include "stdio.h"
+#line 3 "tests/out/watch/hello.sic"
+int main(int argc, char** argv) {
+#line 4 "tests/out/watch/hello.sic"
+printf("hello, world!\n");
+#line 5 "tests/out/watch/hello.sic"
+return 0;
+}
+#line 6 "tests/out/watch/hello.sic"
+#include <stdio.h>
+#line 6 "tests/out/watch/hello.sic"
+#include <stddef.h>
+#line 8 "tests/out/watch/hello.sic"
+struct Flags {
+unsigned ready : 1;
+unsigned mode : 3;
+int count;
+};
+#line 9 "tests/out/watch/hello.sic"
+struct Pair {
+char a;
+long b;
+};
+#line 11 "tests/out/watch/hello.sic"
+int main(int argc, char** argv) {
+#line 12 "tests/out/watch/hello.sic"
+struct Flags f = {1, 5, 42};
+#line 13 "tests/out/watch/hello.sic"
+printf("%u %u %d\n", f.ready, f.mode, f.count);
+#line 15 "tests/out/watch/hello.sic"
+printf("%d\n", (offsetof(struct Pair, a) == 0));
+#line 16 "tests/out/watch/hello.sic"
+printf("%d\n", (offsetof(struct Pair, b) > 0));
+#line 17 "tests/out/watch/hello.sic"
+printf("%zu\n", _Alignof(char));
+#line 19 "tests/out/watch/hello.sic"
+int total = 0;
+#line 20 "tests/out/watch/hello.sic"
+int j = 10;
+#line 21 "tests/out/watch/hello.sic"
+for (
+#line 21 "tests/out/watch/hello.sic"
+int k = 0; (k < 3); ((++k) , (--j))) {
+#line 22 "tests/out/watch/hello.sic"
+(total += k);
+}
+#line 23 "tests/out/watch/hello.sic"
+printf("%d %d\n", total, j);
+#line 24 "tests/out/watch/hello.sic"
+return 0;
+}
@@ -0,0 +1,5 @@
+#line 2 "tests/out/watch/uses.sic"
+int f() {
+#line 2 "tests/out/watch/uses.sic"
+return 9;
+}
@@ -74,9 +74,10 @@ for src in examples/*.sic tests/cases/*.sic; do
   fi
 done
 
-# Codegen tests: the generated C itself (minus #line markers) must match
-# the sibling .c golden file. For emission details that run-tests can't
-# see, or targets we can't compile here (e.g. CUDA).
+# Codegen tests: the generated C itself (minus #line markers, unless the
+# golden has them) must match the sibling .c golden file. For emission
+# details that run-tests can't see, or targets we can't compile here
+# (e.g. CUDA).
 for src in tests/codegen/*.sic; do
   [ -e "$src" ] || continue
   name=$(basename "$src" .sic)
@@ -88,11 +89,15 @@ for src in tests/codegen/*.sic; do
     continue
   fi
 
-  if grep -v '^#line' "$cfile" | diff "${src%.sic}.c" - >/dev/null; then
+  if ! grep -q '^#line' "${src%.sic}.c"; then
+    grep -v '^#line' "$cfile" >"$cfile.tmp"
+    mv "$cfile.tmp" "$cfile"
+  fi
+  if diff "${src%.sic}.c" "$cfile" >/dev/null; then
     pass=$((pass + 1))
   else
     echo "FAIL $name (codegen)"
-    grep -v '^#line' "$cfile" | diff "${src%.sic}.c" - | head -20
+    diff "${src%.sic}.c" "$cfile" | head -20
     fail=$((fail + 1))
   fi
 done
@@ -157,6 +162,380 @@ for src in examples/*.cu.sic tests/cuda/*.cu.sic; do
   fi
 done
 
+# Streaming and -j: --stream emits each top-level form as it goes, -j
+# emits forms on worker threads; both must write exactly what whole-file
+# transpilation does.
+for src in examples/*.sic tests/cases/*.sic tests/codegen/*.sic; do
+  [ -e "$src" ] || continue
+  name=$(basename "$src" .sic)
+  whole="tests/out/stream-$name.whole.c"
+  streamed="tests/out/stream-$name.c"
+  threaded="tests/out/stream-$name.j3.c"
+
+  if ! ./sicc "$src" "$whole" || ! ./sicc --stream "$src" "$streamed" ||
+    ! ./sicc -j 3 "$src" "$threaded"; then
+    echo "FAIL $name (stream transpile)"
+    fail=$((fail + 1))
+  elif ! cmp -s "$whole" "$streamed"; then
+    echo "FAIL $name (stream output)"
+    diff -u "$whole" "$streamed" | head -20
+    fail=$((fail + 1))
+  elif ! cmp -s "$whole" "$threaded"; then
+    echo "FAIL $name (-j output)"
+    diff -u "$whole" "$threaded" | head -20
+    fail=$((fail + 1))
+  else
+    pass=$((pass + 1))
+  fi
+done
+
+# -j and the server must report the error one thread does: every form is
+# expanded before any is emitted, so an expansion error beats an emission
+# error in an earlier form, also when the two are in different runs of 64
+# forms.
+{
+  echo '(defmacro one (x) x)'
+  echo '(fn early :int () (return ()))'
+  for i in $(seq 100); do echo "(fn f$i :int () (return (one $i)))"; done
+  echo '(fn late :int () (return (one)))'
+} >tests/out/phase-order-runs.sic
+diagnostic='.*"diagnostics": \[{"file": "\(.*\)", "line": \([0-9]*\), '
+diagnostic="$diagnostic"'"column": \([0-9]*\), "message": "\(.*\)"}\]}$'
+for src in tests/errors/*.sic tests/out/phase-order-runs.sic; do
+  name=$(basename "$src" .sic)
+  ./sicc "$src" tests/out/parity.c 2>"tests/out/parity-$name.log"
+  ./sicc -j 3 "$src" tests/out/parity.c 2>"tests/out/parity-$name.j3.log"
+  if [ -s "tests/out/parity-$name.log" ] &&
+    cmp -s "tests/out/parity-$name.log" "tests/out/parity-$name.j3.log"; then
+    pass=$((pass + 1))
+  else
+    echo "FAIL $name (-j error)"
+    diff -u "tests/out/parity-$name.log" "tests/out/parity-$name.j3.log"
+    fail=$((fail + 1))
+  fi
+  # And so must the server, whose calls are incremental; its diagnostic
+  # is put the way sicc prints one.
+  {
+    printf 'Content-Length: %d\r\nSource-Name: %s\r\n\r\n' \
+      "$(wc -c <"$src")" "$src"
+    cat "$src"
+  } | {
+    ./sicc --server
+    echo # the reply ends without one
+  } | sed -n "s/$diagnostic/\\1:\\2:\\3: error: \\4/p" \
+    >"tests/out/parity-$name.server.log"
+  if cmp -s "tests/out/parity-$name.log" "tests/out/parity-$name.server.log"
+  then
+    pass=$((pass + 1))
+  else
+    echo "FAIL $name (server error)"
+    diff -u "tests/out/parity-$name.log" "tests/out/parity-$name.server.log"
+    fail=$((fail + 1))
+  fi
+done
+# --stream can't wait for later forms, so it reports the first error in
+# source order: phase-order.sic's bad expression, not its defmacro.
+if ! ./sicc --stream tests/errors/phase-order.sic tests/out/parity.c \
+  2>tests/out/parity-stream.log &&
+  grep -qF "phase-order.sic:4:11: error: empty expression '()'" \
+    tests/out/parity-stream.log; then
+  pass=$((pass + 1))
+else
+  echo "FAIL phase-order (--stream error)"
+  fail=$((fail + 1))
+fi
+
+# Library: tests/api/api.c links libsic.a and prints what the API returns
+# for a few inputs, including errors; compared with api.out.
+if ! ${CC:-cc} -Wall -Werror -o tests/out/api tests/api/api.c libsic.a -lm \
+  -pthread 2>tests/out/api.cc.log; then
+  echo "FAIL api (compile)"
+  cat tests/out/api.cc.log
+  fail=$((fail + 1))
+elif tests/out/api | cmp -s - tests/api/api.out; then
+  pass=$((pass + 1))
+else
+  echo "FAIL api (output)"
+  tests/out/api | diff -u tests/api/api.out - | head -20
+  fail=$((fail + 1))
+fi
+
+# Server: every tests/server/*.sic sent, in order, to one sicc --server
+# as framed requests; the framed replies must match server.out.
+for src in tests/server/*.sic; do
+  printf 'Content-Length: %d\r\nSource-Name: %s\r\n\r\n' \
+    "$(wc -c <"$src")" "$(basename "$src")"
+  cat "$src"
+done | ./sicc --server >tests/out/server.out
+if cmp -s tests/out/server.out tests/server/server.out; then
+  pass=$((pass + 1))
+else
+  echo "FAIL server"
+  diff -u tests/server/server.out tests/out/server.out | head -20
+  fail=$((fail + 1))
+fi
+
+# Server imports: sources named by path, as editors name them, so their
+# imports resolve. A module's lines in "map" and its error's "file" name
+# it by its canonical path; the tree's own is cut, and the lengths that
+# depend on it, so imports.out holds on any checkout.
+for src in tests/server/imports/uses.sic tests/server/imports/clashes.sic; do
+  printf 'Content-Length: %d\r\nSource-Name: %s\r\n\r\n' \
+    "$(wc -c <"$src")" "$src"
+  cat "$src"
+done | ./sicc --server | sed -e "s|$(pwd -P)/||g" \
+  -e 's/Content-Length: [0-9]*/Content-Length: N/g' >tests/out/imports.out
+if cmp -s tests/out/imports.out tests/server/imports.out; then
+  pass=$((pass + 1))
+else
+  echo "FAIL server imports"
+  diff -u tests/server/imports.out tests/out/imports.out | head -20
+  fail=$((fail + 1))
+fi
+
+# Header: sicc --header must write tests/header/shapes.h beside the C;
+# after an edit that only moves rows and changes a body, the C must
+# change and the header must not be rewritten.
+header=tests/out/header
+rm -rf "$header"
+mkdir -p "$header/modules" "$header/header"
+cp tests/modules/vec.sic "$header/modules/"
+cp tests/header/shapes.sic "$header/header/"
+if ./sicc --header "$header/header/shapes.sic" "$header/shapes.c" &&
+  cmp -s "$header/shapes.h" tests/header/shapes.h; then
+  pass=$((pass + 1))
+else
+  echo "FAIL header"
+  fail=$((fail + 1))
+fi
+cp "$header/shapes.c" "$header/before.c"
+touch -d '2000-01-01' "$header/shapes.h"
+{
+  echo
+  sed 's/(twice (shape_area s))/(shape_area s)/' tests/header/shapes.sic
+} >"$header/header/shapes.sic"
+if ./sicc --header "$header/header/shapes.sic" "$header/shapes.c" &&
+  ! cmp -s "$header/shapes.c" "$header/before.c" &&
+  [ -z "$(find "$header/shapes.h" -newermt '2000-01-02')" ]; then
+  pass=$((pass + 1))
+else
+  echo "FAIL header (body-only edit rewrote it)"
+  fail=$((fail + 1))
+fi
+
+# Source map: sicc --source-map must write tests/map/swap.c.map beside
+# the C, with the macro's template mapped to the call and its arguments
+# to themselves, both naming the call.
+if ./sicc --source-map tests/map/swap.sic tests/out/swap.c &&
+  cmp -s tests/out/swap.c.map tests/map/swap.c.map; then
+  pass=$((pass + 1))
+else
+  echo "FAIL source map"
+  fail=$((fail + 1))
+fi
+
+# Gensyms: a form added above a macro call must not rename the
+# temporaries the call made.
+swap='(defmacro swap (a b) (do (decl t# :int a) (set a b) (set b t#)))
+(fn main :int () (decl x :int 1) (decl y :int 2) (swap x y) (return x))'
+echo "$swap" >tests/out/gensyms.sic
+printf '(fn unused :int () (return 0))\n%s\n' "$swap" \
+  >tests/out/gensyms-moved.sic
+if ./sicc tests/out/gensyms.sic tests/out/gensyms.c &&
+  ./sicc tests/out/gensyms-moved.sic tests/out/gensyms-moved.c &&
+  grep -q 't__' tests/out/gensyms.c &&
+  [ "$(grep 't__' tests/out/gensyms.c)" = \
+    "$(grep 't__' tests/out/gensyms-moved.c)" ]; then
+  pass=$((pass + 1))
+else
+  echo "FAIL gensyms renamed by an added form"
+  fail=$((fail + 1))
+fi
+
+# The same call twice at top level must still define two globals; -j
+# must name them as one thread does.
+printf '%s\n' '(defmacro defcounter () (decl counter# :int 0))' \
+  '(defcounter)' '(defcounter)' '(fn main :int () (return 0))' \
+  >tests/out/gensyms-twice.sic
+if ./sicc tests/out/gensyms-twice.sic tests/out/gensyms-twice.c &&
+  ./sicc -j 2 tests/out/gensyms-twice.sic tests/out/gensyms-twice-j.c &&
+  cmp -s tests/out/gensyms-twice.c tests/out/gensyms-twice-j.c &&
+  ${CC:-cc} -Wall -Werror -o tests/out/gensyms-twice \
+    tests/out/gensyms-twice.c; then
+  pass=$((pass + 1))
+else
+  echo "FAIL gensyms of identical forms collide"
+  fail=$((fail + 1))
+fi
+
+# Unity: tests/unity/ as one translation unit, main.sic given first,
+# must build with -Wall -Werror, print unity.out, and make geometry.sic's
+# functions static.
+if ./sicc --unity tests/out/unity.c tests/unity/main.sic \
+  tests/unity/geometry.sic &&
+  ${CC:-cc} -Wall -Werror -o tests/out/unity tests/out/unity.c &&
+  tests/out/unity | cmp -s - tests/unity/unity.out &&
+  grep -q '^static int point_norm2(' tests/out/unity.c; then
+  pass=$((pass + 1))
+else
+  echo "FAIL unity"
+  fail=$((fail + 1))
+fi
+
+# Build: sicc build links tests/build/*.sic into one program, which must
+# print build.out; an unchanged rebuild must not run the compiler at all.
+# $CC is wrapped to log each run.
+build=tests/out/build
+rm -rf "$build"
+mkdir -p "$build"
+printf '#!/bin/sh\necho "$*" >>%s/cc.log\nexec %s "$@"\n' \
+  "$build" "${CC:-cc}" >"$build/cc"
+chmod +x "$build/cc"
+if ! CC="$build/cc" ./sicc build -o "$build/prog" --cache "$build/cache" \
+  tests/build/*.sic || ! "$build/prog" | cmp -s - tests/build/build.out; then
+  echo "FAIL build"
+  fail=$((fail + 1))
+else
+  pass=$((pass + 1))
+fi
+: >"$build/cc.log"
+if CC="$build/cc" ./sicc build -o "$build/prog" --cache "$build/cache" \
+  tests/build/*.sic && [ ! -s "$build/cc.log" ]; then
+  pass=$((pass + 1))
+else
+  echo "FAIL build (rebuild ran the compiler)"
+  cat "$build/cc.log"
+  fail=$((fail + 1))
+fi
+
+# An input is rebuilt when a module it imports changes, though its own
+# bytes don't.
+mkdir -p "$build/import"
+printf '(import "words.sic")\n(#include <stdio.h>)\n%s\n' \
+  '(fn main :int () (puts WORD) (return 0))' >"$build/import/main.sic"
+for word in first second; do
+  printf '(#define WORD "%s")\n' "$word" >"$build/import/words.sic"
+  if CC="$build/cc" ./sicc build -o "$build/import/prog" \
+    --cache "$build/cache" "$build/import/main.sic" &&
+    [ "$("$build/import/prog")" = "$word" ]; then
+    pass=$((pass + 1))
+  else
+    echo "FAIL build (import, $word)"
+    fail=$((fail + 1))
+  fi
+done
+
+# Script: tests/script/args.sic run twice through sicc run, which must
+# print args.out both times; the second must come from the cache, running
+# no compiler (the logging $CC from the build tier).
+rm -rf tests/out/script-cache
+for run in compiled cached; do
+  : >"$build/cc.log"
+  if CC="$build/cc" ./sicc run --cache tests/out/script-cache \
+    tests/script/args.sic one "two words" | cmp -s - tests/script/args.out &&
+    { [ "$run" = compiled ] || [ ! -s "$build/cc.log" ]; }; then
+    pass=$((pass + 1))
+  else
+    echo "FAIL script ($run)"
+    fail=$((fail + 1))
+  fi
+done
+
+# Watch: a sicc --watch over an empty directory must write each .sic
+# copied into it as it comes, and redo it when it changes. Polls for up
+# to five seconds per step.
+watched=tests/out/watch
+rm -rf "$watched"
+mkdir -p "$watched"
+./sicc --watch "$watched" &
+watcher=$!
+# True once $1 has the same bytes as $2.
+settles() {
+  for _ in $(seq 50); do
+    cmp -s "$1" "$2" && return 0
+    sleep 0.1
+  done
+  return 1
+}
+sleep 0.2
+cp examples/hello.sic "$watched/hello.sic"
+./sicc "$watched/hello.sic" >tests/out/watch-hello.c
+if settles "$watched/hello.c" tests/out/watch-hello.c; then
+  pass=$((pass + 1))
+else
+  echo "FAIL watch (new file)"
+  fail=$((fail + 1))
+fi
+cat tests/cases/misc.sic >>"$watched/hello.sic"
+./sicc "$watched/hello.sic" >tests/out/watch-hello.c
+if settles "$watched/hello.c" tests/out/watch-hello.c; then
+  pass=$((pass + 1))
+else
+  echo "FAIL watch (changed file)"
+  fail=$((fail + 1))
+fi
+# A file importing a module must be redone when only the module changes,
+# and a watcher started afterwards must notice too.
+echo '(defmacro val () 1)' >"$watched/mod.sic"
+printf '%s\n' '(import "mod.sic")' '(fn f :int () (return (val)))' \
+  >"$watched/uses.sic"
+./sicc "$watched/uses.sic" >tests/out/watch-uses.c
+if settles "$watched/uses.c" tests/out/watch-uses.c; then
+  echo '(defmacro val () 7)' >"$watched/mod.sic"
+  ./sicc "$watched/uses.sic" >tests/out/watch-uses.c
+fi
+if grep -q 'return 7;' tests/out/watch-uses.c &&
+  settles "$watched/uses.c" tests/out/watch-uses.c; then
+  pass=$((pass + 1))
+else
+  echo "FAIL watch (changed import)"
+  fail=$((fail + 1))
+fi
+kill "$watcher"
+wait "$watcher" 2>/dev/null
+echo '(defmacro val () 9)' >"$watched/mod.sic"
+./sicc --watch "$watched" &
+watcher=$!
+./sicc "$watched/uses.sic" >tests/out/watch-uses.c
+if grep -q 'return 9;' tests/out/watch-uses.c &&
+  settles "$watched/uses.c" tests/out/watch-uses.c; then
+  pass=$((pass + 1))
+else
+  echo "FAIL watch (import changed while stopped)"
+  fail=$((fail + 1))
+fi
+kill "$watcher"
+wait "$watcher" 2>/dev/null
+
+# Batch: one --out-dir run over every example, case and error test. Each
+# good file must come out as it does alone; each error must still be
+# reported under its own file name, and leave no output behind.
+batch=tests/out/batch
+rm -rf "$batch"
+mkdir -p "$batch"
+./sicc -j 3 --out-dir "$batch" examples/*.sic tests/cases/*.sic \
+  tests/errors/*.sic 2>tests/out/batch.log
+for src in examples/*.sic tests/cases/*.sic tests/errors/*.sic; do
+  [ -e "$src" ] || continue
+  name=$(basename "$src" .sic)
+  case "$name" in *.cu) out="$batch/$name" ;; *) out="$batch/$name.c" ;; esac
+
+  if [ -e "${src%.sic}.err" ]; then
+    if [ -e "$out" ] || ! grep -F "$src:" tests/out/batch.log |
+      grep -qF "$(cat "${src%.sic}.err")"; then
+      echo "FAIL $name (batch error)"
+      fail=$((fail + 1))
+    else
+      pass=$((pass + 1))
+    fi
+  elif ./sicc "$src" | cmp -s - "$out"; then
+    pass=$((pass + 1))
+  else
+    echo "FAIL $name (batch output)"
+    fail=$((fail + 1))
+  fi
+done
+
 # Error tests: transpilation of tests/errors/*.sic must fail, and stderr
 # must contain the sibling .err file.
 for src in tests/errors/*.sic; do
@@ -7,7 +7,8 @@
 
 ;; Editing support for (sic), the s-expression language that transpiles
 ;; to C: font-lock, indentation, imenu, completion-at-point, and a
-;; flymake backend that runs sicc plus a C compiler and maps C
+;; flymake backend that feeds the buffer to a long-running `sicc
+;; --server', checks the C it returns with a C compiler, and maps C
 ;; diagnostics back to .sic lines through the #line markers sicc emits.
 ;;
 ;; See tools/README.md for setup, including LSP via tools/sic-lsp.
@@ -16,6 +17,7 @@
 
 (require 'lisp-mode)
 (require 'flymake)
+(require 'json)
 
 (defvar calculate-lisp-indent-last-sexp)
 
@@ -28,8 +30,8 @@
 (defconst sic-mode--keywords
   '("fn" "decl" "set" "if" "do" "while" "do-while" "for" "switch" "case"
     "default" "return" "goto" "label" "struct" "union" "enum" "typedef"
-    "defmacro" "launch" "fnptr")
-  "Form heads drawn from sicc's TRANSPILE_RULES, plus macro forms.")
+    "defmacro" "import" "launch" "fnptr")
+  "Form heads drawn from TRANSPILE_RULES in src/sic.c, plus macro forms.")
 
 (defconst sic-mode--builtins
   '("init" "aref" "deref" "sizeof" "offsetof" "alignof")
@@ -207,6 +209,8 @@ the buffer's file, then on `exec-path'."
   :type 'string)
 
 (defvar-local sic-mode--flymake-proc nil)
+(defvar-local sic-mode--flymake-check nil
+  "Token of the buffer's latest check; replies to older ones are dropped.")
 
 (defun sic-mode--find-sicc ()
   (or sic-mode-sicc-program
@@ -217,16 +221,136 @@ the buffer's file, then on `exec-path'."
         (expand-file-name "sicc" root))
       (executable-find "sicc")))
 
-(defun sic-mode--flymake-parse (source src)
+;; One `sicc --server' per sicc binary serves every buffer. Requests
+;; and replies are Content-Length framed; replies come back in request
+;; order, so each process keeps a queue of callbacks waiting on them.
+
+(defvar sic-mode--servers (make-hash-table :test #'equal)
+  "Running `sicc --server' processes, keyed by the sicc they run.")
+
+(defun sic-mode--server (sicc)
+  "A live `sicc --server' process for SICC, started if need be."
+  (let ((proc (gethash sicc sic-mode--servers)))
+    (unless (process-live-p proc)
+      (setq proc (make-process
+                  :name "sicc-server" :noquery t :connection-type 'pipe
+                  :coding 'binary
+                  :buffer (generate-new-buffer " *sicc-server*")
+                  :command (list sicc "--server")
+                  :filter #'sic-mode--server-filter
+                  :sentinel #'sic-mode--server-sentinel))
+      (with-current-buffer (process-buffer proc)
+        (set-buffer-multibyte nil))
+      (puthash sicc proc sic-mode--servers))
+    proc))
+
+(defun sic-mode--server-take ()
+  "Remove the first whole reply from the current buffer and parse it.
+Nil while it is still arriving."
+  (goto-char (point-min))
+  (when (looking-at "Content-Length: \\([0-9]+\\)\r\n\r\n")
+    (let ((start (match-end 0))
+          (end (+ (match-end 0) (string-to-number (match-string 1)))))
+      (when (<= end (point-max))
+        (let ((body (decode-coding-string
+                     (buffer-substring-no-properties start end) 'utf-8))
+              (json-object-type 'plist)
+              (json-array-type 'list)
+              (json-false nil)
+              (json-null nil))
+          (delete-region (point-min) end)
+          (json-read-from-string body))))))
+
+(defun sic-mode--server-filter (proc output)
+  (with-current-buffer (process-buffer proc)
+    (goto-char (point-max))
+    (insert output)
+    (let (reply)
+      (while (setq reply (sic-mode--server-take))
+        (let ((callbacks (process-get proc 'sic-callbacks)))
+          (process-put proc 'sic-callbacks (cdr callbacks))
+          (funcall (car callbacks) reply))))))
+
+(defun sic-mode--server-sentinel (proc _event)
+  (unless (process-live-p proc)
+    (let ((callbacks (process-get proc 'sic-callbacks)))
+      (process-put proc 'sic-callbacks nil)
+      (kill-buffer (process-buffer proc))
+      (dolist (callback callbacks)
+        (funcall callback nil)))))
+
+(defun sic-mode--server-transpile (sicc name text callback)
+  "Have SICC's server transpile TEXT, which #line markers call NAME.
+CALLBACK gets the reply as a plist, or nil if the server died first."
+  (let ((proc (sic-mode--server sicc))
+        (data (encode-coding-string text 'utf-8 t)))
+    (process-put proc 'sic-callbacks
+                 (append (process-get proc 'sic-callbacks) (list callback)))
+    (process-send-string
+     proc (encode-coding-string
+           (format "Content-Length: %d\r\nSource-Name: %s\r\n\r\n"
+                   (length data) name)
+           'utf-8 t))
+    (process-send-string proc data)))
+
+(defun sic-mode--import-region (source name file)
+  "The region of the (import ...) form in SOURCE, which is NAME, that
+brought in FILE: the one naming it, else the first, as FILE may have
+come in through another module. Nil if SOURCE imports nothing."
+  (with-current-buffer source
+    (save-excursion
+      (save-restriction
+        (widen)
+        (goto-char (point-min))
+        (let ((want (file-truename file))
+              (dir (file-name-directory (expand-file-name name)))
+              first found)
+          (while (and (not found)
+                      (re-search-forward
+                       "(\\s-*import\\s-+\"\\([^\"\\\\]*\\)\"\\s-*)" nil t))
+            (let ((region (cons (match-beginning 0) (match-end 0))))
+              (unless first
+                (setq first region))
+              (when (equal (file-truename
+                            (expand-file-name (match-string 1) dir))
+                           want)
+                (setq found region))))
+          (or found first))))))
+
+(defun sic-mode--server-diagnostics (source name reply)
+  "Flymake diagnostics for SOURCE, which is NAME, from the sicc REPLY
+that rejected it. An error in an imported module goes on the import
+that brought it in, saying where in the module it is."
+  (mapcar (lambda (diag)
+            (let* ((line (plist-get diag :line))
+                   (file (or (plist-get diag :file) name))
+                   (import (and (not (equal file name))
+                                (sic-mode--import-region source name file)))
+                   (region (or import
+                               (flymake-diag-region
+                                source (max line 1)
+                                (and (> line 0) (plist-get diag :column))))))
+              (flymake-make-diagnostic
+               source (car region) (cdr region) :error
+               (if import
+                   (format "%s%s: %s" file
+                           (if (> line 0)
+                               (format ":%d:%d" line (plist-get diag :column))
+                             "")
+                           (plist-get diag :message))
+                 (plist-get diag :message)))))
+          (plist-get reply :diagnostics)))
+
+(defun sic-mode--flymake-parse (source name)
   "Collect diagnostics for SOURCE from the current process buffer.
-Both sicc and cc report positions in SRC's coordinates — cc because
-the generated C carries #line markers pointing back at SRC — so one
-pattern covers both, and lines about other files (headers) drop out."
+The compiler reports positions in NAME's coordinates, because the
+generated C carries #line markers naming it, and lines about other
+files (headers) drop out."
   (goto-char (point-min))
-  (let ((gcc-style (concat "^" (regexp-quote src)
+  (let ((gcc-style (concat "^" (regexp-quote name)
                            ":\\([0-9]+\\):\\([0-9]+\\): "
                            "\\(fatal error\\|error\\|warning\\|note\\): \\(.*\\)$"))
-        (nvcc-style (concat "^" (regexp-quote src)
+        (nvcc-style (concat "^" (regexp-quote name)
                             "(\\([0-9]+\\)): \\(error\\|warning\\): \\(.*\\)$"))
         diags)
     (while (re-search-forward gcc-style nil t)
@@ -250,53 +374,71 @@ pattern covers both, and lines about other files (headers) drop out."
               diags)))
     (nreverse diags)))
 
+(defun sic-mode--flymake-compile (source name c report-fn)
+  "Syntax-check C, generated from SOURCE, and give REPORT-FN the result."
+  (let* ((cuda (string-suffix-p ".cu.sic" name))
+         (nvcc (and cuda (executable-find sic-mode-nvcc-program))))
+    (if (and cuda (not nvcc))
+        (funcall report-fn nil)
+      (let* ((gen (make-temp-file "sic-flymake-" nil (if cuda ".cu" ".c") c))
+             (obj (concat gen ".o")))
+        (setq sic-mode--flymake-proc
+              (make-process
+               :name "sic-flymake" :noquery t :connection-type 'pipe
+               :buffer (generate-new-buffer " *sic-flymake*")
+               :command (if nvcc
+                            (list nvcc "-c" gen "-o" obj)
+                          `(,sic-mode-cc-program ,@sic-mode-cc-flags
+                            "-fsyntax-only" ,gen))
+               :sentinel
+               (lambda (proc _event)
+                 (when (memq (process-status proc) '(exit signal))
+                   (unwind-protect
+                       (if (with-current-buffer source
+                             (eq proc sic-mode--flymake-proc))
+                           (with-current-buffer (process-buffer proc)
+                             (funcall report-fn
+                                      (sic-mode--flymake-parse source name)))
+                         (flymake-log :warning "Canceling obsolete check %s" proc))
+                     (ignore-errors (delete-file gen))
+                     (ignore-errors (delete-file obj))
+                     (kill-buffer (process-buffer proc)))))))))))
+
 (defun sic-flymake (report-fn &rest _args)
-  "Flymake backend: sicc the buffer, then syntax-check the generated C.
-For .cu.sic buffers the C stage uses nvcc when available and is
-skipped otherwise, so transpile errors still surface."
+  "Flymake backend: transpile the buffer, then syntax-check the C.
+The text goes to a shared `sicc --server', so a check starts no sicc
+process and writes no .sic file. For .cu.sic buffers the C stage uses
+nvcc when available and is skipped otherwise, so transpile errors
+still surface."
   (let ((sicc (sic-mode--find-sicc)))
     (unless sicc
       (error "sic-flymake: cannot find sicc (set `sic-mode-sicc-program')"))
     (when (process-live-p sic-mode--flymake-proc)
       (kill-process sic-mode--flymake-proc))
-    (let* ((source (current-buffer))
-           (cuda (and buffer-file-name
-                      (string-suffix-p ".cu.sic" buffer-file-name)))
-           (src (make-temp-file "sic-flymake-" nil (if cuda ".cu.sic" ".sic")))
-           (gen (concat src (if cuda ".cu" ".c")))
-           (obj (concat src ".o"))
-           (nvcc (and cuda (executable-find sic-mode-nvcc-program)))
-           (check (cond
-                   (nvcc (list nvcc "-c" gen "-o" obj))
-                   (cuda '(":"))
-                   (t `(,sic-mode-cc-program ,@sic-mode-cc-flags
-                        "-fsyntax-only" ,gen))))
-           (command (format "%s && %s"
-                            (mapconcat #'shell-quote-argument
-                                       (list sicc src gen) " ")
-                            (mapconcat #'shell-quote-argument check " "))))
-      (save-restriction
-        (widen)
-        (write-region (point-min) (point-max) src nil 'silent))
-      (setq sic-mode--flymake-proc
-            (make-process
-             :name "sic-flymake" :noquery t :connection-type 'pipe
-             :buffer (generate-new-buffer " *sic-flymake*")
-             :command (list shell-file-name shell-command-switch command)
-             :sentinel
-             (lambda (proc _event)
-               (when (memq (process-status proc) '(exit signal))
-                 (unwind-protect
-                     (if (with-current-buffer source
-                           (eq proc sic-mode--flymake-proc))
-                         (with-current-buffer (process-buffer proc)
-                           (funcall report-fn
-                                    (sic-mode--flymake-parse source src)))
-                       (flymake-log :warning "Canceling obsolete check %s" proc))
-                   (ignore-errors (delete-file src))
-                   (ignore-errors (delete-file gen))
-                   (ignore-errors (delete-file obj))
-                   (kill-buffer (process-buffer proc))))))))))
+    (let ((source (current-buffer))
+          (name (or buffer-file-name (buffer-name)))
+          (check (setq sic-mode--flymake-check (list 'check))))
+      (sic-mode--server-transpile
+       sicc name
+       (save-restriction
+         (widen)
+         (buffer-substring-no-properties (point-min) (point-max)))
+       (lambda (reply)
+         (when (buffer-live-p source)
+           (with-current-buffer source
+             (cond
+              ((not (eq check sic-mode--flymake-check))
+               (flymake-log :warning "Canceling obsolete check"))
+              ((null reply)
+               (funcall report-fn :panic
+                        :explanation "sicc --server exited"))
+              ((plist-get reply :ok)
+               (sic-mode--flymake-compile source name (plist-get reply :c)
+                                          report-fn))
+              (t
+               (funcall report-fn
+                        (sic-mode--server-diagnostics
+                         source name reply)))))))))))
 
 ;; === Mode ===
 
@@ -10,7 +10,7 @@
 
 (list . (symbol) @keyword
   (#match? @keyword
-   "^(fn|decl|set|if|do|while|do-while|for|switch|case|default|return|goto|label|struct|union|enum|typedef|defmacro|launch|fnptr)$"))
+   "^(fn|decl|set|if|do|while|do-while|for|switch|case|default|return|goto|label|struct|union|enum|typedef|defmacro|import|launch|fnptr)$"))
 
 (list . (symbol) @function.builtin
   (#match? @function.builtin